@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+// Allocates, resizes and frees from several threads at once through lx_mem_*(), the way lvgl, toml and the worker
+// threads share the gui heap. This is a random mix of sizes rather than the rebuild and page threads themselves,
+// which need the database and lvgl. Reports the time per operation for 1 thread up to the given number of threads,
+// and checks that blocks aren't handed out twice and that everything is returned to the heap.
+// Usage: bench_mem [threads] [operations per thread]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "lithiumx.h"
+
+#define BENCH_MEM_SLOTS 512 // Allocations each thread keeps live
+
+typedef struct
+{
+    int ops;
+    uint32_t seed;
+    uint64_t ticks;
+    bool ok;
+} bench_thread_t;
+
+void dash_printf(dash_debug_level_t level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+}
+
+// xorshift32
+static uint32_t bench_rand(uint32_t *seed)
+{
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+// Mostly blocks the size of lvgl objects and strings, with a few larger ones that always go to the pool
+static size_t bench_size(uint32_t r)
+{
+    if ((r & 7) == 0)
+    {
+        return DASH_MEM_CACHE_MAX_SIZE + (r >> 8) % 4096;
+    }
+    return 4 + (r >> 8) % DASH_MEM_CACHE_MAX_SIZE;
+}
+
+// Each live block starts with its slot number so a block given to two slots is noticed
+static bool bench_check(void *block, int slot)
+{
+    return *(int *)block == slot;
+}
+
+static int bench_thread_f(void *param)
+{
+    bench_thread_t *b = param;
+    void *slots[BENCH_MEM_SLOTS] = {NULL};
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < b->ops; i++)
+    {
+        uint32_t r = bench_rand(&b->seed);
+        int slot = r % BENCH_MEM_SLOTS;
+        r = bench_rand(&b->seed);
+        if (slots[slot] == NULL)
+        {
+            // The heap can grow without limit here, so an allocation never fails
+            slots[slot] = lx_mem_alloc(bench_size(r));
+            b->ok &= slots[slot] != NULL;
+        }
+        else if ((r & 15) == 0)
+        {
+            b->ok &= bench_check(slots[slot], slot);
+            void *block = lx_mem_realloc(slots[slot], bench_size(r >> 4));
+            if (block == NULL)
+            {
+                lx_mem_free(slots[slot]);
+                b->ok = false;
+            }
+            slots[slot] = block;
+        }
+        else
+        {
+            b->ok &= bench_check(slots[slot], slot);
+            lx_mem_free(slots[slot]);
+            slots[slot] = NULL;
+        }
+
+        if (slots[slot])
+        {
+            *(int *)slots[slot] = slot;
+        }
+    }
+    b->ticks = SDL_GetPerformanceCounter() - start;
+
+    for (int i = 0; i < BENCH_MEM_SLOTS; i++)
+    {
+        if (slots[i])
+        {
+            b->ok &= bench_check(slots[i], i);
+            lx_mem_free(slots[i]);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = (argc > 1) ? atoi(argv[1]) : 4;
+    int ops = (argc > 2) ? atoi(argv[2]) : 1000000;
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    bool ok = true;
+
+    lx_mem_init();
+    max_threads = LV_CLAMP(1, max_threads, 64);
+
+    printf("DASH_MEM_CACHE_MAX_SIZE %d, DASH_MEM_CACHE_DEPTH %d, %d operations per thread\n",
+           DASH_MEM_CACHE_MAX_SIZE, DASH_MEM_CACHE_DEPTH, ops);
+    for (int thread_cnt = 1; thread_cnt <= max_threads; thread_cnt *= 2)
+    {
+        SDL_Thread *threads[64];
+        bench_thread_t params[64];
+        for (int i = 0; i < thread_cnt; i++)
+        {
+            params[i].ops = ops;
+            params[i].seed = 2463534242u + i;
+            params[i].ticks = 0;
+            params[i].ok = true;
+        }
+
+        uint64_t start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < thread_cnt; i++)
+        {
+            threads[i] = SDL_CreateThread(bench_thread_f, "bench_mem", &params[i]);
+        }
+        uint64_t thread_ticks = 0;
+        bool round_ok = true;
+        for (int i = 0; i < thread_cnt; i++)
+        {
+            SDL_WaitThread(threads[i], NULL);
+            thread_ticks += params[i].ticks;
+            round_ok &= params[i].ok;
+        }
+        uint64_t wall_ticks = SDL_GetPerformanceCounter() - start;
+
+        // Each thread hands its cached blocks back when it exits
+        uint32_t used, capacity;
+        lx_mem_usage(&used, &capacity);
+        if (used != 0)
+        {
+            printf("%u bytes still in use after %d threads\n", (unsigned int)used, thread_cnt);
+            round_ok = false;
+        }
+
+        printf("%2d threads %s %8.1f ns/op per thread, %8.1f ns/op overall, heap %u kB\n", thread_cnt,
+               round_ok ? "ok  " : "FAIL", (double)thread_ticks * 1000000000.0 / freq / ((double)ops * thread_cnt),
+               (double)wall_ticks * 1000000000.0 / freq / ((double)ops * thread_cnt), (unsigned int)(capacity / 1024));
+        ok &= round_ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+// Pages down a 1000 title page while its thumbnails are decompressed by the jpeg decoder pool, the way the scroller
+// drives it. Titles on screen are queued at the visible priority. The rows either side are prefetched at the lower
+// priority and jobs left further behind are aborted. Jobs are re-prioritised each time the page moves. Reports how
+// long each screen took until all of its thumbnails were decompressed, and how long the whole page took.
+// Usage: bench_thumbnails <scratch dir> [ms per screen]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <SDL.h>
+#include <jpeglib.h>
+#include "jpg_decoder.h"
+
+#define BENCH_TITLES 1000
+#define BENCH_COLUMNS 4
+#define BENCH_VISIBLE_ROWS 3
+#define BENCH_PREFETCH_ROWS 2 // Matches DASH_SCROLLER_PREFETCH_ROWS
+#define BENCH_TILE_WIDTH 150  // About a 640 pixel wide screen with BENCH_COLUMNS per row
+#define BENCH_JPEG_WIDTH 400  // Typical cover art
+#define BENCH_JPEG_HEIGHT 560
+
+// Same as the scroller
+#define JPEG_PRIORITY_PREFETCH 0
+#define JPEG_PRIORITY_VISIBLE 1
+
+typedef enum
+{
+    TITLE_IDLE,
+    TITLE_QUEUED,
+    TITLE_DONE,
+} bench_title_state_t;
+
+typedef struct
+{
+    bench_title_state_t state;
+    void *handle;
+    int priority;
+} bench_title_t;
+
+static bench_title_t titles[BENCH_TITLES];
+static char paths[BENCH_TITLES][256];
+static SDL_mutex *titles_mutex;
+static int titles_done;
+
+static bool write_sample_jpeg(const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, fp);
+    cinfo.image_width = BENCH_JPEG_WIDTH;
+    cinfo.image_height = BENCH_JPEG_HEIGHT;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 85, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    // Gradients with some noise so it doesn't compress to nothing
+    uint8_t row[BENCH_JPEG_WIDTH * 3];
+    uint32_t seed = 1;
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        int y = cinfo.next_scanline;
+        for (int x = 0; x < BENCH_JPEG_WIDTH; x++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            row[x * 3 + 0] = (uint8_t)(x * 255 / BENCH_JPEG_WIDTH + (seed >> 28));
+            row[x * 3 + 1] = (uint8_t)(y * 255 / BENCH_JPEG_HEIGHT + (seed >> 28));
+            row[x * 3 + 2] = (uint8_t)((x ^ y) + (seed >> 28));
+        }
+        JSAMPROW rows[1] = {row};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    fclose(fp);
+    return true;
+}
+
+// Each title gets its own copy so nothing can be shared between jobs
+static bool write_sample_files(const char *dir)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/sample.jpg", dir);
+    if (write_sample_jpeg(path) == false)
+    {
+        return false;
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    void *data = malloc(size);
+    bool ok = data && fread(data, 1, size, fp) == (size_t)size;
+    fclose(fp);
+
+    for (int i = 0; i < BENCH_TITLES && ok; i++)
+    {
+        snprintf(paths[i], sizeof(paths[i]), "%s/%04d.jpg", dir, i);
+        fp = fopen(paths[i], "wb");
+        ok = fp && fwrite(data, 1, size, fp) == (size_t)size;
+        if (fp)
+        {
+            fclose(fp);
+        }
+    }
+    free(data);
+    return ok;
+}
+
+static void complete_cb(void *img, void *mem, int w, int h, void *user_data)
+{
+    bench_title_t *t = &titles[(intptr_t)user_data];
+    (void)img;
+    (void)w;
+    (void)h;
+    free(mem);
+
+    SDL_LockMutex(titles_mutex);
+    // A job that was aborted while it was completing may have been queued again. Only count it once
+    if (t->state != TITLE_DONE)
+    {
+        t->state = TITLE_DONE;
+        t->handle = NULL;
+        titles_done++;
+    }
+    SDL_UnlockMutex(titles_mutex);
+}
+
+// Queue a title, or raise it if it's already queued. Returns false if the decoder queue is full.
+// Must be called with titles_mutex held
+static bool title_request(int index, int priority)
+{
+    bench_title_t *t = &titles[index];
+    if (t->state == TITLE_DONE)
+    {
+        return true;
+    }
+    if (t->state == TITLE_QUEUED)
+    {
+        if (t->priority != priority)
+        {
+            t->priority = priority;
+            jpeg_decoder_set_priority(t->handle, priority);
+        }
+        return true;
+    }
+    t->handle = jpeg_decoder_queue(paths[index], complete_cb, (void *)(intptr_t)index, priority);
+    if (t->handle == NULL)
+    {
+        return false;
+    }
+    t->state = TITLE_QUEUED;
+    t->priority = priority;
+    return true;
+}
+
+// Must be called with titles_mutex held
+static void title_abort(int index)
+{
+    bench_title_t *t = &titles[index];
+    if (t->state == TITLE_QUEUED)
+    {
+        jpeg_decoder_abort(t->handle);
+        t->state = TITLE_IDLE;
+        t->handle = NULL;
+    }
+}
+
+// What the scroller does each time the page moves. first is the first title on screen
+static void page_update(int first)
+{
+    int visible_end = SDL_min(first + BENCH_COLUMNS * BENCH_VISIBLE_ROWS, BENCH_TITLES);
+    int prefetch_end = SDL_min(visible_end + BENCH_COLUMNS * BENCH_PREFETCH_ROWS, BENCH_TITLES);
+
+    SDL_LockMutex(titles_mutex);
+    // Drop everything outside the visible and prefetch rows to make room
+    for (int i = 0; i < BENCH_TITLES; i++)
+    {
+        if (i < first - BENCH_COLUMNS * BENCH_PREFETCH_ROWS || i >= prefetch_end)
+        {
+            title_abort(i);
+        }
+    }
+    for (int i = first; i < visible_end; i++)
+    {
+        title_request(i, JPEG_PRIORITY_VISIBLE);
+    }
+    for (int i = visible_end; i < prefetch_end; i++)
+    {
+        title_request(i, JPEG_PRIORITY_PREFETCH);
+    }
+    for (int i = SDL_max(0, first - BENCH_COLUMNS * BENCH_PREFETCH_ROWS); i < first; i++)
+    {
+        title_request(i, JPEG_PRIORITY_PREFETCH);
+    }
+    SDL_UnlockMutex(titles_mutex);
+}
+
+static bool screen_done(int first)
+{
+    int visible_end = SDL_min(first + BENCH_COLUMNS * BENCH_VISIBLE_ROWS, BENCH_TITLES);
+    bool done = true;
+    SDL_LockMutex(titles_mutex);
+    for (int i = first; i < visible_end; i++)
+    {
+        done &= titles[i].state == TITLE_DONE;
+    }
+    SDL_UnlockMutex(titles_mutex);
+    return done;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <scratch dir> [ms per screen]\n", argv[0]);
+        return 1;
+    }
+    int screen_ms = (argc > 2) ? atoi(argv[2]) : 50;
+    if (write_sample_files(argv[1]) == false)
+    {
+        printf("Could not write the sample jpegs to %s\n", argv[1]);
+        return 1;
+    }
+
+    titles_mutex = SDL_CreateMutex();
+    jpeg_decoder_init(32, 256);
+    jpeg_decoder_set_width(BENCH_TILE_WIDTH);
+
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t start = SDL_GetPerformanceCounter();
+    int screen_size = BENCH_COLUMNS * BENCH_VISIBLE_ROWS;
+    int screen_cnt = (BENCH_TITLES + screen_size - 1) / screen_size;
+    double total_ms = 0, worst_ms = 0;
+    int late_cnt = 0;
+
+    // Page down one screen at a time. The page moves on after screen_ms whether the thumbnails are done or not,
+    // like someone holding down the button
+    for (int screen = 0; screen < screen_cnt; screen++)
+    {
+        int first = screen * screen_size;
+        uint64_t shown = SDL_GetPerformanceCounter();
+        uint64_t deadline = shown + freq * screen_ms / 1000;
+        bool done = false;
+        page_update(first);
+        while (1)
+        {
+            uint64_t now = SDL_GetPerformanceCounter();
+            if (done == false && screen_done(first))
+            {
+                double ms = (double)(now - shown) * 1000.0 / freq;
+                total_ms += ms;
+                worst_ms = SDL_max(worst_ms, ms);
+                done = true;
+            }
+            if (now >= deadline)
+            {
+                break;
+            }
+            // Jobs may have been refused while the queue was full
+            page_update(first);
+            SDL_Delay(1);
+        }
+        if (done == false)
+        {
+            late_cnt++;
+        }
+    }
+
+    // Stay on the last screen until it's done
+    int last = (screen_cnt - 1) * screen_size;
+    uint64_t last_shown = SDL_GetPerformanceCounter();
+    while (screen_done(last) == false)
+    {
+        page_update(last);
+        SDL_Delay(1);
+    }
+    double last_ms = (double)(SDL_GetPerformanceCounter() - last_shown) * 1000.0 / freq;
+    double page_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / freq;
+
+    jpeg_decoder_deinit();
+    SDL_DestroyMutex(titles_mutex);
+
+    int on_time = screen_cnt - late_cnt;
+    printf("%d titles, %d per screen, %d ms per screen, %d decoder threads\n", BENCH_TITLES, screen_size, screen_ms,
+           JPEG_DECODER_THREADS);
+    printf("Screens complete before moving on: %d of %d\n", on_time, screen_cnt);
+    printf("Time to all visible thumbnails: %.1f ms average, %.1f ms worst\n", (on_time) ? total_ms / on_time : 0.0,
+           worst_ms);
+    printf("Last screen complete after %.1f ms, whole page %.1f ms, %d thumbnails decompressed\n", last_ms, page_ms,
+           titles_done);
+    return 0;
+}
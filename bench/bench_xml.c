@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+// Parses the sample metadata files in bench/data with dash_xml_parse(), checks every field and reports the time
+// per file. Built once with the default DASH_XML_CHUNK_SIZE/DASH_XML_TOKENS and once with very small ones so
+// tags and text are split over many buffer refills and token batches.
+// Usage: bench_xml <data dir> [iterations]
+
+#define NANOPRINTF_IMPLEMENTATION
+#define NANOPRINTF_SNPRINTF_SAFE_TRIM_STRING_ON_OVERFLOW
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "lithiumx.h"
+
+typedef struct
+{
+    const char *folder;
+    const char *title;
+    const char *title_id;
+    const char *developer;
+    const char *publisher;
+    const char *release_date;
+    float rating;
+    const char *overview_start;
+    int overview_len;
+} xml_sample_t;
+
+static const xml_sample_t samples[] = {
+    {"simple", "Halo: Combat Evolved", "4D530004", "Bungie", "Microsoft Game Studios", "2001-11-15", 9.4f,
+     "Earth is at war with the Covenant", 84},
+    // Over 300 tokens with the wanted tags after the unwanted ones, and an overview larger than the small buffer
+    {"large", "Wasteland Courier", "5553000A", "Example Developer", "Example Publisher", "2004-03-03", 7.3f,
+     "Three years after the events of the first game", 1559},
+    {"entities", "Tom Clancy's Splinter Cell: Chaos Theory", "5553004F", "Ubisoft Montreal & Ubisoft Milan",
+     "Ubisoft", "2005-03-28", 0.0f, "Sam Fisher returns. \"Stealth <is> the only option\".", 51},
+};
+
+void dash_printf(dash_debug_level_t level, const char *format, ...)
+{
+    if (level < LEVEL_WARN)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+static bool check_field(const char *sample, const char *name, const char *got, const char *expected)
+{
+    if (strcmp(got, expected) != 0)
+    {
+        printf("%s: %s was \"%s\", expected \"%s\"\n", sample, name, got, expected);
+        return false;
+    }
+    return true;
+}
+
+static bool check_sample(const char *data_dir, const xml_sample_t *s, uint64_t *ticks, int iterations)
+{
+    char path[DASH_MAX_PATH];
+    char title[MAX_META_LEN], title_id[MAX_META_LEN], developer[MAX_META_LEN], publisher[MAX_META_LEN];
+    char release_date[MAX_META_LEN], overview[MAX_OVERVIEW_LEN];
+    float rating;
+    bool ok = true;
+
+    lv_snprintf(path, sizeof(path), "%s%c%s%c_resources%cdefault.xml", data_dir, DASH_PATH_SEPARATOR, s->folder,
+                DASH_PATH_SEPARATOR, DASH_PATH_SEPARATOR);
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < iterations; i++)
+    {
+        title[0] = title_id[0] = developer[0] = publisher[0] = release_date[0] = overview[0] = '\0';
+        rating = 0.0f;
+        if (dash_xml_parse(path, title, title_id, developer, publisher, release_date, &rating, overview) == false)
+        {
+            printf("%s: could not be parsed\n", path);
+            *ticks = 0;
+            return false;
+        }
+    }
+    *ticks = SDL_GetPerformanceCounter() - start;
+
+    ok &= check_field(s->folder, "title", title, s->title);
+    ok &= check_field(s->folder, "titleid", title_id, s->title_id);
+    ok &= check_field(s->folder, "developer", developer, s->developer);
+    ok &= check_field(s->folder, "publisher", publisher, s->publisher);
+    ok &= check_field(s->folder, "release_date", release_date, s->release_date);
+    if (rating < s->rating - 0.01f || rating > s->rating + 0.01f)
+    {
+        printf("%s: rating was %f, expected %f\n", s->folder, rating, s->rating);
+        ok = false;
+    }
+    if (strncmp(overview, s->overview_start, strlen(s->overview_start)) != 0 ||
+        (int)strlen(overview) != s->overview_len)
+    {
+        printf("%s: overview was \"%.48s...\" (%d chars), expected \"%s...\" (%d chars)\n", s->folder, overview,
+               (int)strlen(overview), s->overview_start, s->overview_len);
+        ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <data dir> [iterations]\n", argv[0]);
+        return 1;
+    }
+    int iterations = (argc > 2) ? atoi(argv[2]) : 1000;
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    bool ok = true;
+
+    printf("DASH_XML_CHUNK_SIZE %d, DASH_XML_TOKENS %d, %d iterations\n", DASH_XML_CHUNK_SIZE, DASH_XML_TOKENS,
+           iterations);
+    for (int i = 0; i < (int)DASH_ARRAY_SIZE(samples); i++)
+    {
+        uint64_t ticks;
+        bool sample_ok = check_sample(argv[1], &samples[i], &ticks, iterations);
+        printf("%-10s %s %8.2f us/file\n", samples[i].folder, sample_ok ? "ok  " : "FAIL",
+               (double)ticks * 1000000.0 / freq / iterations);
+        ok &= sample_ok;
+    }
+    return ok ? 0 : 1;
+}
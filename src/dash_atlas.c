@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+// Thumbnails are all scaled to the same width, so instead of each one having its own allocation they are packed
+// into large shared pages. A page is a single image the width of a thumbnail with DASH_ATLAS_PAGE_SLOTS thumbnails
+// stacked on top of each other, so each slot is also a valid standalone image for lvgl. Freed slots are reused
+// before a new page is allocated and empty pages are released. The GPU driver can bind a whole page as one
+// texture and draw each thumbnail as a sub-rectangle of it.
+// With DASH_ATLAS_POT_LAYOUT rows are padded to a power of two and pages are allocated with the platform's texture
+// allocator, so a page is already a valid texture and the jpeg decoder can write thumbnails straight into it.
+
+#include "lithiumx.h"
+#ifdef NXDK
+#include "lvgl_drivers/video/xgu/lv_xgu_draw.h"
+#include <xboxkrnl/xboxkrnl.h>
+#endif
+
+typedef struct atlas_page
+{
+    struct atlas_page *next;
+    void *mem;
+    uint8_t *pixels;
+    uint32_t free_mask; // A bit is set for each free slot
+    uint32_t generation[DASH_ATLAS_PAGE_SLOTS];
+} atlas_page_t;
+
+static atlas_page_t *atlas_pages;
+static SDL_mutex *atlas_mutex;
+static int atlas_slot_w;
+static int atlas_slot_h;
+static int atlas_bpp;
+static int atlas_pitch; // Bytes per row
+static int atlas_page_rows;
+static int atlas_slots;
+static uint32_t atlas_generation;
+
+static inline int atlas_slot_bytes(void)
+{
+    return atlas_pitch * atlas_slot_h;
+}
+
+static inline int atlas_pot(int num)
+{
+    int pot = 1;
+    while (pot < num)
+    {
+        pot <<= 1;
+    }
+    return pot;
+}
+
+// Page memory. On Xbox it is contiguous and write combined so the gpu can read it directly as a texture,
+// and the decoder's sequential writes into it are cheap
+static void *atlas_mem_alloc(size_t size)
+{
+#ifdef NXDK
+    return MmAllocateContiguousMemoryEx(size, 0, 0xFFFFFFFF, 0, PAGE_WRITECOMBINE | PAGE_READWRITE);
+#else
+    return malloc(size + 16);
+#endif
+}
+
+static void atlas_mem_free(void *mem)
+{
+#ifdef NXDK
+    MmFreeContiguousMemory(mem);
+#else
+    free(mem);
+#endif
+}
+
+static inline uint32_t atlas_full_mask(void)
+{
+    return (atlas_slots == 32) ? 0xFFFFFFFF : ((1u << atlas_slots) - 1);
+}
+
+static atlas_page_t *atlas_page_create(void)
+{
+    atlas_page_t *page = malloc(sizeof(atlas_page_t));
+    if (page == NULL)
+    {
+        return NULL;
+    }
+    page->mem = atlas_mem_alloc(atlas_pitch * atlas_page_rows);
+    if (page->mem == NULL)
+    {
+        free(page);
+        return NULL;
+    }
+    page->pixels = (uint8_t *)(((uintptr_t)page->mem + 15) & ~(uintptr_t)15);
+    page->free_mask = atlas_full_mask();
+    memset(page->generation, 0, sizeof(page->generation));
+    page->next = atlas_pages;
+    atlas_pages = page;
+    return page;
+}
+
+// Must be called with atlas_mutex held
+static atlas_page_t *atlas_page_find(const void *buf, int *slot)
+{
+    atlas_page_t *page = atlas_pages;
+    while (page)
+    {
+        const uint8_t *b = buf;
+        if (b >= page->pixels && b < page->pixels + atlas_slot_bytes() * atlas_slots)
+        {
+            *slot = (b - page->pixels) / atlas_slot_bytes();
+            return page;
+        }
+        page = page->next;
+    }
+    return NULL;
+}
+
+#ifdef NXDK
+static bool atlas_xgu_lookup(const void *buf, lv_draw_xgu_atlas_region_t *region)
+{
+    dash_atlas_region_t r;
+    if (dash_atlas_lookup(buf, &r) == false)
+    {
+        return false;
+    }
+    region->page = r.page;
+    region->page_w = r.pitch / atlas_bpp;
+    region->page_h = r.page_h;
+    region->slot = r.slot;
+    region->slots = atlas_slots;
+    region->y = r.y;
+    region->generation = r.generation;
+    region->direct = DASH_ATLAS_POT_LAYOUT;
+    return true;
+}
+#endif
+
+void dash_atlas_init(int slot_w, int slot_h, int bpp)
+{
+    atlas_slot_w = slot_w;
+    atlas_slot_h = slot_h;
+    atlas_bpp = bpp;
+    atlas_slots = LV_CLAMP(1, DASH_ATLAS_MAX_PAGE_HEIGHT / slot_h, DASH_ATLAS_PAGE_SLOTS);
+#if DASH_ATLAS_POT_LAYOUT
+    atlas_pitch = atlas_pot(slot_w) * bpp;
+    atlas_page_rows = atlas_pot(slot_h * atlas_slots);
+#else
+    atlas_pitch = slot_w * bpp;
+    atlas_page_rows = slot_h * atlas_slots;
+#endif
+    atlas_mutex = SDL_CreateMutex();
+    assert(atlas_mutex);
+#ifdef NXDK
+    lv_draw_xgu_set_atlas_lookup(atlas_xgu_lookup);
+#endif
+}
+
+// Take a free slot for an image to be written into, pitch bytes per row. Images narrower or wider than a slot cannot
+// be packed and return NULL. Images taller than a slot are cropped and h is updated. Thread safe.
+void *dash_atlas_reserve(int w, int *h, int *pitch)
+{
+    if (w != atlas_slot_w)
+    {
+        return NULL;
+    }
+    *h = LV_MIN(*h, atlas_slot_h);
+    *pitch = atlas_pitch;
+
+    SDL_LockMutex(atlas_mutex);
+
+    // Fill the fullest page first so the others have a chance to empty and be released
+    atlas_page_t *best = NULL;
+    for (atlas_page_t *page = atlas_pages; page; page = page->next)
+    {
+        if (page->free_mask && (best == NULL || __builtin_popcount(page->free_mask) < __builtin_popcount(best->free_mask)))
+        {
+            best = page;
+        }
+    }
+    if (best == NULL)
+    {
+        best = atlas_page_create();
+        if (best == NULL)
+        {
+            SDL_UnlockMutex(atlas_mutex);
+            return NULL;
+        }
+    }
+
+    int slot = __builtin_ctz(best->free_mask);
+    best->free_mask &= ~(1u << slot);
+    best->generation[slot] = ++atlas_generation;
+    uint8_t *dst = best->pixels + slot * atlas_slot_bytes();
+    SDL_UnlockMutex(atlas_mutex);
+    return dst;
+}
+
+// Copy a packed image into a free slot. Same as dash_atlas_reserve() otherwise.
+void *dash_atlas_alloc(const void *img, int w, int *h)
+{
+    int pitch;
+    uint8_t *dst = dash_atlas_reserve(w, h, &pitch);
+    if (dst == NULL)
+    {
+        return NULL;
+    }
+
+    int row_size = w * atlas_bpp;
+    if (pitch == row_size)
+    {
+        memcpy(dst, img, row_size * (*h));
+        return dst;
+    }
+    for (int y = 0; y < *h; y++)
+    {
+        memcpy(&dst[y * pitch], (const uint8_t *)img + y * row_size, row_size);
+    }
+    return dst;
+}
+
+// Return a slot from dash_atlas_reserve() or dash_atlas_alloc(). Thread safe.
+void dash_atlas_free(void *slot)
+{
+    int index;
+    if (slot == NULL)
+    {
+        return;
+    }
+
+    SDL_LockMutex(atlas_mutex);
+    atlas_page_t *page = atlas_page_find(slot, &index);
+    assert(page);
+    if (page == NULL)
+    {
+        SDL_UnlockMutex(atlas_mutex);
+        return;
+    }
+    page->free_mask |= (1u << index);
+
+    // Keep one empty page around so a page isn't allocated and freed over and over while scrolling
+    if (page->free_mask == atlas_full_mask())
+    {
+        atlas_page_t **prev = &atlas_pages;
+        atlas_page_t *other = atlas_pages;
+        while (other && (other == page || other->free_mask != atlas_full_mask()))
+        {
+            other = other->next;
+        }
+        if (other)
+        {
+            while (*prev != page)
+            {
+                prev = &(*prev)->next;
+            }
+            *prev = page->next;
+            atlas_mem_free(page->mem);
+            free(page);
+        }
+    }
+    SDL_UnlockMutex(atlas_mutex);
+}
+
+// Find the page and slot an image buffer from dash_atlas_alloc() is in. Returns false if it's not in the atlas.
+bool dash_atlas_lookup(const void *buf, dash_atlas_region_t *region)
+{
+    int slot;
+    SDL_LockMutex(atlas_mutex);
+    atlas_page_t *page = atlas_page_find(buf, &slot);
+    if (page)
+    {
+        region->page = page->pixels;
+        region->page_w = atlas_slot_w;
+        region->page_h = atlas_page_rows;
+        region->pitch = atlas_pitch;
+        region->slot = slot;
+        region->y = slot * atlas_slot_h;
+        region->generation = page->generation[slot];
+    }
+    SDL_UnlockMutex(atlas_mutex);
+    return page != NULL;
+}
+
+// The memory each thumbnail in the atlas uses, regardless of its height
+int dash_atlas_slot_size(void)
+{
+    return atlas_slot_bytes();
+}
+
+// The row size of a slot in pixels. Slots can be wider than the image when rows are padded
+int dash_atlas_stride(void)
+{
+    return atlas_pitch / atlas_bpp;
+}
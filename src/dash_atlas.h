@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+#ifndef _DASH_ATLAS_H
+#define _DASH_ATLAS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lithiumx.h"
+
+// Where a slot sits within its atlas page
+typedef struct
+{
+    void *page;          // Start of the page's pixels
+    int page_w;          // Size of the whole page in pixels
+    int page_h;
+    int pitch;           // Bytes per row
+    int slot;            // Slot index. Slots are stacked vertically, so the slot starts at row slot * slot_h
+    int y;
+    uint32_t generation; // Changes every time the slot is handed out
+} dash_atlas_region_t;
+
+void dash_atlas_init(int slot_w, int slot_h, int bpp);
+void *dash_atlas_reserve(int w, int *h, int *pitch);
+void *dash_atlas_alloc(const void *img, int w, int *h);
+void dash_atlas_free(void *slot);
+bool dash_atlas_lookup(const void *buf, dash_atlas_region_t *region);
+int dash_atlas_slot_size(void);
+int dash_atlas_stride(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
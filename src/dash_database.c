@@ -5,16 +5,158 @@
 
 static sqlite3 *db = NULL;
 static SDL_mutex *db_mutex;
-static int item_index;
+static int rebuild_scan_id;
+static db_rebuild_callback rebuild_callback;
+static volatile bool rebuild_abort;
+static sqlite3_stmt *title_insert_stmt;
+static int title_insert_depth;
+static int title_insert_rows;
+static uint32_t title_insert_start;
+static sqlite3_stmt *query_cache[DB_QUERY_MAX];
+static bool db_wal_enabled;
+
+// A read-only connection owned by a single thread. In WAL mode readers don't block the writer
+// or each other so they don't need db_mutex.
+struct db_reader
+{
+    sqlite3 *db;
+    sqlite3_stmt *query_cache[DB_QUERY_MAX];
+};
+
+static const char *query_sql[DB_QUERY_MAX] = {
+    [DB_QUERY_TITLE_GET_BY_ID] = SQL_TITLE_GET_BY_ID,
+    [DB_QUERY_TITLE_GET_LAUNCH_PATH] = SQL_TITLE_GET_LAUNCH_PATH,
+    [DB_QUERY_TITLE_SET_LAST_LAUNCH] = SQL_TITLE_SET_LAST_LAUNCH_DATETIME,
+    [DB_QUERY_TITLE_GET_RECENT] = SQL_TITLE_GET_RECENT,
+    [DB_QUERY_TITLE_GET_RECENT_BY_PATH] = SQL_TITLE_GET_RECENT_BY_PATH,
+    [DB_QUERY_TITLE_LIST_BY_NAME] = SQL_TITLE_GET_SORTED_LIST(SQL_TITLE_NAME " COLLATE NOCASE ASC"),
+    [DB_QUERY_TITLE_LIST_BY_RATING] = SQL_TITLE_GET_SORTED_LIST(SQL_TITLE_RATING " DESC"),
+    [DB_QUERY_TITLE_LIST_BY_LAST_LAUNCH] = SQL_TITLE_GET_SORTED_LIST(SQL_TITLE_LAST_LAUNCH " DESC"),
+    [DB_QUERY_TITLE_LIST_BY_RELEASE_DATE] = SQL_TITLE_GET_SORTED_LIST(SQL_TITLE_RELEASE_DATE " DESC"),
+    [DB_QUERY_TITLE_SEARCH] = SQL_SEARCH_TITLES,
+    [DB_QUERY_XBE_GET] = SQL_XBE_GET,
+    [DB_QUERY_XBE_INSERT] = SQL_XBE_INSERT,
+    [DB_QUERY_TITLE_GET_BY_PATH] = SQL_TITLE_GET_BY_PATH,
+    [DB_QUERY_TITLE_DELETE_BY_PATH] = SQL_TITLE_DELETE_BY_PATH,
+    [DB_QUERY_FOLDER_GET] = SQL_FOLDER_GET,
+    [DB_QUERY_FOLDER_MARK_SEEN] = SQL_FOLDER_MARK_SEEN,
+    [DB_QUERY_FOLDER_INSERT] = SQL_FOLDER_INSERT,
+    [DB_QUERY_TITLE_GET_STALE] = SQL_TITLE_GET_STALE,
+    [DB_QUERY_TITLE_DELETE_STALE] = SQL_TITLE_DELETE_STALE,
+};
+
+// What we keep from an xbe certificate. The title is empty if the xbe didn't have a usable one
+typedef struct
+{
+    char title[MAX_META_LEN];
+    uint32_t title_id;
+    uint32_t region;
+    uint32_t media_flags;
+    uint32_t version;
+} xbe_info_t;
+
+typedef struct
+{
+    int64_t dir_mtime;
+    int64_t xbe_size;
+    int64_t xbe_mtime;
+    int64_t xml_mtime;
+} folder_fingerprint_t;
+
+// Titles (id, page) that are about to be removed. Collected first so the rebuild callback runs
+// after the changes are committed and without the database locked
+typedef struct
+{
+    struct
+    {
+        int db_id;
+        char page[MAX_META_LEN];
+    } *titles;
+    int cnt;
+} removed_titles_t;
+
+// Database rebuilds are done with a pool of scan workers. The workers first enumerate every search path
+// concurrently, then parse each game folder they found. Parsed results are placed in a small ring of
+// slots in the order the folders were claimed, so the rebuild thread can write them to the database
+// in a deterministic order regardless of which worker finishes first.
+typedef enum
+{
+    SCAN_SLOT_FREE,
+    SCAN_SLOT_BUSY,
+    SCAN_SLOT_READY
+} scan_slot_state_t;
+
+typedef struct
+{
+    char *name;
+    int64_t mtime;
+} scan_folder_t;
+
+typedef struct
+{
+    const char *page_title;
+    const char *path;
+    scan_folder_t *folders;
+    int folder_cnt;
+} scan_path_t;
+
+typedef struct
+{
+    scan_slot_state_t state;
+    int seq;         // The folder sequence number this slot is reserved for
+    bool valid;      // Folder contained a launchable xbe
+    bool unchanged;  // Folder fingerprint matched the previous scan, nothing was parsed
+    const char *page_title;
+    folder_fingerprint_t fingerprint;
+    char launch_path[DASH_MAX_PATH];
+    char title[MAX_META_LEN];
+    char title_id[MAX_META_LEN];
+    char developer[MAX_META_LEN];
+    char publisher[MAX_META_LEN];
+    char release_date[MAX_META_LEN];
+    char overview[MAX_OVERVIEW_LEN];
+    float rating;
+    xbe_info_t xbe;           // Certificate info that was read from the xbe instead of the cache
+    bool xbe_uncached;        // The writer should add xbe to the cache
+    char thumb_path[DASH_MAX_PATH]; // Empty if the folder has no thumbnail
+    int db_id;                // Id the title was stored with, -1 if nothing was stored
+    removed_titles_t removed; // Titles this folder replaced
+} scan_slot_t;
+
+typedef struct
+{
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    scan_path_t paths[DASH_MAX_PAGES * DASH_MAX_PATHS_PER_PAGE];
+    int path_cnt;
+    int next_path;          // The next path to be enumerated
+    int enumerated_workers; // Number of workers that have finished enumerating paths
+    int claim_path;         // The next folder to be parsed
+    int claim_folder;
+    int next_seq;
+    bool abort;             // Set by the rebuild thread to make the workers stop claiming folders
+    scan_slot_t slots[DASH_SCAN_THREADS * 4];
+} scan_ctx_t;
+
+// Titles are committed in batches so they survive an interrupted rebuild and show up for reader connections.
+// A batch is whatever results are ready, up to this many
+#define SCAN_COMMIT_INTERVAL 64
 
 static const char *no_meta = "No Meta-Data";
 static const char *no_id = "00000000";
 
-static void parse_folder(const char *page_title, const char *folderPath, const char *filename_to_find);
-static bool parse_xml(const char *xml_path, char *title, char *title_id, char *developer,
-                      char *publisher, char *release_date, float *rating, char *overview);
+static void clean_path(char *path);
+static int scan_worker_f(void *param);
+static void scan_store_slot(scan_slot_t *slot);
+static void scan_notify_slot(scan_slot_t *slot);
+static bool xbe_get_info(db_reader_t *reader, const char *xbe_path, int64_t size, int64_t mtime,
+                         xbe_info_t *info, bool *read_file);
+static void xbe_store_info(const char *xbe_path, int64_t size, int64_t mtime, const xbe_info_t *info);
+static void xbe_info_to_title(const xbe_info_t *info, const char *xbe_path, const char *xbe_folder,
+                              char *title, char *title_id);
 
 int db_rebuild_scanned_items;
+int db_rebuild_unchanged_items;
 
 void db_command_with_callback(const char *command, sqlcmd_callback callback, void *param)
 {
@@ -36,6 +178,149 @@ void db_command_with_callback(const char *command, sqlcmd_callback callback, voi
     SDL_UnlockMutex(db_mutex);
 }
 
+// Get the cached statement for a query, preparing it the first time it is used. The database stays
+// locked until db_query_run() is called so other threads can't use the statement in the meantime.
+sqlite3_stmt *db_query_begin(db_query_t query)
+{
+    int rc;
+    assert(query < DB_QUERY_MAX);
+
+    SDL_LockMutex(db_mutex);
+    if (query_cache[query] == NULL)
+    {
+        rc = sqlite3_prepare_v3(db, query_sql[query], -1, SQLITE_PREPARE_PERSISTENT, &query_cache[query], NULL);
+        if (rc != SQLITE_OK)
+        {
+            dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+        }
+        assert(rc == SQLITE_OK);
+    }
+    return query_cache[query];
+}
+
+void db_bind_int(sqlite3_stmt *stmt, int index, int value)
+{
+    int rc = sqlite3_bind_int(stmt, index, value);
+    assert(rc == SQLITE_OK);
+    (void)rc;
+}
+
+void db_bind_int64(sqlite3_stmt *stmt, int index, int64_t value)
+{
+    int rc = sqlite3_bind_int64(stmt, index, value);
+    assert(rc == SQLITE_OK);
+    (void)rc;
+}
+
+void db_bind_double(sqlite3_stmt *stmt, int index, double value)
+{
+    int rc = sqlite3_bind_double(stmt, index, value);
+    assert(rc == SQLITE_OK);
+    (void)rc;
+}
+
+// The string must remain valid until db_query_run() returns
+void db_bind_text(sqlite3_stmt *stmt, int index, const char *value)
+{
+    int rc = sqlite3_bind_text(stmt, index, value, -1, SQLITE_STATIC);
+    assert(rc == SQLITE_OK);
+    (void)rc;
+}
+
+// Open a read-only connection for the calling thread. Returns NULL if the database can't be shared,
+// in which case db_reader_query_begin() falls back to the main connection.
+db_reader_t *db_reader_open(void)
+{
+    if (db_wal_enabled == false)
+    {
+        return NULL;
+    }
+
+    db_reader_t *reader = lv_mem_alloc(sizeof(db_reader_t));
+    assert(reader);
+    lv_memset(reader, 0, sizeof(db_reader_t));
+
+    int rc = sqlite3_open_v2(DASH_DATABASE_PATH, &reader->db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL);
+    if (rc != SQLITE_OK)
+    {
+        dash_printf(LEVEL_WARN, "SQL WARN: Could not open read connection: %s\n", sqlite3_errmsg(reader->db));
+        sqlite3_close(reader->db);
+        lv_mem_free(reader);
+        return NULL;
+    }
+    sqlite3_busy_timeout(reader->db, DASH_DB_BUSY_TIMEOUT);
+    return reader;
+}
+
+void db_reader_close(db_reader_t *reader)
+{
+    if (reader == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < DB_QUERY_MAX; i++)
+    {
+        sqlite3_finalize(reader->query_cache[i]);
+    }
+    sqlite3_close(reader->db);
+    lv_mem_free(reader);
+}
+
+// Same as db_query_begin() but runs the query on the thread's own read connection.
+sqlite3_stmt *db_reader_query_begin(db_reader_t *reader, db_query_t query)
+{
+    int rc;
+    assert(query < DB_QUERY_MAX);
+
+    if (reader == NULL)
+    {
+        return db_query_begin(query);
+    }
+
+    if (reader->query_cache[query] == NULL)
+    {
+        rc = sqlite3_prepare_v3(reader->db, query_sql[query], -1, SQLITE_PREPARE_PERSISTENT,
+                                &reader->query_cache[query], NULL);
+        if (rc != SQLITE_OK)
+        {
+            dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(reader->db));
+        }
+        assert(rc == SQLITE_OK);
+        assert(sqlite3_stmt_readonly(reader->query_cache[query]));
+    }
+    return reader->query_cache[query];
+}
+
+// Step through the results of a query from db_query_begin(), calling callback for each row.
+// Returns the number of rows that were passed to the callback.
+int db_query_run(sqlite3_stmt *stmt, db_row_callback callback, void *param)
+{
+    int rc, rows = 0;
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        rows++;
+        if (callback == NULL || callback(param, stmt) != 0)
+        {
+            rc = SQLITE_DONE;
+            break;
+        }
+    }
+    if (rc != SQLITE_DONE)
+    {
+        dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(sqlite3_db_handle(stmt)));
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    // Reader connections are private to their thread and were never locked
+    if (sqlite3_db_handle(stmt) == db)
+    {
+        SDL_UnlockMutex(db_mutex);
+    }
+    return rows;
+}
+
 void db_insert(const char *command, int argc, const char *format, ...)
 {
     dash_printf(LEVEL_TRACE, "Processing SQL insert command %s\n", command);
@@ -111,9 +396,217 @@ void db_insert_blob(const char *command, void *blob, int len)
     SDL_UnlockMutex(db_mutex);
 }
 
+// Title inserts between db_title_insert_begin() and db_title_insert_end() are wrapped in a single
+// transaction and reuse the same prepared statement. Calls can be nested, only the outer most pair
+// begins and commits the transaction.
+// The calling thread keeps the database locked until the transaction is committed, so other threads
+// can't have their writes mixed into it. Keep transactions short and don't lock lvgl inside one.
+void db_title_insert_begin(void)
+{
+    int rc;
+    SDL_LockMutex(db_mutex);
+    if (title_insert_depth++ == 0)
+    {
+        if (title_insert_stmt == NULL)
+        {
+            rc = sqlite3_prepare_v2(db, SQL_TITLE_INSERT, -1, &title_insert_stmt, NULL);
+            assert(rc == SQLITE_OK);
+        }
+        rc = sqlite3_exec(db, SQL_BEGIN, NULL, NULL, NULL);
+        if (rc != SQLITE_OK)
+        {
+            dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+        }
+        title_insert_rows = 0;
+        title_insert_start = SDL_GetTicks();
+    }
+}
+
+// Returns the id the title was stored with
+int db_title_insert(const db_title_row_t *row)
+{
+    sqlite3_stmt *stmt = title_insert_stmt;
+    int rc, db_id;
+
+    SDL_LockMutex(db_mutex);
+    assert(title_insert_depth > 0);
+    // Binding NULL to the primary key gives the next unused id
+    if (row->db_id < 0)
+    {
+        sqlite3_bind_null(stmt, DB_INDEX_ID + 1);
+    }
+    else
+    {
+        sqlite3_bind_int(stmt, DB_INDEX_ID + 1, row->db_id);
+    }
+    sqlite3_bind_text(stmt, DB_INDEX_TITLE_ID + 1, row->title_id, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, DB_INDEX_TITLE + 1, row->title, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, DB_INDEX_LAUNCH_PATH + 1, row->launch_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, DB_INDEX_PAGE + 1, row->page, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, DB_INDEX_DEVELOPER + 1, row->developer, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, DB_INDEX_PUBLISHER + 1, row->publisher, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, DB_INDEX_RELEASE_DATE + 1, row->release_date, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, DB_INDEX_OVERVIEW + 1, row->overview, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, DB_INDEX_LAST_LAUNCH + 1, row->last_launch, -1, SQLITE_STATIC);
+    // Ratings are only shown to one decimal place, round so floats like 7.3 dont show as 7.30000019
+    sqlite3_bind_double(stmt, DB_INDEX_RATING + 1, (int)(row->rating * 10.0f + 0.5f) / 10.0);
+
+    rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+    }
+    assert(rc == SQLITE_DONE);
+    db_id = (int)sqlite3_last_insert_rowid(db);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    title_insert_rows++;
+    SDL_UnlockMutex(db_mutex);
+    return db_id;
+}
+
+void db_title_insert_end(void)
+{
+    int rc;
+    SDL_LockMutex(db_mutex);
+    assert(title_insert_depth > 0);
+    if (--title_insert_depth == 0)
+    {
+        rc = sqlite3_exec(db, SQL_FLUSH, NULL, NULL, NULL);
+        if (rc != SQLITE_OK)
+        {
+            dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+        }
+        uint32_t ms = LV_MAX(SDL_GetTicks() - title_insert_start, 1);
+        dash_printf(LEVEL_TRACE, "Inserted %d titles in %d ms (%d rows/s)\n",
+                    title_insert_rows, ms, title_insert_rows * 1000 / ms);
+    }
+    SDL_UnlockMutex(db_mutex);
+    // Release the lock taken by db_title_insert_begin()
+    SDL_UnlockMutex(db_mutex);
+}
+
+static int db_get_int(const char *command)
+{
+    sqlite3_stmt *stmt;
+    int rc, value = 0;
+
+    SDL_LockMutex(db_mutex);
+    rc = sqlite3_prepare_v2(db, command, -1, &stmt, NULL);
+    assert(rc == SQLITE_OK);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        value = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    SDL_UnlockMutex(db_mutex);
+    return value;
+}
+
+static int64_t filetime_to_int64(const FILETIME *ft)
+{
+    return ((int64_t)ft->dwHighDateTime << 32) | (int64_t)ft->dwLowDateTime;
+}
+
+typedef struct
+{
+    const folder_fingerprint_t *fp;
+    bool unchanged;
+} folder_match_t;
+
+static int folder_fingerprint_callback(void *param, sqlite3_stmt *row)
+{
+    folder_match_t *match = param;
+    match->unchanged = sqlite3_column_int64(row, 0) == match->fp->dir_mtime &&
+                       sqlite3_column_int64(row, 1) == match->fp->xbe_size &&
+                       sqlite3_column_int64(row, 2) == match->fp->xbe_mtime &&
+                       sqlite3_column_int64(row, 3) == match->fp->xml_mtime;
+    return 1;
+}
+
+// Returns true if this folder was scanned previously and nothing has changed since.
+static bool folder_fingerprint_matches(db_reader_t *reader, const char *launch_path, const char *page_title,
+                                       const folder_fingerprint_t *fp)
+{
+    folder_match_t match = {fp, false};
+    sqlite3_stmt *stmt = db_reader_query_begin(reader, DB_QUERY_FOLDER_GET);
+    db_bind_text(stmt, 1, launch_path);
+    db_bind_text(stmt, 2, page_title);
+    db_query_run(stmt, folder_fingerprint_callback, &match);
+    return match.unchanged;
+}
+
+// Mark an unchanged folder as seen by the current scan so it isn't treated as removed.
+static void folder_mark_seen(const char *launch_path, const char *page_title)
+{
+    sqlite3_stmt *stmt = db_query_begin(DB_QUERY_FOLDER_MARK_SEEN);
+    db_bind_int(stmt, 1, rebuild_scan_id);
+    db_bind_text(stmt, 2, launch_path);
+    db_bind_text(stmt, 3, page_title);
+    db_query_run(stmt, NULL, NULL);
+}
+
+static void folder_store(const char *launch_path, const char *page_title, const folder_fingerprint_t *fp)
+{
+    sqlite3_stmt *stmt = db_query_begin(DB_QUERY_FOLDER_INSERT);
+    db_bind_text(stmt, 1, launch_path);
+    db_bind_text(stmt, 2, page_title);
+    db_bind_int64(stmt, 3, fp->dir_mtime);
+    db_bind_int64(stmt, 4, fp->xbe_size);
+    db_bind_int64(stmt, 5, fp->xbe_mtime);
+    db_bind_int64(stmt, 6, fp->xml_mtime);
+    db_bind_int(stmt, 7, rebuild_scan_id);
+    db_query_run(stmt, NULL, NULL);
+}
+
+static int removed_titles_callback(void *param, sqlite3_stmt *row)
+{
+    removed_titles_t *removed = param;
+    removed->titles = lv_mem_realloc(removed->titles, (removed->cnt + 1) * sizeof(removed->titles[0]));
+    assert(removed->titles);
+    removed->titles[removed->cnt].db_id = sqlite3_column_int(row, 0);
+    lv_snprintf(removed->titles[removed->cnt].page, MAX_META_LEN, "%s", sqlite3_column_text(row, 1));
+    removed->cnt++;
+    return 0;
+}
+
+// Tell the rebuild callback about each removed title and free the list
+static void rebuild_notify_removed(removed_titles_t *removed)
+{
+    for (int i = 0; i < removed->cnt && rebuild_callback; i++)
+    {
+        db_title_row_t row = {.db_id = removed->titles[i].db_id, .page = removed->titles[i].page};
+        rebuild_callback(DB_REBUILD_TITLE_REMOVED, &row);
+    }
+    lv_mem_free(removed->titles);
+    removed->titles = NULL;
+    removed->cnt = 0;
+}
+
+// Remove the title of a folder that changed. The removed titles are added to removed. Returns the id
+// of the first so the replacement can keep it, or -1
+static int title_delete_by_path(const char *launch_path, const char *page_title, removed_titles_t *removed)
+{
+    sqlite3_stmt *stmt = db_query_begin(DB_QUERY_TITLE_GET_BY_PATH);
+    db_bind_text(stmt, 1, launch_path);
+    db_bind_text(stmt, 2, page_title);
+    db_query_run(stmt, removed_titles_callback, removed);
+    int db_id = (removed->cnt > 0) ? removed->titles[0].db_id : -1;
+
+    stmt = db_query_begin(DB_QUERY_TITLE_DELETE_BY_PATH);
+    db_bind_text(stmt, 1, launch_path);
+    db_bind_text(stmt, 2, page_title);
+    db_query_run(stmt, NULL, NULL);
+    return db_id;
+}
+
 bool db_open()
 {
+    sqlite3_stmt *stmt;
     db_mutex = SDL_CreateMutex();
+#ifdef WIN32
+    sqlite3_register_win32_mutex();
+#endif
     sqlite3_initialize();
     int rc = sqlite3_open(DASH_DATABASE_PATH, &db);
     if (rc != 0)
@@ -124,23 +617,98 @@ bool db_open()
         assert(rc == 0);
         return false;
     }
+    sqlite3_busy_timeout(db, DASH_DB_BUSY_TIMEOUT);
+
+    // This connection is the only writer. WAL mode lets reader connections run alongside it
+    char mode[8] = {0};
+    rc = sqlite3_prepare_v2(db, SQL_JOURNAL_MODE_WAL, -1, &stmt, NULL);
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        strncpy(mode, (const char *)sqlite3_column_text(stmt, 0), sizeof(mode) - 1);
+    }
+    sqlite3_finalize(stmt);
+    db_wal_enabled = (strcmp(mode, "wal") == 0);
+    if (db_wal_enabled == false)
+    {
+        dash_printf(LEVEL_WARN, "SQL WARN: Could not enable WAL mode. Pages will populate one at a time\n");
+    }
     return true;
 }
 
 bool db_close()
 {
     db_command_with_callback(SQL_FLUSH, NULL, NULL);
+    sqlite3_finalize(title_insert_stmt);
+    title_insert_stmt = NULL;
+    for (int i = 0; i < DB_QUERY_MAX; i++)
+    {
+        sqlite3_finalize(query_cache[i]);
+        query_cache[i] = NULL;
+    }
     SDL_DestroyMutex(db_mutex);
     sqlite3_close(db);
     return true;
 }
 
+// Bring the title table up to SQL_SCHEMA_VERSION. Values stored as text by older versions are converted
+// to their numeric type and the page sort indexes are created.
+static void db_migrate_titles(void)
+{
+    char cmd[SQL_MAX_COMMAND_LEN];
+    int version = db_get_int(SQL_GET_SCHEMA_VERSION);
+    int rc;
+
+    if (version >= SQL_SCHEMA_VERSION)
+    {
+        return;
+    }
+    dash_printf(LEVEL_TRACE, "Migrating database schema from version %d to %d\n", version, SQL_SCHEMA_VERSION);
+
+    if (version < 1)
+    {
+        rc = sqlite3_exec(db, SQL_TITLE_CONVERT_TYPES, NULL, 0, NULL);
+        if (rc != SQLITE_OK)
+        {
+            dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+            assert(rc == SQLITE_OK);
+            return;
+        }
+        rc = sqlite3_exec(db, SQL_TITLE_CREATE_INDEXES, NULL, 0, NULL);
+        if (rc != SQLITE_OK)
+        {
+            dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+            assert(rc == SQLITE_OK);
+            return;
+        }
+    }
+
+    if (version < 2)
+    {
+        // The search index is rebuilt from scratch from whatever titles are already in the table
+        rc = sqlite3_exec(db, SQL_SEARCH_DELETE_TABLE ";" SQL_SEARCH_CREATE_TABLE ";" SQL_SEARCH_CREATE_TRIGGERS
+                          SQL_SEARCH_REBUILD, NULL, 0, NULL);
+        if (rc != SQLITE_OK)
+        {
+            dash_printf(LEVEL_ERROR, "SQL ERROR: %s\n", sqlite3_errmsg(db));
+            assert(rc == SQLITE_OK);
+            return;
+        }
+    }
+
+    lv_snprintf(cmd, sizeof(cmd), SQL_SET_SCHEMA_VERSION, SQL_SCHEMA_VERSION);
+    db_command_with_callback(cmd, NULL, NULL);
+}
+
 bool db_init(char *err_msg, int err_msg_len)
 {
+    char cmd[SQL_MAX_COMMAND_LEN];
     sqlite3_stmt *stmt;
     int rc, index;
     bool need_game_rebuild = false;
 
+    rc = sqlite3_exec(db, SQL_STATE_CREATE_TABLE, NULL, 0, NULL);
+    assert(rc == SQLITE_OK);
+
     // Check we have a table called xbox_titles
     rc = sqlite3_prepare_v2(db, SQL_TITLE_CHECK_TABLE, -1, &stmt, NULL);
     assert(rc == SQLITE_OK);
@@ -179,11 +747,37 @@ bool db_init(char *err_msg, int err_msg_len)
             lv_snprintf(err_msg, err_msg_len, "Games title table invalid. Database Rebuilt.");
             rc = sqlite3_exec(db, SQL_TITLE_DELETE_TABLE, 0, 0, NULL);
             assert(rc == SQLITE_OK);
+            // Folder fingerprints refer to titles we just dropped, so every folder needs parsing again
+            rc = sqlite3_exec(db, SQL_FOLDER_DELETE_TABLE, 0, 0, NULL);
+            assert(rc == SQLITE_OK);
+            // The indexes were dropped with the table so they need to be created again by the rebuild
+            lv_snprintf(cmd, sizeof(cmd), SQL_SET_SCHEMA_VERSION, 0);
+            db_command_with_callback(cmd, NULL, NULL);
             need_game_rebuild = true;
             dash_printf(LEVEL_WARN, "Database table \"%s\" was missing or had an incorrect column. It will be rebuilt\n", SQL_TITLES_NAME);
         }
     }
 
+    // Create the tables if they dont exist so the pages can query them before the first rebuild has run.
+    // db_rebuild() only fills them
+    rc = sqlite3_exec(db, SQL_TITLE_CREATE_TABLE, NULL, 0, NULL);
+    assert(rc == SQLITE_OK);
+    rc = sqlite3_exec(db, SQL_FOLDER_CREATE_TABLE, NULL, 0, NULL);
+    assert(rc == SQLITE_OK);
+    db_migrate_titles();
+
+    if (need_game_rebuild == false)
+    {
+        // The last rebuild was interrupted (e.g. a title was launched part way through). Carry on from
+        // where it got to
+        lv_snprintf(cmd, sizeof(cmd), SQL_STATE_GET, SQL_STATE_REBUILD_PENDING);
+        if (db_get_int(cmd))
+        {
+            need_game_rebuild = true;
+            dash_printf(LEVEL_TRACE, "The previous database rebuild did not finish. It will continue\n");
+        }
+    }
+
     if (need_game_rebuild == false)
     {
         // Check the database has something in it. If it's empty it may not be an error, but may aswell
@@ -198,6 +792,9 @@ bool db_init(char *err_msg, int err_msg_len)
         {
             need_game_rebuild = true;
             dash_printf(LEVEL_TRACE, "Database table \"%s\" was empty. It will trigger a rescan.\n", SQL_TITLES_NAME);
+            // Folder fingerprints are meaningless without their titles
+            rc = sqlite3_exec(db, SQL_FOLDER_DELETE_ENTRIES, NULL, 0, NULL);
+            assert(rc == SQLITE_OK);
         }
     }
 
@@ -228,33 +825,52 @@ bool db_init(char *err_msg, int err_msg_len)
         assert(rc == SQLITE_OK);
     }
 
+    // The xbe cache is used by the launcher too, so it must exist even if we never rebuild
+    rc = sqlite3_exec(db, SQL_XBE_CREATE_TABLE, NULL, 0, NULL);
+    assert(rc == SQLITE_OK);
+
     return !need_game_rebuild;
 }
 
-bool db_rebuild(toml_table_t *paths)
+bool db_rebuild(toml_table_t *paths, db_rebuild_callback callback)
 {
     toml_array_t *pages = toml_array_in(paths, "pages");
     int num_pages = pages ? (LV_MIN(toml_array_nelem(pages), DASH_MAX_PAGES)) : 0;
-    int rc;
+    SDL_Thread *workers[DASH_SCAN_THREADS];
+    char *page_titles[DASH_MAX_PAGES];
+    char cmd[SQL_MAX_COMMAND_LEN];
+    sqlite3_stmt *stmt;
 
     assert(db);
-    item_index = 0;
     db_rebuild_scanned_items = 0;
-
-    // Create the tables if they dont exists
-    rc = sqlite3_exec(db, SQL_TITLE_CREATE_TABLE, NULL, 0, NULL);
-    assert(rc == SQLITE_OK);
-    if (rc != SQLITE_OK)
+    db_rebuild_unchanged_items = 0;
+
+    // Stays set until the rebuild has finished so an interrupted rebuild is picked up next time
+    lv_snprintf(cmd, sizeof(cmd), SQL_STATE_SET, SQL_STATE_REBUILD_PENDING, 1);
+    db_command_with_callback(cmd, NULL, NULL);
+    rebuild_callback = callback;
+    rebuild_abort = false;
+    rebuild_scan_id = db_get_int(SQL_FOLDER_NEXT_SCAN_ID);
+
+    scan_ctx_t *ctx = lv_mem_alloc(sizeof(scan_ctx_t));
+    assert(ctx);
+    if (ctx == NULL)
     {
         return false;
     }
+    lv_memset(ctx, 0, sizeof(scan_ctx_t));
+    for (unsigned int i = 0; i < DASH_ARRAY_SIZE(ctx->slots); i++)
+    {
+        ctx->slots[i].seq = i;
+    }
 
-    // Scan through every page from the toml file
+    // Gather every search path of every page from the toml file
     for (int page = 0; page < num_pages; page++)
     {
         // Get the name of this page
         toml_datum_t name_str = toml_string_in(toml_table_at(pages, page), "name");
         assert(name_str.ok);
+        page_titles[page] = name_str.u.s;
 
         // Get the search paths associated with this page
         toml_array_t *paths = toml_array_in(toml_table_at(pages, page), "paths");
@@ -264,7 +880,6 @@ bool db_rebuild(toml_table_t *paths)
             num_paths = DASH_MAX_PATHS_PER_PAGE;
         }
 
-        // Scan through every path associated with this page
         for (int path = 0; path < num_paths; path++)
         {
             toml_datum_t path_str = toml_string_at(paths, path);
@@ -272,119 +887,157 @@ bool db_rebuild(toml_table_t *paths)
             {
                 continue;
             }
-
-            // Check folder for folders containing "default.xbe"
-            parse_folder(name_str.u.s, path_str.u.s, "default.xbe");
+            ctx->paths[ctx->path_cnt].page_title = name_str.u.s;
+            ctx->paths[ctx->path_cnt].path = path_str.u.s;
+            ctx->path_cnt++;
         }
     }
-    return true;
-}
 
-static bool get_xml_str(char *xml, sxmltok_t *tokens, int num_tokens, char *key, char *buf, int buf_len)
-{
-    char str[32];
-    for (int i = 0; i < num_tokens; i++)
+    ctx->mutex = SDL_CreateMutex();
+    ctx->cond = SDL_CreateCond();
+    assert(ctx->mutex && ctx->cond);
+    for (int i = 0; i < DASH_SCAN_THREADS; i++)
     {
-        if (tokens[i].type == SXML_STARTTAG)
-        {
-            int len = tokens[i].endpos - tokens[i].startpos;
-            str[len] = '\0';
-            strncpy(str, &xml[tokens[i].startpos], len);
-            if (strcmp(str, key) == 0)
-            {
-                if (i + 1 >= num_tokens)
-                {
-                    break;
-                }
-
-                sxmltok_t *t = &tokens[i + 1];
-                int len1 = t->endpos - t->startpos;
-                if (t->type != SXML_CHARACTER)
-                {
-                    break;
-                }
-
-                int capped_len = LV_MIN(buf_len, len1);
-                strncpy(buf, &xml[t->startpos], capped_len);
-                buf[capped_len] = '\0';
-                return true;
-            }
-        }
+        workers[i] = SDL_CreateThread(scan_worker_f, "db_scan_worker", ctx);
+        assert(workers[i]);
     }
-    return false;
-}
-
-// The dates in the xbmc xml format are dd MMM YYYY, We want it to be YYYY-MM-DD
-static void convert_xml_date_to_iso8601(const char* input, char output[11]) {
-    int day, year;
-    char month[4];
 
-    sscanf(input, "%d %3s %d", &day, month, &year);
+    // Wait for all paths to be enumerated so we know how many folders there are to process
+    int folder_cnt = 0;
+    SDL_LockMutex(ctx->mutex);
+    while (ctx->enumerated_workers < DASH_SCAN_THREADS)
+    {
+        SDL_CondWait(ctx->cond, ctx->mutex);
+    }
+    SDL_UnlockMutex(ctx->mutex);
+    for (int i = 0; i < ctx->path_cnt; i++)
+    {
+        folder_cnt += ctx->paths[i].folder_cnt;
+    }
 
-    static const char* months[] = {
-        "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
-    };
+    // This thread is the only writer. Store the results in the same order the folders were found.
+    int seq = 0;
+    while (seq < folder_cnt)
+    {
+        scan_slot_t *slot = &ctx->slots[seq % DASH_ARRAY_SIZE(ctx->slots)];
 
-    int monthNumber = 0;
-    for (int i = 0; i < 12; i++) {
-        if (strcmp(month, months[i]) == 0) {
-            monthNumber = i + 1;
+        SDL_LockMutex(ctx->mutex);
+        while (slot->state != SCAN_SLOT_READY || slot->seq != seq)
+        {
+            SDL_CondWait(ctx->cond, ctx->mutex);
+        }
+        ctx->abort = rebuild_abort;
+        SDL_CondBroadcast(ctx->cond);
+        SDL_UnlockMutex(ctx->mutex);
+        if (ctx->abort)
+        {
             break;
         }
-    }
-    lv_snprintf(output, 11, "%04d-%02d-%02d", year, monthNumber, day);
-}
 
-static bool parse_xml(const char *xml_path, char *title, char *title_id, char *developer,
-                      char *publisher, char *release_date, float *rating, char *overview)
-{
-    sxml_t parser;
-    sxmlerr_t err;
-    sxmltok_t tokens[128];
+        // Write every result that is ready in one transaction. It is never held open while waiting
+        // for the workers because other threads can't use the database until it is committed.
+        int batch_start = seq;
+        bool ready;
+        db_title_insert_begin();
+        do
+        {
+            scan_store_slot(slot);
+            seq++;
+            slot = &ctx->slots[seq % DASH_ARRAY_SIZE(ctx->slots)];
+            SDL_LockMutex(ctx->mutex);
+            ready = slot->state == SCAN_SLOT_READY && slot->seq == seq;
+            SDL_UnlockMutex(ctx->mutex);
+        } while (ready && seq < folder_cnt && seq - batch_start < SCAN_COMMIT_INTERVAL);
+        db_title_insert_end();
+
+        // Now the batch is committed the scroller can be told about it. Each slot is then released
+        // for the folder that is DASH_ARRAY_SIZE(ctx->slots) ahead
+        for (int i = batch_start; i < seq; i++)
+        {
+            slot = &ctx->slots[i % DASH_ARRAY_SIZE(ctx->slots)];
+            scan_notify_slot(slot);
+
+            SDL_LockMutex(ctx->mutex);
+            slot->seq += DASH_ARRAY_SIZE(ctx->slots);
+            slot->state = SCAN_SLOT_FREE;
+            SDL_CondBroadcast(ctx->cond);
+            SDL_UnlockMutex(ctx->mutex);
+        }
+        if (rebuild_callback)
+        {
+            rebuild_callback(DB_REBUILD_BATCH_DONE, NULL);
+        }
+    }
 
-    FILE *fp = fopen(xml_path, "rb");
-    if (fp == NULL)
+    for (int i = 0; i < DASH_SCAN_THREADS; i++)
     {
-        return false;
+        SDL_WaitThread(workers[i], NULL);
     }
+    SDL_DestroyCond(ctx->cond);
+    SDL_DestroyMutex(ctx->mutex);
 
-    fseek(fp, 0L, SEEK_END);
-    size_t sz = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    for (int i = 0; i < ctx->path_cnt; i++)
+    {
+        for (int j = 0; j < ctx->paths[i].folder_cnt; j++)
+        {
+            lv_mem_free(ctx->paths[i].folders[j].name);
+        }
+        lv_mem_free(ctx->paths[i].folders);
+        lv_mem_free((void *)ctx->paths[i].path);
+    }
+    for (int page = 0; page < num_pages; page++)
+    {
+        lv_mem_free(page_titles[page]);
+    }
+    bool aborted = ctx->abort;
+    lv_mem_free(ctx);
 
-    char *xml_buf = lv_mem_alloc(sz + 1);
-    if (fread(xml_buf, 1, sz, fp) != sz)
+    // Folders we never got to weren't seen, but they haven't been removed. Leave them for next time
+    if (aborted)
     {
-        lv_mem_free(xml_buf);
-        fclose(fp);
+        rebuild_callback = NULL;
+        dash_printf(LEVEL_TRACE, "Database rebuild stopped. %d titles parsed, %d unchanged\n",
+                    db_rebuild_scanned_items, db_rebuild_unchanged_items);
         return false;
     }
-    fclose(fp);
 
-    sxml_init(&parser);
-    err = sxml_parse(&parser, xml_buf, sz, tokens, 128);
-    if (err != SXML_SUCCESS)
+    // Any folder that was not seen during this scan has been removed. Remove its titles too. The pages are only told
+    // once the delete has committed. A page still adding titles from an earlier read skips them
+    removed_titles_t removed = {NULL, 0};
+    if (rebuild_callback)
     {
-        lv_mem_free(xml_buf);
-        return false;
+        stmt = db_query_begin(DB_QUERY_TITLE_GET_STALE);
+        db_bind_int(stmt, 1, rebuild_scan_id);
+        db_query_run(stmt, removed_titles_callback, &removed);
+    }
+    stmt = db_query_begin(DB_QUERY_TITLE_DELETE_STALE);
+    db_bind_int(stmt, 1, rebuild_scan_id);
+    db_query_run(stmt, NULL, NULL);
+    if (rebuild_callback)
+    {
+        rebuild_notify_removed(&removed);
+        rebuild_callback(DB_REBUILD_BATCH_DONE, NULL);
     }
-    char rating_str[12];
-    get_xml_str(xml_buf, tokens, parser.ntokens, "title", title, MAX_META_LEN);
-    get_xml_str(xml_buf, tokens, parser.ntokens, "developer", developer, MAX_META_LEN);
-    get_xml_str(xml_buf, tokens, parser.ntokens, "publisher", publisher, MAX_META_LEN);
-    get_xml_str(xml_buf, tokens, parser.ntokens, "release_date", release_date, MAX_META_LEN);
-    get_xml_str(xml_buf, tokens, parser.ntokens, "titleid", title_id, MAX_META_LEN);
-    get_xml_str(xml_buf, tokens, parser.ntokens, "overview", overview, MAX_OVERVIEW_LEN);
-    get_xml_str(xml_buf, tokens, parser.ntokens, "rating", rating_str, sizeof(rating_str));
-    *rating = atof(rating_str);
-    lv_mem_free(xml_buf);
-    char iso8601_date[11];
-    convert_xml_date_to_iso8601(release_date, iso8601_date);
-    strcpy(release_date, iso8601_date);
+    lv_snprintf(cmd, sizeof(cmd), SQL_FOLDER_DELETE_STALE, rebuild_scan_id);
+    db_command_with_callback(cmd, NULL, NULL);
+    db_command_with_callback(SQL_XBE_DELETE_STALE, NULL, NULL);
 
+    lv_snprintf(cmd, sizeof(cmd), SQL_STATE_SET, SQL_STATE_REBUILD_PENDING, 0);
+    db_command_with_callback(cmd, NULL, NULL);
+    rebuild_callback = NULL;
+
+    dash_printf(LEVEL_TRACE, "Database rebuild complete. %d titles parsed, %d unchanged\n",
+                db_rebuild_scanned_items, db_rebuild_unchanged_items);
     return true;
 }
 
+// Ask a running db_rebuild() to stop after the folder it is currently storing. Everything stored so far is
+// committed and the rest of the library is scanned by the next rebuild.
+void db_rebuild_abort(void)
+{
+    rebuild_abort = true;
+}
+
 static void clean_path(char *path)
 {
     char a = (DASH_PATH_SEPARATOR == '/') ? '\\' : '/';
@@ -397,17 +1050,16 @@ static void clean_path(char *path)
     }
 }
 
-static void parse_folder(const char *page_title, const char *folderPath, const char *filename_to_find)
+// Find all the folders in a search path. Called from the scan workers
+static void scan_enumerate_path(scan_path_t *scan_path)
 {
-    // static ok as non-reentrant - minimise stack usage
-    static char searchPath[DASH_MAX_PATH];
-    static char xmlPath[DASH_MAX_PATH];
-    static char filePath[DASH_MAX_PATH];
+    char searchPath[DASH_MAX_PATH];
     WIN32_FIND_DATA findData;
     HANDLE hFind;
+    int capacity = 0;
 
     // Create a search path
-    lv_snprintf(searchPath, sizeof(searchPath), "%s\\*", folderPath);
+    lv_snprintf(searchPath, sizeof(searchPath), "%s\\*", scan_path->path);
     clean_path(searchPath);
 
     // Find the first file/folder. Leave if folder is empty
@@ -417,16 +1069,6 @@ static void parse_folder(const char *page_title, const char *folderPath, const c
         return;
     }
 
-    lvgl_getlock();
-    char *title = lv_mem_alloc(MAX_META_LEN);
-    char *developer = lv_mem_alloc(MAX_META_LEN);
-    char *publisher = lv_mem_alloc(MAX_META_LEN);
-    char *release_date = lv_mem_alloc(MAX_META_LEN);
-    char *title_id = lv_mem_alloc(MAX_META_LEN);
-    char *overview = lv_mem_alloc(MAX_OVERVIEW_LEN);
-    float rating;
-    lvgl_removelock();
-
     do
     {
         // Skip "." and ".." directories
@@ -437,87 +1079,266 @@ static void parse_folder(const char *page_title, const char *folderPath, const c
         if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
             continue;
 
-        // Build the full path to the specific file we are looking for
-        lv_snprintf(filePath, sizeof(filePath), "%s\\%s\\%s", folderPath, findData.cFileName, filename_to_find);
-        clean_path(filePath);
+        if (scan_path->folder_cnt == capacity)
+        {
+            capacity = LV_MAX(capacity * 2, 32);
+            scan_path->folders = lv_mem_realloc(scan_path->folders, capacity * sizeof(scan_folder_t));
+            assert(scan_path->folders);
+        }
+        scan_folder_t *folder = &scan_path->folders[scan_path->folder_cnt++];
+        folder->name = lv_mem_alloc(strlen(findData.cFileName) + 1);
+        assert(folder->name);
+        strcpy(folder->name, findData.cFileName);
+        folder->mtime = filetime_to_int64(&findData.ftLastWriteTime);
+    } while (FindNextFile(hFind, &findData));
 
-        // Check if the file exists and its not a directory
-        DWORD fileAttributes = GetFileAttributes(filePath);
-        if (fileAttributes == INVALID_FILE_ATTRIBUTES || (fileAttributes & FILE_ATTRIBUTE_DIRECTORY))
-            continue;
+    FindClose(hFind);
+}
 
-        // Check if an xml meta-data file is present by first building the path to it then parsing it
-        lv_snprintf(xmlPath, sizeof(xmlPath), "%s\\%s\\_resources\\default.xml",
-                    folderPath, findData.cFileName);
-        clean_path(xmlPath);
+// Parse a single game folder into a result slot. Called from the scan workers. Workers only read the
+// database, through their own connection when there is one, anything to be stored is left in the slot.
+static void scan_parse_folder(db_reader_t *reader, const scan_path_t *scan_path, const scan_folder_t *folder,
+                              scan_slot_t *slot)
+{
+    char xmlPath[DASH_MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA fileData;
+
+    slot->page_title = scan_path->page_title;
+    slot->valid = false;
+    slot->unchanged = false;
+    slot->xbe_uncached = false;
+
+    // Build the full path to the specific file we are looking for
+    lv_snprintf(slot->launch_path, sizeof(slot->launch_path), "%s\\%s\\%s",
+                scan_path->path, folder->name, DASH_LAUNCH_EXE);
+    clean_path(slot->launch_path);
+
+    // Check if the file exists and its not a directory
+    if (GetFileAttributesEx(slot->launch_path, GetFileExInfoStandard, &fileData) == 0 ||
+        (fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return;
+
+    // Check if an xml meta-data file is present by first building the path to it then parsing it
+    lv_snprintf(xmlPath, sizeof(xmlPath), "%s\\%s\\_resources\\default.xml",
+                scan_path->path, folder->name);
+    clean_path(xmlPath);
+
+    // Fingerprint the folder so we can tell if it changed since the last scan
+    slot->fingerprint.dir_mtime = folder->mtime;
+    slot->fingerprint.xbe_size = ((int64_t)fileData.nFileSizeHigh << 32) | (int64_t)fileData.nFileSizeLow;
+    slot->fingerprint.xbe_mtime = filetime_to_int64(&fileData.ftLastWriteTime);
+    slot->fingerprint.xml_mtime = 0;
+    if (GetFileAttributesEx(xmlPath, GetFileExInfoStandard, &fileData))
+    {
+        slot->fingerprint.xml_mtime = filetime_to_int64(&fileData.ftLastWriteTime);
+    }
+    slot->valid = true;
+
+    if (folder_fingerprint_matches(reader, slot->launch_path, slot->page_title, &slot->fingerprint))
+    {
+        slot->unchanged = true;
+        return;
+    }
 
-        title[0] = '\0';
-        developer[0] = '\0';
-        publisher[0] = '\0';
-        release_date[0] = '\0';
-        title_id[0] = '\0';
-        overview[0] = '\0';
-        rating = 0.0f;
+    slot->title[0] = '\0';
+    slot->developer[0] = '\0';
+    slot->publisher[0] = '\0';
+    slot->release_date[0] = '\0';
+    slot->title_id[0] = '\0';
+    slot->overview[0] = '\0';
+    slot->rating = 0.0f;
 
-        lvgl_getlock();
-        if (parse_xml(xmlPath, title, title_id, developer, publisher, release_date, &rating, overview) == false)
+    if (dash_xml_parse(xmlPath, slot->title, slot->title_id, slot->developer, slot->publisher,
+                  slot->release_date, &slot->rating, slot->overview) == false)
+    {
+        // Check xbe is valid and extract title string
+        if (xbe_get_info(reader, slot->launch_path, slot->fingerprint.xbe_size, slot->fingerprint.xbe_mtime,
+                         &slot->xbe, &slot->xbe_uncached))
         {
-            // Check xbe is valid and extract title string
-            db_xbe_parse(filePath, findData.cFileName, title, title_id);
+            xbe_info_to_title(&slot->xbe, slot->launch_path, folder->name, slot->title, slot->title_id);
         }
-        lvgl_removelock();
+    }
 
-        if (title[0] == '\0')
-            continue;
-        if (developer[0] == '\0')
-            strcpy(developer, no_meta);
-        if (publisher[0] == '\0')
-            strcpy(publisher, no_meta);
-        if (release_date[0] == '\0')
-            strcpy(release_date, "2000-01-01");
-        if (title_id[0] == '\0')
-            strcpy(title_id, no_id);
-        if (overview[0] == '\0')
-            strcpy(overview, no_meta);
-
-        
-        // Insert it into the database
-        char item_index_str[8];
-        char rating_str[8];
-        lv_snprintf(item_index_str, sizeof(item_index_str), "%d", item_index++);
-        lv_snprintf(rating_str, sizeof(rating_str), "%1.1f", rating);
-
-        db_insert(SQL_TITLE_INSERT, SQL_TITLE_INSERT_CNT, SQL_TITLE_INSERT_FORMAT,
-            item_index_str,
-            title_id,
-            title,
-            filePath,
-            page_title,
-            developer,
-            publisher,
-            release_date,
-            overview,
-            "0", // Late played date - "0" = never launch
-            rating_str);
-
-        db_rebuild_scanned_items++;
-    } while (FindNextFile(hFind, &findData));
+    if (slot->developer[0] == '\0')
+        strcpy(slot->developer, no_meta);
+    if (slot->publisher[0] == '\0')
+        strcpy(slot->publisher, no_meta);
+    if (slot->release_date[0] == '\0')
+        strcpy(slot->release_date, "2000-01-01");
+    if (slot->title_id[0] == '\0')
+        strcpy(slot->title_id, no_id);
+    if (slot->overview[0] == '\0')
+        strcpy(slot->overview, no_meta);
+
+    // Store the thumbnail pre-scaled now so it never needs decompressing when shown. This is done here
+    // rather than by the writer so the jpeg decodes run on all the workers
+    slot->thumb_path[0] = '\0';
+    if (slot->title[0] == '\0')
+    {
+        return;
+    }
+    lv_snprintf(slot->thumb_path, sizeof(slot->thumb_path), "%s\\%s\\%s",
+                scan_path->path, folder->name, DASH_GAME_THUMBNAIL);
+    clean_path(slot->thumb_path);
+    DWORD thumb_attributes = GetFileAttributes(slot->thumb_path);
+    if (thumb_attributes == INVALID_FILE_ATTRIBUTES || (thumb_attributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        slot->thumb_path[0] = '\0';
+        return;
+    }
+    dash_thumbnail_generate(slot->thumb_path);
+}
 
-    lvgl_getlock();
-    lv_mem_free(title);
-    lv_mem_free(developer);
-    lv_mem_free(publisher);
-    lv_mem_free(release_date);
-    lv_mem_free(overview);
-    lv_mem_free(title_id);
-    lvgl_removelock();
-    FindClose(hFind);
+// Write a parsed result to the database. Only called from the rebuild thread, inside a transaction
+static void scan_store_slot(scan_slot_t *slot)
+{
+    slot->db_id = -1;
+    if (slot->valid == false)
+    {
+        return;
+    }
+
+    if (slot->unchanged)
+    {
+        folder_mark_seen(slot->launch_path, slot->page_title);
+        db_rebuild_unchanged_items++;
+        return;
+    }
+
+    // Folder is new or has changed. Remove the old entry if we had one, the new one keeps its id
+    int db_id = title_delete_by_path(slot->launch_path, slot->page_title, &slot->removed);
+
+    // Store the fingerprint even if the folder had nothing useful so we dont parse it again next time
+    folder_store(slot->launch_path, slot->page_title, &slot->fingerprint);
+    if (slot->xbe_uncached)
+    {
+        xbe_store_info(slot->launch_path, slot->fingerprint.xbe_size, slot->fingerprint.xbe_mtime, &slot->xbe);
+    }
+
+    if (slot->title[0] == '\0')
+    {
+        return;
+    }
+
+    // Insert it into the database
+    db_title_row_t row = {
+        .db_id = db_id,
+        .title_id = slot->title_id,
+        .title = slot->title,
+        .launch_path = slot->launch_path,
+        .page = slot->page_title,
+        .developer = slot->developer,
+        .publisher = slot->publisher,
+        .release_date = slot->release_date,
+        .overview = slot->overview,
+        .last_launch = "0", // Last played date - "0" = never launch
+        .rating = slot->rating,
+    };
+    slot->db_id = db_title_insert(&row);
+    db_rebuild_scanned_items++;
 }
 
-bool db_xbe_parse(const char *xbe_path, const char *xbe_folder, char *title, char *title_id)
+// Tell the rebuild callback what scan_store_slot() changed. Called once the changes are committed
+static void scan_notify_slot(scan_slot_t *slot)
+{
+    rebuild_notify_removed(&slot->removed);
+    if (slot->db_id < 0 || rebuild_callback == NULL)
+    {
+        return;
+    }
+
+    db_title_row_t row = {
+        .db_id = slot->db_id,
+        .title_id = slot->title_id,
+        .title = slot->title,
+        .launch_path = slot->launch_path,
+        .page = slot->page_title,
+        .developer = slot->developer,
+        .publisher = slot->publisher,
+        .release_date = slot->release_date,
+        .overview = slot->overview,
+        .last_launch = "0",
+        .rating = slot->rating,
+        .thumb_path = (slot->thumb_path[0]) ? slot->thumb_path : NULL,
+    };
+    rebuild_callback(DB_REBUILD_TITLE_ADDED, &row);
+}
+
+static int scan_worker_f(void *param)
+{
+    scan_ctx_t *ctx = param;
+    lx_mem_set_tag("rebuild");
+    db_reader_t *reader = db_reader_open();
+
+    // Enumerate the folders in every search path. Each worker takes the next available path
+    while (1)
+    {
+        SDL_LockMutex(ctx->mutex);
+        int path = ctx->next_path++;
+        SDL_UnlockMutex(ctx->mutex);
+        if (path >= ctx->path_cnt)
+        {
+            break;
+        }
+        scan_enumerate_path(&ctx->paths[path]);
+    }
+
+    // All paths must be enumerated before folders are claimed so the claim order is deterministic
+    SDL_LockMutex(ctx->mutex);
+    ctx->enumerated_workers++;
+    SDL_CondBroadcast(ctx->cond);
+    while (ctx->enumerated_workers < DASH_SCAN_THREADS)
+    {
+        SDL_CondWait(ctx->cond, ctx->mutex);
+    }
+    SDL_UnlockMutex(ctx->mutex);
+
+    // Parse the folders. Each worker claims the next folder and waits for its result slot to be free.
+    while (1)
+    {
+        SDL_LockMutex(ctx->mutex);
+        while (ctx->claim_path < ctx->path_cnt &&
+               ctx->claim_folder >= ctx->paths[ctx->claim_path].folder_cnt)
+        {
+            ctx->claim_path++;
+            ctx->claim_folder = 0;
+        }
+        if (ctx->claim_path >= ctx->path_cnt || ctx->abort)
+        {
+            SDL_UnlockMutex(ctx->mutex);
+            break;
+        }
+        scan_path_t *scan_path = &ctx->paths[ctx->claim_path];
+        scan_folder_t *folder = &scan_path->folders[ctx->claim_folder++];
+        int seq = ctx->next_seq++;
+        scan_slot_t *slot = &ctx->slots[seq % DASH_ARRAY_SIZE(ctx->slots)];
+        while ((slot->state != SCAN_SLOT_FREE || slot->seq != seq) && ctx->abort == false)
+        {
+            SDL_CondWait(ctx->cond, ctx->mutex);
+        }
+        if (ctx->abort)
+        {
+            SDL_UnlockMutex(ctx->mutex);
+            break;
+        }
+        slot->state = SCAN_SLOT_BUSY;
+        SDL_UnlockMutex(ctx->mutex);
+
+        scan_parse_folder(reader, scan_path, folder, slot);
+
+        SDL_LockMutex(ctx->mutex);
+        slot->state = SCAN_SLOT_READY;
+        SDL_CondBroadcast(ctx->cond);
+        SDL_UnlockMutex(ctx->mutex);
+    }
+    db_reader_close(reader);
+    return 0;
+}
+
+static bool xbe_read_info(const char *xbe_path, xbe_info_t *info)
 {
-    static xbe_header_t xbe_header;
-    static xbe_certificate_t xbe_cert;
+    xbe_header_t xbe_header;
+    xbe_certificate_t xbe_cert;
     FILE *fp = fopen(xbe_path, "rb");
 
     if (fp == NULL)
@@ -556,37 +1377,80 @@ bool db_xbe_parse(const char *xbe_path, const char *xbe_folder, char *title, cha
     fclose(fp);
 
     int max_len = sizeof(xbe_cert.wszTitleName) / sizeof(uint16_t);
-    for (int i = 0; i < max_len; i++)
+    int len;
+    for (len = 0; len < max_len && xbe_cert.wszTitleName[len] != 0x0000; len++)
     {
-        if (xbe_cert.wszTitleName[i] == 0x0000)
-        {
-            max_len = i;
-            if (max_len < 2)
-            {
-                max_len = strlen(xbe_folder);
-                break;
-            }
-        }
+        uint16_t unicode = xbe_cert.wszTitleName[len];
+        // Replace non ascii with ' '
+        info->title[len] = (unicode > 0x7E) ? ' ' : (unicode & 0x7F);
+    }
+    info->title[len] = '\0';
+
+    info->title_id = xbe_cert.dwTitleId;
+    info->region = xbe_cert.dwGameRegion;
+    info->media_flags = xbe_cert.dwAllowedMedia;
+    info->version = xbe_cert.dwVersion;
+    return true;
+}
+
+static int xbe_cache_callback(void *param, sqlite3_stmt *row)
+{
+    xbe_info_t *info = param;
+    const char *title = (const char *)sqlite3_column_text(row, 0);
+    strncpy(info->title, title ? title : "", sizeof(info->title) - 1);
+    info->title[sizeof(info->title) - 1] = '\0';
+    info->title_id = (uint32_t)sqlite3_column_int64(row, 1);
+    info->region = (uint32_t)sqlite3_column_int64(row, 2);
+    info->media_flags = (uint32_t)sqlite3_column_int64(row, 3);
+    info->version = (uint32_t)sqlite3_column_int64(row, 4);
+    return 1;
+}
+
+// Get the certificate info for an xbe. An xbe with the same size and modified time as last time
+// is served from the database without opening the file. If the file had to be read read_file is set
+// and the info can be cached with xbe_store_info()
+static bool xbe_get_info(db_reader_t *reader, const char *xbe_path, int64_t size, int64_t mtime,
+                         xbe_info_t *info, bool *read_file)
+{
+    *read_file = false;
+    sqlite3_stmt *stmt = db_reader_query_begin(reader, DB_QUERY_XBE_GET);
+    db_bind_text(stmt, 1, xbe_path);
+    db_bind_int64(stmt, 2, size);
+    db_bind_int64(stmt, 3, mtime);
+    if (db_query_run(stmt, xbe_cache_callback, info) > 0)
+    {
+        return true;
     }
 
+    *read_file = xbe_read_info(xbe_path, info);
+    return *read_file;
+}
+
+static void xbe_store_info(const char *xbe_path, int64_t size, int64_t mtime, const xbe_info_t *info)
+{
+    sqlite3_stmt *stmt = db_query_begin(DB_QUERY_XBE_INSERT);
+    db_bind_text(stmt, 1, xbe_path);
+    db_bind_int64(stmt, 2, size);
+    db_bind_int64(stmt, 3, mtime);
+    db_bind_text(stmt, 4, info->title);
+    db_bind_int64(stmt, 5, info->title_id);
+    db_bind_int64(stmt, 6, info->region);
+    db_bind_int64(stmt, 7, info->media_flags);
+    db_bind_int64(stmt, 8, info->version);
+    db_query_run(stmt, NULL, NULL);
+}
+
+static void xbe_info_to_title(const xbe_info_t *info, const char *xbe_path, const char *xbe_folder,
+                              char *title, char *title_id)
+{
     if (title)
     {
-        title[max_len] = '\0';
-        for (int i = 0; i < max_len; i++)
-        {
-            uint16_t unicode = xbe_cert.wszTitleName[i];
-            // Replace non ascii with ' '
-            title[i] = (unicode > 0x7E) ? ' ' : (unicode & 0x7F);
-            if (unicode == 0x000)
-            {
-                break;
-            }
-        }
+        strcpy(title, info->title);
 
         // If the xbe doesnt seem to have a title, fall back to the folder name
         if (strlen(title) < 2)
         {
-            strncpy(title, xbe_folder, max_len);
+            lv_snprintf(title, MAX_META_LEN, "%s", xbe_folder);
             dash_printf(LEVEL_TRACE, "Extracted title from XBE %s. Title \"%s\"\n", xbe_path, title);
         }
 
@@ -602,7 +1466,32 @@ bool db_xbe_parse(const char *xbe_path, const char *xbe_folder, char *title, cha
 
     if (title_id)
     {
-        lv_snprintf(title_id, MAX_META_LEN, "%08x", xbe_cert.dwTitleId);
+        lv_snprintf(title_id, MAX_META_LEN, "%08x", info->title_id);
+    }
+}
+
+bool db_xbe_parse(const char *xbe_path, const char *xbe_folder, char *title, char *title_id)
+{
+    WIN32_FILE_ATTRIBUTE_DATA fileData;
+    xbe_info_t info;
+    bool read_file;
+
+    if (GetFileAttributesEx(xbe_path, GetFileExInfoStandard, &fileData) == 0 ||
+        (fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        return false;
+    }
+
+    int64_t size = ((int64_t)fileData.nFileSizeHigh << 32) | (int64_t)fileData.nFileSizeLow;
+    int64_t mtime = filetime_to_int64(&fileData.ftLastWriteTime);
+    if (xbe_get_info(NULL, xbe_path, size, mtime, &info, &read_file) == false)
+    {
+        return false;
+    }
+    if (read_file)
+    {
+        xbe_store_info(xbe_path, size, mtime, &info);
     }
+    xbe_info_to_title(&info, xbe_path, xbe_folder, title, title_id);
     return true;
 }
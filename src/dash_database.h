@@ -11,6 +11,7 @@ extern "C"
 
 #include "lithiumx.h"
 #include "libs/toml/toml.h"
+#include "libs/sqlite3/sqlite3.h"
 
 typedef struct __attribute((packed))
 {
@@ -96,6 +97,10 @@ enum {
     };
 
 #define SQL_MAX_COMMAND_LEN 512
+
+#ifndef DASH_DB_BUSY_TIMEOUT
+#define DASH_DB_BUSY_TIMEOUT 5000 // ms to wait for a lock held by another connection
+#endif
 #define SQL_TITLE_DB_ID "id"
 #define SQL_TITLE_TITLE_ID "title_id"
 #define SQL_TITLE_NAME "title"
@@ -110,9 +115,32 @@ enum {
 
 #define SQL_SETTINGS_DATA "settings_data"
 
+#define SQL_FOLDER_LAUNCH_PATH "launch_path"
+#define SQL_FOLDER_PAGE "page"
+#define SQL_FOLDER_DIR_MTIME "dir_mtime"
+#define SQL_FOLDER_XBE_SIZE "xbe_size"
+#define SQL_FOLDER_XBE_MTIME "xbe_mtime"
+#define SQL_FOLDER_XML_MTIME "xml_mtime"
+#define SQL_FOLDER_SCAN_ID "scan_id"
+
+#define SQL_XBE_PATH "path"
+#define SQL_XBE_SIZE "size"
+#define SQL_XBE_MTIME "mtime"
+#define SQL_XBE_TITLE "title"
+#define SQL_XBE_TITLE_ID "title_id"
+#define SQL_XBE_REGION "region"
+#define SQL_XBE_MEDIA_FLAGS "media_flags"
+#define SQL_XBE_VERSION "version"
+
 #define SQL_TITLES_NAME "xbox_titles"
 #define SQL_SETTINGS_NAME "settings"
+#define SQL_FOLDERS_NAME "folder_fingerprints"
+#define SQL_SEARCH_NAME "title_search"
+#define SQL_XBE_CACHE_NAME "xbe_cache"
+#define SQL_STATE_NAME "dash_state"
 #define SQL_FLUSH "COMMIT"
+#define SQL_JOURNAL_MODE_WAL "PRAGMA journal_mode=WAL"
+#define SQL_BEGIN "BEGIN"
 
 #define SQL_TITLE_DELETE_TABLE \
     "DROP TABLE IF EXISTS " SQL_TITLES_NAME
@@ -130,20 +158,31 @@ enum {
     "SELECT COUNT(*) FROM " SQL_TITLES_NAME
 
 #define SQL_TITLE_GET_BY_ID \
-    "SELECT * FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_DB_ID " = %d"
+    "SELECT * FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_DB_ID " = ?"
 
 #define SQL_TITLE_SET_LAST_LAUNCH_DATETIME \
-    "UPDATE " SQL_TITLES_NAME " SET " SQL_TITLE_LAST_LAUNCH " = \"%s\" WHERE " SQL_TITLE_DB_ID " = %d"
+    "UPDATE " SQL_TITLES_NAME " SET " SQL_TITLE_LAST_LAUNCH " = ? WHERE " SQL_TITLE_DB_ID " = ?"
+
+#define SQL_TITLE_LIST_COLUMNS \
+    SQL_TITLE_DB_ID ", " SQL_TITLE_NAME ", " SQL_TITLE_LAUNCH_PATH
 
 #define SQL_TITLE_GET_RECENT \
-    "SELECT %s FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_LAST_LAUNCH " != \"0\"" \
-    " AND " SQL_TITLE_LAST_LAUNCH " > \"%s\" ORDER BY " SQL_TITLE_LAST_LAUNCH " DESC LIMIT %d"
+    "SELECT " SQL_TITLE_LIST_COLUMNS " FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_LAST_LAUNCH " != \"0\"" \
+    " AND " SQL_TITLE_LAST_LAUNCH " > ? ORDER BY " SQL_TITLE_LAST_LAUNCH " DESC LIMIT ?"
 
-#define SQL_TITLE_GET_SORTED_LIST \
-    "SELECT %s FROM "SQL_TITLES_NAME" WHERE "SQL_TITLE_PAGE" = \"%s\" ORDER BY %s COLLATE NOCASE %s"
+// The sort column should include its collation so the matching index below is used. See SQL_TITLE_CREATE_INDEXES
+#define SQL_TITLE_GET_SORTED_LIST(sort_by) \
+    "SELECT " SQL_TITLE_LIST_COLUMNS " FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_PAGE " = ? ORDER BY " sort_by
 
 #define SQL_TITLE_GET_LAUNCH_PATH \
-    "SELECT  "SQL_TITLE_LAUNCH_PATH " FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_DB_ID " = %d"
+    "SELECT " SQL_TITLE_LAUNCH_PATH " FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_DB_ID " = ?"
+
+#define SQL_TITLE_GET_ALL_LAUNCH_PATHS \
+    "SELECT DISTINCT " SQL_TITLE_LAUNCH_PATH " FROM " SQL_TITLES_NAME
+
+#define SQL_TITLE_GET_RECENT_BY_PATH \
+    "SELECT " SQL_TITLE_DB_ID " FROM " SQL_TITLES_NAME \
+    " WHERE " SQL_TITLE_LAUNCH_PATH " = ? AND " SQL_TITLE_PAGE " = \"__RECENT__\""
 
 #define SQL_TITLE_CREATE_TABLE                             \
     "CREATE TABLE IF NOT EXISTS " SQL_TITLES_NAME " ("     \
@@ -173,8 +212,75 @@ enum {
             SQL_TITLE_LAST_LAUNCH  ", " \
             SQL_TITLE_RATING       ") " \
             "VALUES(?,?,?,?,?,?,?,?,?,?,?)"
-#define SQL_TITLE_INSERT_FORMAT "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s"
-#define SQL_TITLE_INSERT_CNT 11
+
+// Bump this when the title table indexes, column types or search index change. db_init() migrates older databases
+#define SQL_SCHEMA_VERSION 2
+
+#define SQL_GET_SCHEMA_VERSION \
+    "PRAGMA user_version"
+
+#define SQL_SET_SCHEMA_VERSION \
+    "PRAGMA user_version = %d"
+
+// Each page is populated by walking one of these indexes instead of scanning and sorting the whole table
+#define SQL_TITLE_CREATE_INDEXES                                                                                      \
+    "CREATE INDEX IF NOT EXISTS idx_page_title ON " SQL_TITLES_NAME                                                    \
+        " (" SQL_TITLE_PAGE ", " SQL_TITLE_NAME " COLLATE NOCASE);"                                                    \
+    "CREATE INDEX IF NOT EXISTS idx_page_rating ON " SQL_TITLES_NAME " (" SQL_TITLE_PAGE ", " SQL_TITLE_RATING ");"   \
+    "CREATE INDEX IF NOT EXISTS idx_page_release_date ON " SQL_TITLES_NAME                                             \
+        " (" SQL_TITLE_PAGE ", " SQL_TITLE_RELEASE_DATE ");"                                                           \
+    "CREATE INDEX IF NOT EXISTS idx_page_last_launch ON " SQL_TITLES_NAME                                              \
+        " (" SQL_TITLE_PAGE ", " SQL_TITLE_LAST_LAUNCH ");"                                                            \
+    "CREATE INDEX IF NOT EXISTS idx_last_launch ON " SQL_TITLES_NAME " (" SQL_TITLE_LAST_LAUNCH ");"
+
+// Older versions stored the rating as text. Convert them so they sort numerically
+#define SQL_TITLE_CONVERT_TYPES \
+    "UPDATE " SQL_TITLES_NAME " SET " SQL_TITLE_RATING " = CAST(" SQL_TITLE_RATING " AS REAL)" \
+    " WHERE typeof(" SQL_TITLE_RATING ") != 'real'"
+
+// Full text index over the title table. It stores no copy of the text and is kept in sync by triggers, so
+// anything that inserts titles (rescans, recent items) is searchable straight away
+#define SQL_SEARCH_DELETE_TABLE \
+    "DROP TABLE IF EXISTS " SQL_SEARCH_NAME
+
+#define SQL_SEARCH_CREATE_TABLE                                                                                    \
+    "CREATE VIRTUAL TABLE IF NOT EXISTS " SQL_SEARCH_NAME " USING fts5("                                            \
+        SQL_TITLE_NAME ", " SQL_TITLE_DEVELOPER ", " SQL_TITLE_PUBLISHER ", " SQL_TITLE_OVERVIEW ", "               \
+        "content='" SQL_TITLES_NAME "', content_rowid='" SQL_TITLE_DB_ID "', prefix='2 3', "                       \
+        "tokenize='unicode61 remove_diacritics 2')"
+
+#define SQL_SEARCH_COLUMNS \
+    SQL_TITLE_NAME ", " SQL_TITLE_DEVELOPER ", " SQL_TITLE_PUBLISHER ", " SQL_TITLE_OVERVIEW
+
+#define SQL_SEARCH_OLD_VALUES \
+    "old." SQL_TITLE_NAME ", old." SQL_TITLE_DEVELOPER ", old." SQL_TITLE_PUBLISHER ", old." SQL_TITLE_OVERVIEW
+
+#define SQL_SEARCH_NEW_VALUES \
+    "new." SQL_TITLE_NAME ", new." SQL_TITLE_DEVELOPER ", new." SQL_TITLE_PUBLISHER ", new." SQL_TITLE_OVERVIEW
+
+#define SQL_SEARCH_CREATE_TRIGGERS                                                                                  \
+    "CREATE TRIGGER IF NOT EXISTS " SQL_SEARCH_NAME "_ai AFTER INSERT ON " SQL_TITLES_NAME " BEGIN "                \
+        "INSERT INTO " SQL_SEARCH_NAME "(rowid, " SQL_SEARCH_COLUMNS ") "                                           \
+        "VALUES (new." SQL_TITLE_DB_ID ", " SQL_SEARCH_NEW_VALUES "); END;"                                         \
+    "CREATE TRIGGER IF NOT EXISTS " SQL_SEARCH_NAME "_ad AFTER DELETE ON " SQL_TITLES_NAME " BEGIN "                \
+        "INSERT INTO " SQL_SEARCH_NAME "(" SQL_SEARCH_NAME ", rowid, " SQL_SEARCH_COLUMNS ") "                      \
+        "VALUES ('delete', old." SQL_TITLE_DB_ID ", " SQL_SEARCH_OLD_VALUES "); END;"                               \
+    "CREATE TRIGGER IF NOT EXISTS " SQL_SEARCH_NAME "_au AFTER UPDATE OF " SQL_SEARCH_COLUMNS                       \
+        " ON " SQL_TITLES_NAME " BEGIN "                                                                            \
+        "INSERT INTO " SQL_SEARCH_NAME "(" SQL_SEARCH_NAME ", rowid, " SQL_SEARCH_COLUMNS ") "                      \
+        "VALUES ('delete', old." SQL_TITLE_DB_ID ", " SQL_SEARCH_OLD_VALUES "); "                                   \
+        "INSERT INTO " SQL_SEARCH_NAME "(rowid, " SQL_SEARCH_COLUMNS ") "                                           \
+        "VALUES (new." SQL_TITLE_DB_ID ", " SQL_SEARCH_NEW_VALUES "); END;"
+
+#define SQL_SEARCH_REBUILD \
+    "INSERT INTO " SQL_SEARCH_NAME "(" SQL_SEARCH_NAME ") VALUES ('rebuild')"
+
+// Matches are ranked with the title weighted well above the other columns. Recent items are copies so are skipped
+#define SQL_SEARCH_TITLES                                                                                           \
+    "SELECT t." SQL_TITLE_DB_ID ", t." SQL_TITLE_NAME ", t." SQL_TITLE_PAGE                                        \
+    " FROM " SQL_SEARCH_NAME " s JOIN " SQL_TITLES_NAME " t ON t." SQL_TITLE_DB_ID " = s.rowid"                    \
+    " WHERE " SQL_SEARCH_NAME " MATCH ? AND t." SQL_TITLE_PAGE " != \"__RECENT__\""                                \
+    " ORDER BY bm25(" SQL_SEARCH_NAME ", 10.0, 2.0, 2.0, 1.0) LIMIT ?"
 
 #define SQL_SETTINGS_DELETE_TABLE \
     "DROP TABLE IF EXISTS "SQL_SETTINGS_NAME
@@ -198,15 +304,197 @@ enum {
 #define SQL_SETTINGS_READ                          \
     "SELECT " SQL_SETTINGS_DATA " FROM " SQL_SETTINGS_NAME " LIMIT 1;"
 
+// Each scanned game folder has a fingerprint stored so a rescan only needs to parse folders that changed
+#define SQL_FOLDER_CREATE_TABLE                                \
+    "CREATE TABLE IF NOT EXISTS " SQL_FOLDERS_NAME " ("        \
+            SQL_FOLDER_LAUNCH_PATH " TEXT,"                    \
+            SQL_FOLDER_PAGE        " TEXT,"                    \
+            SQL_FOLDER_DIR_MTIME   " INTEGER,"                 \
+            SQL_FOLDER_XBE_SIZE    " INTEGER,"                 \
+            SQL_FOLDER_XBE_MTIME   " INTEGER,"                 \
+            SQL_FOLDER_XML_MTIME   " INTEGER,"                 \
+            SQL_FOLDER_SCAN_ID     " INTEGER,"                 \
+            "PRIMARY KEY (" SQL_FOLDER_LAUNCH_PATH ", " SQL_FOLDER_PAGE "))"
+
+#define SQL_FOLDER_DELETE_ENTRIES \
+    "DELETE FROM " SQL_FOLDERS_NAME
+
+#define SQL_FOLDER_DELETE_TABLE \
+    "DROP TABLE IF EXISTS " SQL_FOLDERS_NAME
+
+#define SQL_FOLDER_GET \
+    "SELECT " SQL_FOLDER_DIR_MTIME ", " SQL_FOLDER_XBE_SIZE ", " SQL_FOLDER_XBE_MTIME ", " SQL_FOLDER_XML_MTIME \
+    " FROM " SQL_FOLDERS_NAME " WHERE " SQL_FOLDER_LAUNCH_PATH " = ? AND " SQL_FOLDER_PAGE " = ?"
+
+#define SQL_FOLDER_MARK_SEEN \
+    "UPDATE " SQL_FOLDERS_NAME " SET " SQL_FOLDER_SCAN_ID " = ? WHERE " \
+    SQL_FOLDER_LAUNCH_PATH " = ? AND " SQL_FOLDER_PAGE " = ?"
+
+#define SQL_FOLDER_INSERT                                      \
+    "INSERT OR REPLACE INTO " SQL_FOLDERS_NAME " ("            \
+            SQL_FOLDER_LAUNCH_PATH ", "                        \
+            SQL_FOLDER_PAGE        ", "                        \
+            SQL_FOLDER_DIR_MTIME   ", "                        \
+            SQL_FOLDER_XBE_SIZE    ", "                        \
+            SQL_FOLDER_XBE_MTIME   ", "                        \
+            SQL_FOLDER_XML_MTIME   ", "                        \
+            SQL_FOLDER_SCAN_ID     ") "                        \
+            "VALUES(?,?,?,?,?,?,?)"
+
+#define SQL_FOLDER_NEXT_SCAN_ID \
+    "SELECT IFNULL(MAX(" SQL_FOLDER_SCAN_ID "), 0) + 1 FROM " SQL_FOLDERS_NAME
+
+#define SQL_FOLDER_DELETE_STALE \
+    "DELETE FROM " SQL_FOLDERS_NAME " WHERE " SQL_FOLDER_SCAN_ID " != %d"
+
+// Any scanned title whose folder was not seen in the latest scan. Recent items are kept
+#define SQL_TITLE_GET_STALE \
+    "SELECT " SQL_TITLE_DB_ID ", " SQL_TITLE_PAGE " FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_STALE_WHERE
+
+#define SQL_TITLE_DELETE_STALE \
+    "DELETE FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_STALE_WHERE
+
+#define SQL_TITLE_STALE_WHERE \
+    SQL_TITLE_PAGE " != \"__RECENT__\" AND NOT EXISTS (" \
+    "SELECT 1 FROM " SQL_FOLDERS_NAME " f WHERE f." SQL_FOLDER_LAUNCH_PATH " = " SQL_TITLES_NAME "." SQL_TITLE_LAUNCH_PATH \
+    " AND f." SQL_FOLDER_PAGE " = " SQL_TITLES_NAME "." SQL_TITLE_PAGE " AND f." SQL_FOLDER_SCAN_ID " = ?)"
+
+#define SQL_TITLE_GET_BY_PATH \
+    "SELECT " SQL_TITLE_DB_ID ", " SQL_TITLE_PAGE " FROM " SQL_TITLES_NAME \
+    " WHERE " SQL_TITLE_LAUNCH_PATH " = ? AND " SQL_TITLE_PAGE " = ?"
+
+#define SQL_TITLE_DELETE_BY_PATH \
+    "DELETE FROM " SQL_TITLES_NAME " WHERE " SQL_TITLE_LAUNCH_PATH " = ? AND " SQL_TITLE_PAGE " = ?"
+
+// The certificate of each xbe we have read is cached so an unchanged xbe never needs to be opened again
+#define SQL_XBE_CREATE_TABLE                                   \
+    "CREATE TABLE IF NOT EXISTS " SQL_XBE_CACHE_NAME " ("      \
+            SQL_XBE_PATH           " TEXT PRIMARY KEY,"        \
+            SQL_XBE_SIZE           " INTEGER,"                 \
+            SQL_XBE_MTIME          " INTEGER,"                 \
+            SQL_XBE_TITLE          " TEXT,"                    \
+            SQL_XBE_TITLE_ID       " INTEGER,"                 \
+            SQL_XBE_REGION         " INTEGER,"                 \
+            SQL_XBE_MEDIA_FLAGS    " INTEGER,"                 \
+            SQL_XBE_VERSION        " INTEGER)"
+
+#define SQL_XBE_GET                                                                                 \
+    "SELECT " SQL_XBE_TITLE ", " SQL_XBE_TITLE_ID ", " SQL_XBE_REGION ", " SQL_XBE_MEDIA_FLAGS ", "  \
+    SQL_XBE_VERSION " FROM " SQL_XBE_CACHE_NAME " WHERE " SQL_XBE_PATH " = ? AND "                   \
+    SQL_XBE_SIZE " = ? AND " SQL_XBE_MTIME " = ?"
+
+#define SQL_XBE_INSERT                                         \
+    "INSERT OR REPLACE INTO " SQL_XBE_CACHE_NAME " ("          \
+            SQL_XBE_PATH           ", "                        \
+            SQL_XBE_SIZE           ", "                        \
+            SQL_XBE_MTIME          ", "                        \
+            SQL_XBE_TITLE          ", "                        \
+            SQL_XBE_TITLE_ID       ", "                        \
+            SQL_XBE_REGION         ", "                        \
+            SQL_XBE_MEDIA_FLAGS    ", "                        \
+            SQL_XBE_VERSION        ") "                        \
+            "VALUES(?,?,?,?,?,?,?,?)"
+
+// Forget any xbe that is no longer part of the library or recent items
+#define SQL_XBE_DELETE_STALE \
+    "DELETE FROM " SQL_XBE_CACHE_NAME " WHERE " SQL_XBE_PATH " NOT IN (" \
+    "SELECT " SQL_TITLE_LAUNCH_PATH " FROM " SQL_TITLES_NAME ")"
+
+// Small bits of state that need to survive a restart, such as an unfinished rebuild
+#define SQL_STATE_CREATE_TABLE \
+    "CREATE TABLE IF NOT EXISTS " SQL_STATE_NAME " (key TEXT PRIMARY KEY, value INTEGER)"
+
+#define SQL_STATE_GET \
+    "SELECT IFNULL((SELECT value FROM " SQL_STATE_NAME " WHERE key = '%s'), 0)"
+
+#define SQL_STATE_SET \
+    "INSERT OR REPLACE INTO " SQL_STATE_NAME " (key, value) VALUES ('%s', %d)"
+
+#define SQL_STATE_REBUILD_PENDING "rebuild_pending"
+
 typedef int (*sqlcmd_callback)(void*,int,char**, char**);
 
+// Queries that are run often are prepared once and cached. Use db_query_begin() to get the
+// statement, bind any parameters then db_query_run() to step through the result rows.
+typedef enum
+{
+    DB_QUERY_TITLE_GET_BY_ID,
+    DB_QUERY_TITLE_GET_LAUNCH_PATH,
+    DB_QUERY_TITLE_SET_LAST_LAUNCH,
+    DB_QUERY_TITLE_GET_RECENT,
+    DB_QUERY_TITLE_GET_RECENT_BY_PATH,
+    DB_QUERY_TITLE_LIST_BY_NAME,
+    DB_QUERY_TITLE_LIST_BY_RATING,
+    DB_QUERY_TITLE_LIST_BY_LAST_LAUNCH,
+    DB_QUERY_TITLE_LIST_BY_RELEASE_DATE,
+    DB_QUERY_TITLE_SEARCH,
+    DB_QUERY_XBE_GET,
+    DB_QUERY_XBE_INSERT,
+    DB_QUERY_TITLE_GET_BY_PATH,
+    DB_QUERY_TITLE_DELETE_BY_PATH,
+    DB_QUERY_FOLDER_GET,
+    DB_QUERY_FOLDER_MARK_SEEN,
+    DB_QUERY_FOLDER_INSERT,
+    DB_QUERY_TITLE_GET_STALE,
+    DB_QUERY_TITLE_DELETE_STALE,
+    DB_QUERY_MAX
+} db_query_t;
+
+// A read-only database connection for use by a single thread. See db_reader_open()
+typedef struct db_reader db_reader_t;
+
+// Called for each result row. Read the columns with sqlite3_column_*(). Return non-zero to stop early
+typedef int (*db_row_callback)(void *param, sqlite3_stmt *row);
+
+// A single row of the titles table, used with db_title_insert(). A negative db_id lets the database pick one
+typedef struct
+{
+    int db_id;
+    const char *title_id;
+    const char *title;
+    const char *launch_path;
+    const char *page;
+    const char *developer;
+    const char *publisher;
+    const char *release_date;
+    const char *overview;
+    const char *last_launch;
+    float rating;
+    const char *thumb_path; // Not stored. Set by the rebuild callback, NULL if the title has no thumbnail
+} db_title_row_t;
+
+typedef enum
+{
+    DB_REBUILD_TITLE_ADDED,
+    DB_REBUILD_TITLE_REMOVED,
+    DB_REBUILD_BATCH_DONE,
+} db_rebuild_event_t;
+
+// Called from the rebuild thread as titles are added or removed. For removals only db_id and page are set.
+// DB_REBUILD_BATCH_DONE follows each committed batch of changes with row set to NULL.
+// The database is not locked during the callback.
+typedef void (*db_rebuild_callback)(db_rebuild_event_t event, const db_title_row_t *row);
+
 bool db_open();
 bool db_close();
 bool db_init(char *err_msg, int err_msg_len);
-bool db_rebuild(toml_table_t *paths);
+bool db_rebuild(toml_table_t *paths, db_rebuild_callback callback);
+void db_rebuild_abort(void);
 void db_command_with_callback(const char *command, sqlcmd_callback callback, void *param);
+sqlite3_stmt *db_query_begin(db_query_t query);
+void db_bind_int(sqlite3_stmt *stmt, int index, int value);
+void db_bind_int64(sqlite3_stmt *stmt, int index, int64_t value);
+void db_bind_double(sqlite3_stmt *stmt, int index, double value);
+void db_bind_text(sqlite3_stmt *stmt, int index, const char *value);
+int db_query_run(sqlite3_stmt *stmt, db_row_callback callback, void *param);
+db_reader_t *db_reader_open(void);
+void db_reader_close(db_reader_t *reader);
+sqlite3_stmt *db_reader_query_begin(db_reader_t *reader, db_query_t query);
 void db_insert(const char *command, int argc, const char *format, ...);
 void db_insert_blob(const char *command, void *blob, int len);
+void db_title_insert_begin(void);
+int db_title_insert(const db_title_row_t *row);
+void db_title_insert_end(void);
 bool db_xbe_parse(const char *xbe_path, const char *xbe_folder, char *title, char *title_id);
 #ifdef __cplusplus
 }
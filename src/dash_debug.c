@@ -3,48 +3,206 @@
 static bool debug_info_visible = false;
 static SDL_Thread *debug_info_thread;
 
-#ifdef NXDK
-static void get_ram_usage(uint32_t *mem_size, uint32_t *mem_used)
+static lv_timer_t *debug_info_timer;
+static lv_obj_t *debug_info_label;
+static uint32_t frame_counter;
+
+// Timing of each main loop iteration split into phases. The last DASH_FRAME_HISTORY frames are kept
+typedef struct
+{
+    uint64_t start_us;
+    uint32_t total_us;
+    uint32_t phase_us[DASH_FRAME_PHASES];
+} frame_record_t;
+
+static const char *frame_phase_names[DASH_FRAME_PHASES] = {"lock wait", "timers", "layout", "draw", "flush"};
+static frame_record_t frame_history[DASH_FRAME_HISTORY];
+static uint32_t frame_history_cnt;
+static frame_record_t *frame_current;
+static uint64_t frame_mark_us;
+static uint32_t frame_nested_us; // Time already charged to a phase nested inside the one being marked
+static lv_disp_drv_t *frame_disp_drv;
+static void (*frame_flush_cb)(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p);
+
+static uint64_t frame_base_count;
+
+static uint64_t frame_now_us(void)
+{
+    // Split so the multiply can't overflow with high resolution counters
+    uint64_t count = SDL_GetPerformanceCounter() - frame_base_count;
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    return count / freq * 1000000 + count % freq * 1000000 / freq;
+}
+
+// Flushing happens inside the draw phase, so the display driver's flush is wrapped to time it separately
+static void frame_flush_wrapper(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
 {
-    MM_STATISTICS MemoryStatistics;
-    MemoryStatistics.Length = sizeof(MM_STATISTICS);
-    MmQueryStatistics(&MemoryStatistics);
-    *mem_size = (MemoryStatistics.TotalPhysicalPages * PAGE_SIZE) / 1024U / 1024U;
-    *mem_used = *mem_size - ((MemoryStatistics.AvailablePages * PAGE_SIZE) / 1024U / 1024U);
-    return;
+    uint64_t start = frame_now_us();
+    frame_flush_cb(disp_drv, area, color_p);
+    if (frame_current)
+    {
+        uint32_t elapsed = frame_now_us() - start;
+        frame_current->phase_us[DASH_FRAME_FLUSH] += elapsed;
+        frame_nested_us += elapsed;
+    }
 }
-#else
-static void get_ram_usage(uint32_t *mem_size, uint32_t *mem_used)
+
+void dash_debug_frame_init(void)
 {
-    *mem_size = 0;
-    *mem_used = 0;
+    frame_base_count = SDL_GetPerformanceCounter();
+    frame_disp_drv = lv_disp_get_default()->driver;
+    frame_flush_cb = frame_disp_drv->flush_cb;
+    frame_disp_drv->flush_cb = frame_flush_wrapper;
 }
-#endif
 
-static lv_timer_t *frame_counter_timer;
-static lv_timer_t *debug_info_timer;
-static lv_obj_t *debug_info_label;
-static uint32_t frame_counter;
+void dash_debug_frame_begin(void)
+{
+    frame_current = &frame_history[frame_history_cnt % DASH_FRAME_HISTORY];
+    lv_memset_00(frame_current, sizeof(frame_record_t));
+    frame_current->start_us = frame_now_us();
+    frame_mark_us = frame_current->start_us;
+    frame_nested_us = 0;
+}
 
-static void frame_count_incrememt(lv_timer_t *t)
+// Charge the time since the last mark to a phase
+void dash_debug_frame_mark(dash_frame_phase_t phase)
 {
+    uint64_t now = frame_now_us();
+    uint32_t elapsed = now - frame_mark_us;
+    frame_current->phase_us[phase] += (elapsed > frame_nested_us) ? elapsed - frame_nested_us : 0;
+    frame_mark_us = now;
+    frame_nested_us = 0;
+}
+
+void dash_debug_frame_end(void)
+{
+    frame_current->total_us = frame_now_us() - frame_current->start_us;
+    frame_current = NULL;
+    frame_history_cnt++;
     frame_counter++;
 }
 
+static int frame_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Frame time percentiles in microseconds over the recorded history
+static void frame_percentiles(uint32_t *p50, uint32_t *p95, uint32_t *p99)
+{
+    static uint32_t sorted[DASH_FRAME_HISTORY];
+    int cnt = LV_MIN(frame_history_cnt, DASH_FRAME_HISTORY);
+    if (cnt == 0)
+    {
+        *p50 = *p95 = *p99 = 0;
+        return;
+    }
+    for (int i = 0; i < cnt; i++)
+    {
+        sorted[i] = frame_history[i].total_us;
+    }
+    qsort(sorted, cnt, sizeof(uint32_t), frame_compare);
+    *p50 = sorted[cnt * 50 / 100];
+    *p95 = sorted[cnt * 95 / 100];
+    *p99 = sorted[cnt * 99 / 100];
+}
+
+// Write the recorded frames as a Chrome trace, which can be opened in chrome://tracing or Perfetto.
+// Each frame is an event with its phases as events nested inside it
+bool dash_debug_frame_export(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    int cnt = LV_MIN(frame_history_cnt, DASH_FRAME_HISTORY);
+    uint32_t first = frame_history_cnt - cnt;
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (int i = 0; i < cnt; i++)
+    {
+        frame_record_t *frame = &frame_history[(first + i) % DASH_FRAME_HISTORY];
+        fprintf(fp, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"dur\":%u}",
+                (i) ? ",\n" : "", (unsigned long long)frame->start_us, (unsigned int)frame->total_us);
+
+        // Phases ran in order, apart from flush which is part of draw
+        uint64_t ts = frame->start_us;
+        for (int phase = 0; phase < DASH_FRAME_PHASES; phase++)
+        {
+            uint32_t dur = frame->phase_us[phase];
+            if (phase == DASH_FRAME_DRAW)
+            {
+                dur += frame->phase_us[DASH_FRAME_FLUSH];
+            }
+            if (phase == DASH_FRAME_FLUSH)
+            {
+                ts -= dur;
+            }
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"dur\":%u}",
+                    frame_phase_names[phase], (unsigned long long)ts, (unsigned int)dur);
+            ts += dur;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return true;
+}
+
 static void debug_info_callback(lv_timer_t *timer)
 {
-    uint32_t used, capacity, ram_used, ram_total;
+    uint32_t used, capacity;
+    size_t ram_total, ram_available;
+    dash_scroller_cache_stats_t cache;
+    lx_mem_profile_t mem;
 
     uint32_t fps = frame_counter * 1000 / timer->period;
+    uint32_t p50, p95, p99;
     frame_counter = 0;
+    frame_percentiles(&p50, &p95, &p99);
 
     lx_mem_usage(&used, &capacity);
-    get_ram_usage(&ram_total, &ram_used);
+    lx_mem_get_profile(&mem);
+    platform_get_ram_usage(&ram_total, &ram_available);
+    dash_scroller_get_cache_stats(&cache);
+    uint32_t lookups = cache.hits + cache.misses;
     lv_label_set_text_fmt(debug_info_label, "GUI:%d/%dkB\n"
+                                           "PEAK:%dkB FRAG:%d%%\n"
                                            "CPU: %d%%\n"
                                            "RAM:%d/%d MB\n"
-                                           "FPS: %d",
-                          used / 1024, capacity / 1024, 100 - lv_timer_get_idle(), ram_used, ram_total, fps);
+                                           "THUMB:%d/%dkB\n"
+                                           "HIT: %d%% (%d/%d)\n"
+                                           "EVICT: %d\n"
+                                           "FPS: %d\n"
+                                           "FRAME ms p50:%d.%d p95:%d.%d p99:%d.%d",
+                          used / 1024, capacity / 1024, (int)(mem.peak_bytes / 1024), mem.fragmentation,
+                          100 - lv_timer_get_idle(),
+                          (int)((ram_total - ram_available) / 1024 / 1024), (int)(ram_total / 1024 / 1024),
+                          (int)(cache.resident_bytes / 1024), (int)(cache.capacity_bytes / 1024),
+                          (lookups) ? (int)(cache.hits * 100 / lookups) : 0, cache.hits, lookups,
+                          cache.evictions, fps, p50 / 1000, p50 / 100 % 10, p95 / 1000, p95 / 100 % 10,
+                          p99 / 1000, p99 / 100 % 10);
+
+    // Live memory by tag with DASH_MEM_PROFILE
+    for (int i = 0; i < mem.tag_cnt; i++)
+    {
+        char line[48];
+        lv_snprintf(line, sizeof(line), "\n%s:%dkB", mem.tags[i].name, (int)(mem.tags[i].live_bytes / 1024));
+        lv_label_ins_text(debug_info_label, LV_LABEL_POS_LAST, line);
+    }
+
+    // The places that held the lvgl lock while other threads waited the longest
+    lvgl_lock_stats_t locks[3];
+    int lock_cnt = lvgl_lock_get_stats(locks, 3);
+    for (int i = 0; i < lock_cnt; i++)
+    {
+        char line[96];
+        lv_snprintf(line, sizeof(line), "\nLOCK %s:%d blk:%dms max:%d.%dms", locks[i].func, locks[i].line,
+                    (int)(locks[i].blocking_us / 1000), (int)(locks[i].max_hold_us / 1000),
+                    (int)(locks[i].max_hold_us / 100 % 10));
+        lv_label_ins_text(debug_info_label, LV_LABEL_POS_LAST, line);
+    }
 
     lv_obj_update_layout(debug_info_label);
     lv_obj_set_size(debug_info_label, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
@@ -53,7 +211,6 @@ static void debug_info_callback(lv_timer_t *timer)
 void dash_debug_open()
 {
     frame_counter = 0;
-    frame_counter_timer = lv_timer_create(frame_count_incrememt, 0, NULL);
     debug_info_label = lv_label_create(lv_layer_sys());
 
     lv_obj_set_style_bg_opa(debug_info_label, LV_OPA_50, 0);
@@ -66,9 +223,14 @@ void dash_debug_open()
 
 void dash_debug_close()
 {
-    lv_timer_del(frame_counter_timer);
+#if DASH_MEM_PROFILE
+    lx_mem_dump_profile(DASH_MEM_PROFILE_PATH);
+#endif
+#ifndef NXDK
+    dash_debug_frame_export(DASH_FRAME_TRACE_PATH);
+    lvgl_lock_dump(DASH_LOCK_TRACE_PATH);
+#endif
     lv_timer_del(debug_info_timer);
     lv_obj_del(debug_info_label);
     debug_info_label = NULL;
-    frame_counter_timer = NULL;
 }
@@ -10,8 +10,24 @@ extern "C" {
 
 #include "lithiumx.h"
 
+// Parts of a main loop iteration that are timed separately
+typedef enum
+{
+    DASH_FRAME_LOCK_WAIT,
+    DASH_FRAME_TIMERS,
+    DASH_FRAME_LAYOUT,
+    DASH_FRAME_DRAW,
+    DASH_FRAME_FLUSH,
+    DASH_FRAME_PHASES
+} dash_frame_phase_t;
+
 void dash_debug_open();
 void dash_debug_close();
+void dash_debug_frame_init(void);
+void dash_debug_frame_begin(void);
+void dash_debug_frame_mark(dash_frame_phase_t phase);
+void dash_debug_frame_end(void);
+bool dash_debug_frame_export(const char *path);
 
 #ifdef __cplusplus
 }
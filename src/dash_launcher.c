@@ -4,21 +4,11 @@
 #include "lithiumx.h"
 
 
-static int recent_title_exists_cb(void *param, int argc, char **argv, char **azColName)
+static int recent_title_exists_cb(void *param, sqlite3_stmt *row)
 {
-    (void)argc; (void)argv; (void)azColName;
     int *db_id = param;
-    *db_id = atoi(argv[0]);
-    return 0;
-}
-
-static int recent_title_get_last_id_cb(void *param, int argc, char **argv, char **azColName)
-{
-    (void)argc; (void)argv; (void)azColName;
-    int *db_id_max = param;
-    if (argv[0] != NULL)
-        *db_id_max = atoi(argv[0]);
-    return 0;
+    *db_id = sqlite3_column_int(row, 0);
+    return 1;
 }
 
 
@@ -130,7 +120,7 @@ bool dash_launcher_is_launchable(const char *file_path)
 void dash_launcher_go(const char *selected_path)
 {
     static const char *no_meta = "No Meta-Data";
-    char cmd[SQL_MAX_COMMAND_LEN];
+    sqlite3_stmt *stmt;
     char time_str[20];
     launch_param_t *launch_params = lv_mem_alloc(sizeof(launch_param_t));
 
@@ -148,41 +138,38 @@ void dash_launcher_go(const char *selected_path)
     }
 
     // See if the launch paths exists in page "Recent"
-    const char *query = "SELECT " SQL_TITLE_DB_ID " FROM " SQL_TITLES_NAME
-                        " WHERE " SQL_TITLE_LAUNCH_PATH "= \"%s\" AND " SQL_TITLE_PAGE " = \"__RECENT__\"";
-    lv_snprintf(cmd, sizeof(cmd), query, launch_params->selected_path);
     int db_id = -1;
-    db_command_with_callback(cmd, recent_title_exists_cb, &db_id);
+    stmt = db_query_begin(DB_QUERY_TITLE_GET_RECENT_BY_PATH);
+    db_bind_text(stmt, 1, launch_params->selected_path);
+    db_query_run(stmt, recent_title_exists_cb, &db_id);
     if (db_id >= 0)
     {
         // If it does, update the LAUNCH_DATETIME to now
-        lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_SET_LAST_LAUNCH_DATETIME, time_str, db_id);
-        db_command_with_callback(cmd, NULL, NULL);
+        stmt = db_query_begin(DB_QUERY_TITLE_SET_LAST_LAUNCH);
+        db_bind_text(stmt, 1, time_str);
+        db_bind_int(stmt, 2, db_id);
+        db_query_run(stmt, NULL, NULL);
     }
     else
     {
-        // Otherwise add it to a page called "Recent" with current LAUNCH_DATETIME
-        const char *query = "SELECT MAX(" SQL_TITLE_DB_ID ") FROM " SQL_TITLES_NAME
-                            " WHERE " SQL_TITLE_PAGE " = \"__RECENT__\"";
-        int db_id_max = 10000;
-        db_command_with_callback(query, recent_title_get_last_id_cb, &db_id_max);
-        db_id_max++;
-        db_id_max = LV_MAX(10000, db_id_max);
-
-        char item_index_str[8];
-        lv_snprintf(item_index_str, sizeof(item_index_str), "%d", db_id_max);
-        db_insert(SQL_TITLE_INSERT, SQL_TITLE_INSERT_CNT, SQL_TITLE_INSERT_FORMAT,
-            item_index_str,
-            launch_params->title_id,
-            launch_params->title,
-            launch_params->selected_path,
-            "__RECENT__",
-            no_meta,
-            no_meta,
-            no_meta,
-            no_meta,
-            time_str,
-            "0.0");
+        // Otherwise add it to a page called "Recent" with current LAUNCH_DATETIME. The database picks the id
+        // so it can't clash with titles a background rescan is adding
+        db_title_row_t row = {
+            .db_id = -1,
+            .title_id = launch_params->title_id,
+            .title = launch_params->title,
+            .launch_path = launch_params->selected_path,
+            .page = "__RECENT__",
+            .developer = no_meta,
+            .publisher = no_meta,
+            .release_date = no_meta,
+            .overview = no_meta,
+            .last_launch = time_str,
+            .rating = 0.0f,
+        };
+        db_title_insert_begin();
+        db_title_insert(&row);
+        db_title_insert_end();
     }
 
     // Setup launch path then quit
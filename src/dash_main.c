@@ -133,36 +133,72 @@ static void create_warning_box(const char *str)
     lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
 }
 
-static int db_rebuild_thread_f(void *param)
+static SDL_Thread *rescan_thread;
+static volatile int rescan_complete;
+static lv_obj_t *rescan_label;
+
+static int dash_rescan_thread_f(void *param)
 {
-    int *complete = param;
-    db_rebuild(dash_search_paths);
-    *complete = 1;
-    lvgl_getlock();
-    lv_obj_clean(lv_scr_act());
-    dash_create();
-    lvgl_removelock();
+    (void)param;
+    lx_mem_set_tag("rebuild");
+    // Titles are streamed into the scrollers as they are found. Only folders that have
+    // changed since the last scan are parsed again.
+    if (db_rebuild(dash_search_paths, dash_scroller_title_changed))
+    {
+        dash_thumbnail_prune();
+    }
+    rescan_complete = 1;
     return 0;
 }
 
-static int db_rebuild_progress_thread_f(void *param)
+static void dash_rescan_progress(lv_timer_t *timer)
 {
-    lv_obj_t *label = param;
-    int *complete = label->user_data;
-    while (1)
+    extern int db_rebuild_scanned_items;
+    extern int db_rebuild_unchanged_items;
+
+    if (rescan_complete == 0)
     {
-        if (*complete)
-        {
-            lv_mem_free(complete);
-            break;
-        }
-        extern int db_rebuild_scanned_items;
-        lvgl_getlock();
-        lv_label_set_text_fmt(label, "Rebuilding Database, please wait... %d", db_rebuild_scanned_items);
-        lvgl_removelock();
-        SDL_Delay(100);
+        lv_label_set_text_fmt(rescan_label, "Scanning library... %d",
+                              db_rebuild_scanned_items + db_rebuild_unchanged_items);
+        return;
     }
-    return 0;
+
+    SDL_WaitThread(rescan_thread, NULL);
+    rescan_thread = NULL;
+    lv_timer_del(timer);
+    lv_obj_del(rescan_label);
+    rescan_label = NULL;
+
+    // New titles were added to the end of each page, put them back in order
+    for (int i = 0; i < dash_scroller_get_page_count(); i++)
+    {
+        dash_scroller_resort_page(dash_scroller_get_title(i));
+    }
+}
+
+// Rescan the library in the background. The dash stays usable while it runs. Must be called
+// from the lvgl thread.
+bool dash_rescan_start(void)
+{
+    if (rescan_thread)
+    {
+        return false;
+    }
+
+    rescan_label = lv_label_create(lv_layer_top());
+    lv_obj_add_style(rescan_label, &menu_table_cell_style, LV_PART_MAIN);
+    lv_obj_align(rescan_label, LV_ALIGN_BOTTOM_RIGHT, -DASH_XMARGIN, -DASH_YMARGIN);
+    lv_label_set_text_static(rescan_label, "Scanning library...");
+
+    rescan_complete = 0;
+    rescan_thread = SDL_CreateThread(dash_rescan_thread_f, "dash_rescan_thread_f", NULL);
+    lv_timer_create(dash_rescan_progress, 100, NULL);
+    return true;
+}
+
+bool dash_rescan_running(void)
+{
+    return rescan_thread != NULL;
 }
 
 static char err_msg_toml[256], err_msg_db[256];
@@ -183,7 +219,9 @@ void dash_init(void)
     dash_settings.items_per_row = (lv_obj_get_width(lv_scr_act()) == 640) ? 4 : 6;
 
     // Read in the toml file that has all the search paths
+    const char *tag = lx_mem_set_tag("toml");
     check_path_toml(err_msg_toml, sizeof(err_msg_toml));
+    lx_mem_set_tag(tag);
 
     // Setup input devices and a default input group
     input_group = lv_group_create();
@@ -205,26 +243,28 @@ void dash_init(void)
     in_memory_warning = !db_open();
 
     // Check that the database is valid (Correct tables, and columns). Otherwise begin a database rebuild
-    if (db_init(err_msg_db, sizeof(err_msg_db)) == true)
+    // The dash is shown straight away, titles fill in as the rebuild finds them
+    bool need_rebuild = (db_init(err_msg_db, sizeof(err_msg_db)) == false);
+    dash_create();
+    if (need_rebuild)
     {
-        dash_create();
+        lvgl_getlock();
+        dash_rescan_start();
+        lvgl_removelock();
     }
-    else
+    return;
+}
+
+void dash_deinit(void)
+{
+    // Stop any background rebuild. What it has found so far is kept and it will continue
+    // on the next boot.
+    if (rescan_thread)
     {
-        lv_obj_t *window = lv_obj_create(lv_scr_act());
-        lv_obj_set_size(window, lv_obj_get_width(lv_scr_act()), lv_obj_get_height(lv_scr_act()));
-        lv_obj_set_style_bg_color(window, lv_color_make(0,0,0), LV_PART_MAIN);
-        lv_obj_t *label = lv_label_create(window);
-        lv_obj_center(label);
-        lv_label_set_text_static(label, "Rebuilding Database, please wait...");
-        lv_obj_set_style_text_color(label, lv_color_white(), LV_PART_MAIN);
-        int *complete = lv_mem_alloc(sizeof (int));
-        *complete = 0;
-        label->user_data = complete;
-        SDL_CreateThread(db_rebuild_progress_thread_f, "db_rebuild_progress_thread_f", label);
-        SDL_CreateThread(db_rebuild_thread_f, "db_rebuild_thread_f", complete);
+        db_rebuild_abort();
+        SDL_WaitThread(rescan_thread, NULL);
+        rescan_thread = NULL;
     }
-    return;
 }
 
 
@@ -94,6 +94,55 @@ static void dash_rebuild_database(void *param)
     db_command_with_callback(SQL_TITLE_DELETE_ENTRIES, NULL, NULL);
 }
 
+static lv_timer_t *dash_rescan_timer;
+
+static void dash_rescan_progress(lv_timer_t *timer)
+{
+    extern int db_rebuild_scanned_items;
+    extern int db_rebuild_unchanged_items;
+    lv_obj_t *label = timer->user_data;
+
+    // The window may have been closed while still scanning
+    bool label_valid = lv_obj_is_valid(label);
+    if (dash_rescan_running() == false)
+    {
+        if (label_valid)
+        {
+            lv_label_set_text_fmt(label, "Library rescan complete. %d updated, %d unchanged",
+                                  db_rebuild_scanned_items, db_rebuild_unchanged_items);
+        }
+        lv_timer_del(timer);
+        dash_rescan_timer = NULL;
+    }
+    else if (label_valid)
+    {
+        lv_label_set_text_fmt(label, "Rescanning library, please wait... %d",
+                              db_rebuild_scanned_items + db_rebuild_unchanged_items);
+    }
+}
+
+static void dash_rescan_database(void *param)
+{
+    (void)param;
+    lv_obj_t *window = container_open();
+    lv_obj_t *label = lv_label_create(window);
+    lv_obj_set_size(label, lv_obj_get_width(window), LV_SIZE_CONTENT);
+    lv_obj_set_style_text_align(label, LV_TEXT_ALIGN_CENTER, LV_PART_MAIN);
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+    lv_label_set_text(label, "Rescanning library, please wait...");
+
+    // Already rescanning, just show the progress
+    if (dash_rescan_timer)
+    {
+        dash_rescan_timer->user_data = label;
+        return;
+    }
+
+    // The startup rebuild may already be running, in which case we just follow it
+    dash_rescan_start();
+    dash_rescan_timer = lv_timer_create(dash_rescan_progress, 100, label);
+}
+
 static void dash_clear_recent(void *param)
 {
     (void)param;
@@ -155,6 +204,7 @@ static void dash_utilities(void *param)
             {"EEPROM Config", dash_open_eeprom_config, NULL, NULL},
             {"Clear Recent Titles", dash_clear_recent, NULL, "Accept \"Clear Recent Titles\""},
             {"Flush Cache Partitions", dash_flush_cache, NULL, "Accept \"Flush Cache Partitions\""},
+            {"Rescan Library for Changes", dash_rescan_database, NULL, NULL},
             {"Mark Database Reset at Reboot", dash_rebuild_database, NULL, "Accept \"Database Reset\""},
         };
     menu_open_static(items, DASH_ARRAY_SIZE(items));
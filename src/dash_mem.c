@@ -0,0 +1,538 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+// The gui heap. lvgl, toml and the dash all allocate from it through lx_mem_*().
+
+#include "lithiumx.h"
+
+static CRITICAL_SECTION tlsf_crit_sec;
+static tlsf_t mem_pool;
+static uint8_t mem_pool_data[3U * 1024U * 1024U]; // The first pool. More are added from the system heap as needed
+static size_t mem_pool_capacity;
+typedef struct mem_pool_chunk
+{
+    struct mem_pool_chunk *next;
+    pool_t pool;
+} mem_pool_chunk_t;
+static mem_pool_chunk_t *mem_pool_chunks; // Pools added after the first, the pool memory follows each header
+static size_t mem_pool_budget;
+static lx_mem_low_cb_t mem_low_cbs[4];
+static bool mem_low_signalled;
+
+// Small blocks are kept in per thread free lists, one per 16 byte size class, so most small allocations from lvgl,
+// toml and the worker threads never take the pool lock. Cached blocks are normal tlsf blocks that are still counted
+// as used. A thread hands half of a list back to the pool when it fills and every DASH_MEM_CACHE_FLUSH_OPS allocations,
+// and all of them when the thread exits.
+#define MEM_CACHE_CLASS_SIZE 16
+#define MEM_CACHE_CLASSES (DASH_MEM_CACHE_MAX_SIZE / MEM_CACHE_CLASS_SIZE)
+#define MEM_CACHE_POOL MEM_CACHE_CLASSES // The block goes straight back to the pool when freed
+
+// Every block starts with the size class it belongs to. tlsf keeps flags that neighbouring frees change in the same
+// word as the block size, so the size can't be read without the pool lock. The header is the size of tlsf's
+// alignment so the memory after it stays aligned.
+typedef struct
+{
+    size_t cls;
+} mem_block_header_t;
+
+typedef struct
+{
+    void *head[MEM_CACHE_CLASSES]; // Free blocks are linked through their first word
+    uint16_t count[MEM_CACHE_CLASSES];
+    uint32_t ops;
+    uint8_t tag; // Index into mem_profile_tags for this thread's allocations
+} mem_cache_t;
+
+static SDL_TLSID mem_cache_tls;
+size_t tlsf_usage = 0;
+static size_t tlsf_peak = 0;
+
+// Add another pool to the heap that can hold at least size bytes. Must be called with tlsf_crit_sec held
+static bool pool_grow(size_t size)
+{
+    // Leave room for tlsf rounding the request up to its next size list
+    size_t grow = size + size / 8 + tlsf_pool_overhead() + tlsf_alloc_overhead();
+    grow = LV_MAX(grow, DASH_MEM_POOL_GROW_SIZE);
+    if (mem_pool_capacity + grow > mem_pool_budget)
+    {
+        return false;
+    }
+    mem_pool_chunk_t *chunk = malloc(sizeof(mem_pool_chunk_t) + grow);
+    if (chunk == NULL)
+    {
+        return false;
+    }
+    chunk->pool = tlsf_add_pool(mem_pool, chunk + 1, grow);
+    if (chunk->pool == NULL)
+    {
+        free(chunk);
+        return false;
+    }
+    chunk->next = mem_pool_chunks;
+    mem_pool_chunks = chunk;
+    mem_pool_capacity += grow;
+    dash_printf(LEVEL_TRACE, "GUI heap grown to %u kB\n", (unsigned int)(mem_pool_capacity / 1024));
+    return true;
+}
+
+// Returns true once each time usage rises past the low memory watermark. Must be called with tlsf_crit_sec held
+static bool pool_check_low(void)
+{
+    bool low = tlsf_usage >= mem_pool_budget / 100 * DASH_MEM_LOW_WATERMARK;
+    if (low == mem_low_signalled)
+    {
+        return false;
+    }
+    mem_low_signalled = low;
+    return low;
+}
+
+// Ask everything that holds memory it can rebuild to give some back. Called without tlsf_crit_sec held
+static void pool_notify_low(void)
+{
+    for (int i = 0; i < (int)(sizeof(mem_low_cbs) / sizeof(mem_low_cbs[0])) && mem_low_cbs[i]; i++)
+    {
+        mem_low_cbs[i]();
+    }
+}
+
+static void *pool_alloc(size_t size)
+{
+    EnterCriticalSection(&tlsf_crit_sec);
+    void *ptr = tlsf_malloc(mem_pool, size);
+    if (ptr == NULL && pool_grow(size))
+    {
+        ptr = tlsf_malloc(mem_pool, size);
+    }
+    tlsf_usage += tlsf_block_size(ptr);
+    tlsf_peak = LV_MAX(tlsf_peak, tlsf_usage);
+    bool low = pool_check_low() || ptr == NULL;
+    LeaveCriticalSection(&tlsf_crit_sec);
+    if (low)
+    {
+        pool_notify_low();
+    }
+    return ptr;
+}
+
+static void pool_free(void *data)
+{
+    EnterCriticalSection(&tlsf_crit_sec);
+    tlsf_usage -= tlsf_block_size(data);
+    tlsf_free(mem_pool, data);
+    pool_check_low();
+    LeaveCriticalSection(&tlsf_crit_sec);
+}
+
+// Return all but keep blocks from a size class to the pool under one lock
+static void mem_cache_trim(mem_cache_t *cache, int cls, int keep)
+{
+    if (cache->count[cls] <= keep)
+    {
+        return;
+    }
+    EnterCriticalSection(&tlsf_crit_sec);
+    while (cache->count[cls] > keep)
+    {
+        void *block = cache->head[cls];
+        cache->head[cls] = *(void **)block;
+        cache->count[cls]--;
+        tlsf_usage -= tlsf_block_size(block);
+        tlsf_free(mem_pool, block);
+    }
+    pool_check_low();
+    LeaveCriticalSection(&tlsf_crit_sec);
+}
+
+static void mem_cache_destroy(void *data)
+{
+    mem_cache_t *cache = data;
+    for (int i = 0; i < MEM_CACHE_CLASSES; i++)
+    {
+        mem_cache_trim(cache, i, 0);
+    }
+    pool_free(cache);
+}
+
+static mem_cache_t *mem_cache_get(void)
+{
+    mem_cache_t *cache = SDL_TLSGet(mem_cache_tls);
+    if (cache == NULL)
+    {
+        cache = pool_alloc(sizeof(mem_cache_t));
+        if (cache == NULL)
+        {
+            return NULL;
+        }
+        memset(cache, 0, sizeof(mem_cache_t));
+        if (SDL_TLSSet(mem_cache_tls, cache, mem_cache_destroy) != 0)
+        {
+            pool_free(cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+// Replace lvgls internal allocator with basically the same thing
+// but wrapped in crit sec for thread safety, with the thread cache in front of it.
+static void *mem_block_init(mem_block_header_t *block, size_t cls)
+{
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    block->cls = cls;
+    return block + 1;
+}
+
+// The class of a block from its size. A block goes in the largest class it can hold. Must be called with
+// tlsf_crit_sec held
+static size_t mem_block_class(void *block)
+{
+    size_t size = tlsf_block_size(block);
+    return (size >= MEM_CACHE_CLASS_SIZE && size < (MEM_CACHE_CLASSES + 1) * MEM_CACHE_CLASS_SIZE)
+               ? size / MEM_CACHE_CLASS_SIZE - 1
+               : MEM_CACHE_POOL;
+}
+
+static void *mem_alloc(size_t size)
+{
+    if (size == 0)
+    {
+        return NULL;
+    }
+    size += sizeof(mem_block_header_t);
+    mem_cache_t *cache = (size <= DASH_MEM_CACHE_MAX_SIZE) ? mem_cache_get() : NULL;
+    if (cache == NULL)
+    {
+        return mem_block_init(pool_alloc(size), MEM_CACHE_POOL);
+    }
+
+    int cls = (size - 1) / MEM_CACHE_CLASS_SIZE;
+    if (++cache->ops >= DASH_MEM_CACHE_FLUSH_OPS)
+    {
+        cache->ops = 0;
+        for (int i = 0; i < MEM_CACHE_CLASSES; i++)
+        {
+            mem_cache_trim(cache, i, cache->count[i] / 2);
+        }
+    }
+    void *ptr = cache->head[cls];
+    if (ptr)
+    {
+        cache->head[cls] = *(void **)ptr;
+        cache->count[cls]--;
+        return mem_block_init(ptr, cls);
+    }
+    // Allocate the whole class size so the block can be reused for anything in the class
+    ptr = pool_alloc((cls + 1) * MEM_CACHE_CLASS_SIZE);
+    if (ptr == NULL)
+    {
+        // The pool may only be short because of blocks sitting in this thread's cache
+        for (int i = 0; i < MEM_CACHE_CLASSES; i++)
+        {
+            mem_cache_trim(cache, i, 0);
+        }
+        ptr = pool_alloc((cls + 1) * MEM_CACHE_CLASS_SIZE);
+    }
+    return mem_block_init(ptr, cls);
+}
+
+static void mem_free(void *data);
+
+static void *mem_realloc(void *data, size_t new_size)
+{
+    if (data == NULL)
+    {
+        return mem_alloc(new_size);
+    }
+    if (new_size == 0)
+    {
+        mem_free(data);
+        return NULL;
+    }
+
+    // Blocks in the cache are normal tlsf blocks, so can be resized in the pool directly. The resized block may no
+    // longer fit its class, so the class is worked out again
+    mem_block_header_t *block = (mem_block_header_t *)data - 1;
+    new_size += sizeof(mem_block_header_t);
+    EnterCriticalSection(&tlsf_crit_sec);
+    size_t old_size = tlsf_block_size(block);
+    mem_block_header_t *ptr = tlsf_realloc(mem_pool, block, new_size);
+    if (ptr == NULL && pool_grow(new_size))
+    {
+        ptr = tlsf_realloc(mem_pool, block, new_size);
+    }
+    // A failed realloc leaves the old block alone
+    if (ptr)
+    {
+        tlsf_usage -= old_size;
+        tlsf_usage += tlsf_block_size(ptr);
+        ptr->cls = mem_block_class(ptr);
+    }
+    tlsf_peak = LV_MAX(tlsf_peak, tlsf_usage);
+    bool low = pool_check_low() || ptr == NULL;
+    LeaveCriticalSection(&tlsf_crit_sec);
+    if (low)
+    {
+        pool_notify_low();
+    }
+    return (ptr) ? ptr + 1 : NULL;
+}
+
+static void mem_free(void *data)
+{
+    if (data == NULL)
+    {
+        return;
+    }
+    mem_block_header_t *block = (mem_block_header_t *)data - 1;
+    size_t cls = block->cls;
+    mem_cache_t *cache = (cls < MEM_CACHE_CLASSES) ? mem_cache_get() : NULL;
+    if (cache == NULL)
+    {
+        pool_free(block);
+        return;
+    }
+    *(void **)block = cache->head[cls];
+    cache->head[cls] = block;
+    if (++cache->count[cls] >= DASH_MEM_CACHE_DEPTH)
+    {
+        mem_cache_trim(cache, cls, DASH_MEM_CACHE_DEPTH / 2);
+    }
+}
+
+#if DASH_MEM_PROFILE
+// Each allocation is prefixed with the size that was asked for and the tag of the thread that made it.
+// Threads tag their allocations with lx_mem_set_tag()
+typedef struct
+{
+    uint32_t size;
+    uint32_t tag;
+    uint32_t reserved[2];
+} mem_profile_header_t;
+
+static SDL_SpinLock mem_profile_lock;
+static lx_mem_tag_stats_t mem_profile_tags[DASH_MEM_PROFILE_TAGS] = {{"untagged", 0, 0}};
+static int mem_profile_tag_cnt = 1;
+
+static void *mem_profile_add(mem_profile_header_t *header, size_t size, int tag)
+{
+    header->size = size;
+    header->tag = tag;
+    SDL_AtomicLock(&mem_profile_lock);
+    mem_profile_tags[tag].live_bytes += size;
+    mem_profile_tags[tag].live_count++;
+    SDL_AtomicUnlock(&mem_profile_lock);
+    return header + 1;
+}
+
+static void mem_profile_remove(mem_profile_header_t *header)
+{
+    SDL_AtomicLock(&mem_profile_lock);
+    mem_profile_tags[header->tag].live_bytes -= header->size;
+    mem_profile_tags[header->tag].live_count--;
+    SDL_AtomicUnlock(&mem_profile_lock);
+}
+#endif
+
+// Set up the gui heap. Must be called before anything allocates from it
+void lx_mem_init(void)
+{
+    InitializeCriticalSection(&tlsf_crit_sec);
+    mem_pool = tlsf_create_with_pool(mem_pool_data, sizeof(mem_pool_data));
+    mem_pool_capacity = sizeof(mem_pool_data) - tlsf_size();
+#ifdef NXDK
+    // Leave most of the RAM for thumbnails and textures. This scales with 64MB and 128MB consoles
+    size_t ram_total, ram_available;
+    platform_get_ram_usage(&ram_total, &ram_available);
+    mem_pool_budget = LV_MAX(sizeof(mem_pool_data), ram_total / DASH_MEM_POOL_RAM_DIVISOR);
+#else
+    mem_pool_budget = SIZE_MAX;
+#endif
+    mem_cache_tls = SDL_TLSCreate();
+}
+
+void *lx_mem_alloc(size_t size)
+{
+#if DASH_MEM_PROFILE
+    mem_profile_header_t *header = mem_alloc(size + sizeof(mem_profile_header_t));
+    if (header == NULL)
+    {
+        lx_mem_dump_profile(DASH_MEM_PROFILE_PATH);
+        return NULL;
+    }
+    mem_cache_t *cache = mem_cache_get();
+    return mem_profile_add(header, size, (cache) ? cache->tag : 0);
+#else
+    return mem_alloc(size);
+#endif
+}
+
+void *lx_mem_realloc(void *data, size_t new_size)
+{
+#if DASH_MEM_PROFILE
+    if (data == NULL)
+    {
+        return lx_mem_alloc(new_size);
+    }
+    if (new_size == 0)
+    {
+        lx_mem_free(data);
+        return NULL;
+    }
+    mem_profile_header_t *header = (mem_profile_header_t *)data - 1;
+    int tag = header->tag;
+    size_t old_size = header->size;
+    mem_profile_remove(header);
+    mem_profile_header_t *new_header = mem_realloc(header, new_size + sizeof(mem_profile_header_t));
+    if (new_header == NULL)
+    {
+        // The old block is untouched
+        mem_profile_add(header, old_size, tag);
+        lx_mem_dump_profile(DASH_MEM_PROFILE_PATH);
+        return NULL;
+    }
+    return mem_profile_add(new_header, new_size, tag);
+#else
+    return mem_realloc(data, new_size);
+#endif
+}
+
+void lx_mem_free(void *data)
+{
+#if DASH_MEM_PROFILE
+    if (data == NULL)
+    {
+        return;
+    }
+    mem_profile_header_t *header = (mem_profile_header_t *)data - 1;
+    mem_profile_remove(header);
+    mem_free(header);
+#else
+    mem_free(data);
+#endif
+}
+
+// Tag the calling thread's allocations from now on in the heap profile. tag must be a string literal.
+// Returns the previous tag so it can be restored
+const char *lx_mem_set_tag(const char *tag)
+{
+#if DASH_MEM_PROFILE
+    mem_cache_t *cache = mem_cache_get();
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+    SDL_AtomicLock(&mem_profile_lock);
+    const char *prev = mem_profile_tags[cache->tag].name;
+    int i = 0;
+    while (tag && i < mem_profile_tag_cnt && strcmp(mem_profile_tags[i].name, tag) != 0)
+    {
+        i++;
+    }
+    if (tag && i == mem_profile_tag_cnt && i < DASH_MEM_PROFILE_TAGS)
+    {
+        mem_profile_tags[mem_profile_tag_cnt++].name = tag;
+    }
+    // Anything that doesn't fit is counted as untagged
+    cache->tag = (tag && i < mem_profile_tag_cnt) ? i : 0;
+    SDL_AtomicUnlock(&mem_profile_lock);
+    return prev;
+#else
+    (void)tag;
+    return NULL;
+#endif
+}
+
+static void mem_profile_walker(void *ptr, size_t size, int used, void *user)
+{
+    lx_mem_profile_t *profile = user;
+    (void)ptr;
+    if (used == 0)
+    {
+        profile->free_bytes += size;
+        profile->largest_free = LV_MAX(profile->largest_free, size);
+    }
+}
+
+// Usage and fragmentation of the gui heap. Walks the whole pool so it's meant for the debug overlay
+void lx_mem_get_profile(lx_mem_profile_t *profile)
+{
+    memset(profile, 0, sizeof(lx_mem_profile_t));
+    EnterCriticalSection(&tlsf_crit_sec);
+    profile->used_bytes = tlsf_usage;
+    profile->peak_bytes = tlsf_peak;
+    tlsf_walk_pool(tlsf_get_pool(mem_pool), mem_profile_walker, profile);
+    for (mem_pool_chunk_t *chunk = mem_pool_chunks; chunk; chunk = chunk->next)
+    {
+        tlsf_walk_pool(chunk->pool, mem_profile_walker, profile);
+    }
+    LeaveCriticalSection(&tlsf_crit_sec);
+    if (profile->free_bytes)
+    {
+        profile->fragmentation = 100 - (uint32_t)((uint64_t)profile->largest_free * 100 / profile->free_bytes);
+    }
+
+#if DASH_MEM_PROFILE
+    SDL_AtomicLock(&mem_profile_lock);
+    profile->tag_cnt = mem_profile_tag_cnt;
+    memcpy(profile->tags, mem_profile_tags, sizeof(mem_profile_tags));
+    SDL_AtomicUnlock(&mem_profile_lock);
+#endif
+}
+
+void lx_mem_dump_profile(const char *path)
+{
+    lx_mem_profile_t profile;
+    lx_mem_get_profile(&profile);
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        return;
+    }
+    uint32_t capacity;
+    lx_mem_usage(NULL, &capacity);
+    fprintf(fp, "capacity: %u\n", (unsigned int)capacity);
+    fprintf(fp, "used: %u\n", (unsigned int)profile.used_bytes);
+    fprintf(fp, "peak: %u\n", (unsigned int)profile.peak_bytes);
+    fprintf(fp, "free: %u\n", (unsigned int)profile.free_bytes);
+    fprintf(fp, "largest free: %u\n", (unsigned int)profile.largest_free);
+    fprintf(fp, "fragmentation: %u%%\n", (unsigned int)profile.fragmentation);
+    for (int i = 0; i < profile.tag_cnt; i++)
+    {
+        fprintf(fp, "%-16s %10u bytes %8u blocks\n", profile.tags[i].name,
+                (unsigned int)profile.tags[i].live_bytes, (unsigned int)profile.tags[i].live_count);
+    }
+    fclose(fp);
+}
+
+void lx_mem_usage(uint32_t *used, uint32_t *capacity)
+{
+    EnterCriticalSection(&tlsf_crit_sec);
+    if (used)
+    {
+        *used = tlsf_usage;
+    }
+    if (capacity)
+    {
+        *capacity = mem_pool_capacity;
+    }
+    LeaveCriticalSection(&tlsf_crit_sec);
+}
+
+void lx_mem_add_low_memory_cb(lx_mem_low_cb_t cb)
+{
+    EnterCriticalSection(&tlsf_crit_sec);
+    for (int i = 0; i < (int)(sizeof(mem_low_cbs) / sizeof(mem_low_cbs[0])); i++)
+    {
+        if (mem_low_cbs[i] == NULL)
+        {
+            mem_low_cbs[i] = cb;
+            break;
+        }
+    }
+    LeaveCriticalSection(&tlsf_crit_sec);
+}
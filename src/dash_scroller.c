@@ -2,15 +2,18 @@
 // SPDX-FileCopyrightText: 2022 Ryzee119
 
 #include "lithiumx.h"
-#include <src/misc/lv_lru.h>
 #include <src/misc/lv_ll.h>
 
 parse_handle_t *parsers[DASH_MAX_PAGES];
 static lv_obj_t *page_tiles;
 static lv_obj_t *label_footer;
 static int page_current;
-static lv_lru_t *thumbnail_cache;
-static size_t thumbnail_cache_size = (10 * 1024 * 1024);
+static lv_ll_t thumbnail_cache; // Titles with a decompressed thumbnail, least recently used first
+static size_t thumbnail_cache_size;
+static dash_scroller_cache_stats_t thumbnail_cache_stats;
+static SDL_atomic_t thumbnail_cache_shed; // Set when the gui heap is low. The cache is trimmed from the gui thread
+static char null_title_str[] = "No item selected";
+static title_t null_title = {-1, null_title_str, NULL, NULL, -1, 0};
 
 #ifdef NXDK
 #define JPEG_BPP (2)
@@ -18,11 +21,505 @@ static size_t thumbnail_cache_size = (10 * 1024 * 1024);
 #define JPEG_BPP (4)
 #endif
 
+// Number of titles a page reads thumbnails for before adding them to the page
+#define ITEM_SCAN_BATCH 32
+
+// Thumbnails on screen are decompressed before thumbnails that are being prefetched
+#define JPEG_PRIORITY_PREFETCH 0
+#define JPEG_PRIORITY_VISIBLE 1
+
 typedef struct
 {
-    lv_obj_t *image_container;
+    title_t *title;
+    int priority;
+    uint32_t job_id; // Given to the decoder as the job's user data
 } jpeg_ll_value_t;
 static lv_ll_t jpeg_decomp_list;
+static uint32_t jpeg_job_next_id;
+
+// Navigation history used to predict which thumbnails are needed next
+static uint32_t nav_tick;
+static float nav_velocity; // Titles per second, negative when moving back up the page
+static uint32_t page_swap_tick;
+
+static void item_selection_callback(lv_event_t *event);
+static void thumbnail_cancel(title_t *t);
+static void thumbnail_cancel_unwanted(void);
+static void thumbnail_update_priority(void);
+
+static parse_handle_t *page_find(const char *page_title)
+{
+    for (int i = 0; i < DASH_MAX_PAGES; i++)
+    {
+        if (parsers[i] && strcmp(page_title, parsers[i]->page_title) == 0)
+        {
+            return parsers[i];
+        }
+    }
+    return NULL;
+}
+
+static inline uint32_t title_map_hash(int db_id)
+{
+    return (uint32_t)db_id * 2654435761u;
+}
+
+static void title_map_put(title_map_t *map, title_t *t)
+{
+    uint32_t slot = title_map_hash(t->db_id) & map->mask;
+    while (map->slots[slot])
+    {
+        slot = (slot + 1) & map->mask;
+    }
+    map->slots[slot] = t;
+}
+
+// Size a map for title_cnt titles, at most half full, and insert them
+static bool title_map_init(title_map_t *map, title_t **titles, int title_cnt)
+{
+    uint32_t size = 16;
+    while (size < (uint32_t)title_cnt * 2)
+    {
+        size <<= 1;
+    }
+    map->slots = lv_mem_alloc(size * sizeof(title_t *));
+    if (map->slots == NULL)
+    {
+        return false;
+    }
+    lv_memset_00(map->slots, size * sizeof(title_t *));
+    map->mask = size - 1;
+    map->used = title_cnt;
+
+    for (int i = 0; i < title_cnt; i++)
+    {
+        title_map_put(map, titles[i]);
+    }
+    return true;
+}
+
+static title_t *title_map_find(title_map_t *map, int db_id)
+{
+    if (map->slots == NULL)
+    {
+        return NULL;
+    }
+    uint32_t slot = title_map_hash(db_id) & map->mask;
+    while (map->slots[slot])
+    {
+        title_t *t = map->slots[slot];
+        if (t->db_id == db_id && t != &null_title)
+        {
+            return t;
+        }
+        slot = (slot + 1) & map->mask;
+    }
+    return NULL;
+}
+
+// Find a title and remove it from the map so it can't be found again. Its slot is left holding
+// null_title so later probes still walk past it
+static title_t *title_map_take(title_map_t *map, int db_id)
+{
+    if (map->slots == NULL)
+    {
+        return NULL;
+    }
+    uint32_t slot = title_map_hash(db_id) & map->mask;
+    while (map->slots[slot])
+    {
+        title_t *t = map->slots[slot];
+        if (t->db_id == db_id && t != &null_title)
+        {
+            map->slots[slot] = &null_title;
+            return t;
+        }
+        slot = (slot + 1) & map->mask;
+    }
+    return NULL;
+}
+
+// Find a title on a page by its database id. Returns NULL if it is not on the page
+static title_t *page_find_title(parse_handle_t *p, int db_id)
+{
+    return title_map_find(&p->title_map, db_id);
+}
+
+// Returns the index (1 to title_cnt) of a title on a page, or 0 if it is not on the page
+static int page_title_index(parse_handle_t *p, title_t *t)
+{
+    for (int i = 0; i < p->title_cnt; i++)
+    {
+        if (p->titles[i] == t)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Returns the position of a db_id in the titles removed while the page was being read, or -1
+static int page_find_removed(parse_handle_t *p, int db_id)
+{
+    for (int i = 0; i < p->removed_cnt; i++)
+    {
+        if (p->removed_ids[i] == db_id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void page_add_removed(parse_handle_t *p, int db_id)
+{
+    if (page_find_removed(p, db_id) >= 0)
+    {
+        return;
+    }
+    if (p->removed_cnt == p->removed_alloc)
+    {
+        p->removed_alloc = LV_MAX(16, p->removed_alloc * 2);
+        p->removed_ids = lv_mem_realloc(p->removed_ids, p->removed_alloc * sizeof(int));
+        assert(p->removed_ids);
+    }
+    p->removed_ids[p->removed_cnt++] = db_id;
+}
+
+static title_t *page_get_title(parse_handle_t *p, int index)
+{
+    if (index < 1 || index > p->title_cnt)
+    {
+        return NULL;
+    }
+    return p->titles[index - 1];
+}
+
+// The object that is focused for an index. Index 0 is the null item
+static lv_obj_t *page_get_item(parse_handle_t *p, int index)
+{
+    if (index == 0)
+    {
+        return lv_obj_get_child(p->scroller, 0);
+    }
+    return p->pool[(index - 1) % p->pool_cnt];
+}
+
+// The canvas is always the last child of a tile. The label is only created once it's needed
+static lv_obj_t *tile_get_canvas(lv_obj_t *tile)
+{
+    return lv_obj_get_child(tile, lv_obj_get_child_cnt(tile) - 1);
+}
+
+// Get the tile's title label. Most tiles are covered by a thumbnail so it's created the first time the
+// tile shows a title without one
+static lv_obj_t *tile_get_label(lv_obj_t *tile, bool create)
+{
+    if (lv_obj_get_child_cnt(tile) > 1)
+    {
+        return lv_obj_get_child(tile, 0);
+    }
+    if (create == false)
+    {
+        return NULL;
+    }
+
+    lv_obj_t *label = lv_label_create(tile);
+    lv_obj_add_style(label, &titleview_image_text_style, LV_PART_MAIN);
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+    lv_obj_set_width(label, DASH_THUMBNAIL_WIDTH);
+    // Keep it under the thumbnail
+    lv_obj_move_to_index(label, 0);
+    return label;
+}
+
+// Show the title text on a tile. The text is wrapped once per title and the label is given that height, so
+// rebinding a label never changes its size and relayouts the tile
+static void tile_show_label(lv_obj_t *tile, title_t *t, bool covered)
+{
+    lv_obj_t *label = tile_get_label(tile, covered == false);
+    if (label == NULL)
+    {
+        return;
+    }
+    if (covered)
+    {
+        lv_obj_add_flag(label, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+
+    if (t->label_h == 0)
+    {
+        lv_point_t size;
+        lv_txt_get_size(&size, t->title, lv_obj_get_style_text_font(label, LV_PART_MAIN),
+                        lv_obj_get_style_text_letter_space(label, LV_PART_MAIN),
+                        lv_obj_get_style_text_line_space(label, LV_PART_MAIN),
+                        DASH_THUMBNAIL_WIDTH, LV_TEXT_FLAG_NONE);
+        t->label_h = LV_CLAMP(1, size.y, DASH_THUMBNAIL_HEIGHT);
+    }
+    lv_obj_set_height(label, t->label_h);
+    lv_label_set_text(label, t->title);
+    lv_obj_clear_flag(label, LV_OBJ_FLAG_HIDDEN);
+}
+
+// Show the title's thumbnail on its tile if it has been decompressed, otherwise just the title text
+static void tile_show_thumbnail(lv_obj_t *tile, title_t *t)
+{
+    lv_obj_t *canvas = tile_get_canvas(tile);
+    jpg_info_t *jpg_info = t->jpg_info;
+
+    if (jpg_info == NULL || jpg_info->image == NULL)
+    {
+        lv_obj_add_flag(canvas, LV_OBJ_FLAG_HIDDEN);
+        tile_show_label(tile, t, false);
+        return;
+    }
+
+    // Short thumbnails leave some of the text showing underneath
+    tile_show_label(tile, t, jpg_info->h >= DASH_THUMBNAIL_HEIGHT);
+
+    lv_img_cf_t cf = LV_IMG_CF_TRUE_COLOR;
+    assert(JPEG_BPP == 2 || JPEG_BPP == 4);
+    if (JPEG_BPP * 8 != LV_COLOR_DEPTH)
+    {
+        cf = (JPEG_BPP == 2) ? LV_IMG_CF_RGB565 : LV_IMG_CF_RGBA8888;
+    }
+
+    // Atlas rows can be padded past the image width. The padding is clipped off by the tile
+    lv_canvas_set_buffer(canvas, jpg_info->image, dash_atlas_stride(), jpg_info->h, cf);
+    lv_img_set_zoom(canvas, DASH_THUMBNAIL_WIDTH * 256 / jpg_info->w);
+    lv_obj_clear_flag(canvas, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_mark_layout_as_dirty(canvas);
+}
+
+// How much a title's thumbnail is worth keeping. Titles on other pages go first, then titles on this page that
+// aren't bound to a tile, then the tiles on this page.
+static int cache_keep_rank(title_t *t)
+{
+    if (t->page != page_current)
+    {
+        return 0;
+    }
+    return (t->tile) ? 2 : 1;
+}
+
+// Drop a title's thumbnail from the cache
+static void cache_remove(title_t *t)
+{
+    jpg_info_t *jpg_info = t->jpg_info;
+    assert(jpg_info->image && jpg_info->cache_node);
+    _lv_ll_remove(&thumbnail_cache, jpg_info->cache_node);
+    lv_mem_free(jpg_info->cache_node);
+    jpg_info->cache_node = NULL;
+
+    dash_atlas_free(jpg_info->image);
+    jpg_info->image = NULL;
+    thumbnail_cache_stats.resident_bytes -= dash_atlas_slot_size();
+    if (t->tile)
+    {
+        tile_show_thumbnail(t->tile, t);
+    }
+}
+
+// Evict the least recently used thumbnail with the lowest keep rank
+static void cache_evict(void)
+{
+    title_t **node = _lv_ll_get_head(&thumbnail_cache);
+    title_t *victim = NULL;
+    int victim_rank = INT32_MAX;
+    while (node && victim_rank > 0)
+    {
+        int rank = cache_keep_rank(*node);
+        if (rank < victim_rank)
+        {
+            victim = *node;
+            victim_rank = rank;
+        }
+        node = _lv_ll_get_next(&thumbnail_cache, node);
+    }
+    if (victim)
+    {
+        cache_remove(victim);
+        thumbnail_cache_stats.evictions++;
+    }
+}
+
+// Called from any thread when the gui heap is nearly full
+static void cache_low_memory_cb(void)
+{
+    SDL_AtomicSet(&thumbnail_cache_shed, 1);
+}
+
+// Drop every thumbnail that isn't on a tile. They are decompressed again when scrolled back into view
+static void cache_shed_timer(lv_timer_t *timer)
+{
+    if (SDL_AtomicCAS(&thumbnail_cache_shed, 1, 0) == false)
+    {
+        return;
+    }
+    title_t **node = _lv_ll_get_head(&thumbnail_cache);
+    while (node)
+    {
+        title_t *t = *node;
+        node = _lv_ll_get_next(&thumbnail_cache, node);
+        if (cache_keep_rank(t) < 2)
+        {
+            cache_remove(t);
+            thumbnail_cache_stats.evictions++;
+        }
+    }
+}
+
+// Add a title with a newly decompressed thumbnail to the cache, making room if needed
+static void cache_insert(title_t *t)
+{
+    size_t size = dash_atlas_slot_size();
+    while (thumbnail_cache_stats.resident_bytes + size > thumbnail_cache_size && _lv_ll_get_head(&thumbnail_cache))
+    {
+        cache_evict();
+    }
+    title_t **node = _lv_ll_ins_tail(&thumbnail_cache);
+    assert(node);
+    *node = t;
+    t->jpg_info->cache_node = node;
+    thumbnail_cache_stats.resident_bytes += size;
+}
+
+// Mark a title's thumbnail as the most recently used
+static void cache_touch(title_t *t)
+{
+    _lv_ll_move_before(&thumbnail_cache, t->jpg_info->cache_node, NULL);
+}
+
+// Show the title at a position on the page with a tile from the pool. Must be called with the lvgl lock held
+static void tile_bind(parse_handle_t *p, lv_obj_t *tile, int index)
+{
+    title_t *t = page_get_title(p, index);
+    title_t *old = tile->user_data;
+
+    if (t == NULL)
+    {
+        if (old)
+        {
+            old->tile = NULL;
+            thumbnail_cancel(old);
+        }
+        tile->user_data = NULL;
+        lv_obj_add_flag(tile, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+
+    int tile_h = DASH_THUMBNAIL_HEIGHT;
+    int pos = index - 1;
+    lv_obj_set_pos(tile, (pos % p->columns) * DASH_THUMBNAIL_WIDTH, (pos / p->columns) * tile_h);
+    lv_obj_clear_flag(tile, LV_OBJ_FLAG_HIDDEN);
+    if (old == t)
+    {
+        return;
+    }
+
+    if (old)
+    {
+        old->tile = NULL;
+        thumbnail_cancel(old);
+    }
+    // Titles move position when others are added or removed. Take it from the tile it was in.
+    // Otherwise it's just scrolled into view
+    if (t->tile == NULL && t->jpg_info)
+    {
+        if (t->jpg_info->image)
+        {
+            thumbnail_cache_stats.hits++;
+        }
+        else
+        {
+            thumbnail_cache_stats.misses++;
+        }
+    }
+    else if (t->tile)
+    {
+        t->tile->user_data = NULL;
+        lv_obj_add_flag(t->tile, LV_OBJ_FLAG_HIDDEN);
+    }
+    tile->user_data = t;
+    t->tile = tile;
+
+    tile_show_thumbnail(tile, t);
+    if (lv_group_get_focused(lv_group_get_default()) == tile)
+    {
+        lv_label_set_text(label_footer, t->title);
+    }
+}
+
+// Rebind the tile pool to the rows around the current scroll position. The current title is
+// always kept bound so it can stay focused.
+static void page_refresh(parse_handle_t *p)
+{
+    int tile_h = DASH_THUMBNAIL_HEIGHT;
+    int pool_rows = p->pool_cnt / p->columns;
+    int total_rows = (p->title_cnt + p->columns - 1) / p->columns;
+
+    lv_obj_set_height(p->spacer, LV_MAX(1, total_rows * tile_h));
+
+    int first_row = lv_obj_get_scroll_y(p->scroller) / tile_h - DASH_SCROLLER_PREFETCH_ROWS;
+    first_row = LV_MIN(first_row, total_rows - pool_rows);
+    first_row = LV_MAX(first_row, 0);
+    if (p->current_index > 0)
+    {
+        int current_row = (p->current_index - 1) / p->columns;
+        first_row = LV_MIN(first_row, current_row);
+        first_row = LV_MAX(first_row, current_row - pool_rows + 1);
+    }
+
+    int first_index = first_row * p->columns + 1;
+    for (int index = first_index; index < first_index + p->pool_cnt; index++)
+    {
+        tile_bind(p, p->pool[(index - 1) % p->pool_cnt], index);
+    }
+}
+
+// Focus a title on the page and scroll it into view
+static void page_focus_index(parse_handle_t *p, int index, lv_anim_enable_t anim)
+{
+    p->current_index = LV_CLAMP(0, index, p->title_cnt);
+    page_refresh(p);
+
+    if (p->current_index > 0)
+    {
+        int tile_h = DASH_THUMBNAIL_HEIGHT;
+        int y = ((p->current_index - 1) / p->columns) * tile_h;
+        int scroll_y = lv_obj_get_scroll_y(p->scroller);
+        int view_h = lv_obj_get_content_height(p->scroller);
+        if (y < scroll_y)
+        {
+            scroll_y = y;
+        }
+        else if (y + tile_h > scroll_y + view_h)
+        {
+            scroll_y = y + tile_h - view_h;
+        }
+        // Make sure the scroll range includes any newly added rows
+        lv_obj_update_layout(p->scroller);
+        lv_obj_scroll_to_y(p->scroller, scroll_y, anim);
+    }
+    dash_focus_change(page_get_item(p, p->current_index));
+}
+
+// Move the focus back onto the page's current title if something on this page had focus
+static void page_refocus(parse_handle_t *p)
+{
+    lv_obj_t *focused = lv_group_get_focused(lv_group_get_default());
+    if (focused && lv_obj_get_parent(focused) == p->scroller)
+    {
+        dash_focus_change(page_get_item(p, p->current_index));
+    }
+}
+
+static void scroller_scroll_callback(lv_event_t *event)
+{
+    page_refresh(lv_event_get_user_data(event));
+    thumbnail_update_priority();
+}
 
 void dash_scroller_set_page()
 {
@@ -32,100 +529,338 @@ void dash_scroller_set_page()
     lv_obj_set_tile_id(page_tiles, page_current, 0, LV_ANIM_ON);
     lv_obj_t *tile = lv_tileview_get_tile_act(page_tiles);
     lv_obj_t *scroller = lv_obj_get_child(tile, 0);
-    int *current_index = (int *)&scroller->user_data;
-    *current_index = LV_MAX(1, *current_index);
+    parse_handle_t *p = scroller->user_data;
+    p->current_index = LV_MAX(1, p->current_index);
+
+    if (p->current_index > p->title_cnt)
+    {
+        // We were are trying to focus a title that isn't there, revert to index 0 which should always
+        // be present
+        p->current_index = 0;
+    }
+
+    dash_focus_set_final(lv_obj_get_child(scroller, 0));
+    page_focus_index(p, p->current_index, LV_ANIM_OFF);
+    thumbnail_cancel_unwanted();
+}
+
+bool dash_scroller_jump_to(const char *page_title, int db_id)
+{
+    for (int i = 0; i < DASH_MAX_PAGES; i++)
+    {
+        if (parsers[i] == NULL || strcmp(page_title, parsers[i]->page_title) != 0)
+        {
+            continue;
+        }
+        title_t *t = page_find_title(parsers[i], db_id);
+        if (t == NULL)
+        {
+            return false;
+        }
+        parsers[i]->current_index = page_title_index(parsers[i], t);
+        page_current = i;
+        dash_scroller_set_page();
+        return true;
+    }
+    return false;
+}
+
+// jpeg_decomp_list has an entry for each title with a decompression job in flight. Must be called with the lvgl
+// lock held
+static jpeg_ll_value_t *jpeg_decomp_find(title_t *t)
+{
+    jpeg_ll_value_t *item = _lv_ll_get_head(&jpeg_decomp_list);
+    while (item)
+    {
+        if (item->title == t)
+        {
+            return item;
+        }
+        item = _lv_ll_get_next(&jpeg_decomp_list, item);
+    }
+    return NULL;
+}
+
+static void jpeg_decomp_remove(title_t *t)
+{
+    jpeg_ll_value_t *item = jpeg_decomp_find(t);
+    if (item)
+    {
+        _lv_ll_remove(&jpeg_decomp_list, item);
+        lv_mem_free(item);
+    }
+    t->jpg_info->decomp_handle = NULL;
+}
+
+// A decompression job carries an id rather than a pointer to its title. The title can be freed while the job runs
+// and its memory reused by another title, but its entry in jpeg_decomp_list goes with it. Must be called with the
+// lvgl lock held
+static jpeg_ll_value_t *jpeg_decomp_find_job(uint32_t job_id)
+{
+    jpeg_ll_value_t *item = _lv_ll_get_head(&jpeg_decomp_list);
+    while (item)
+    {
+        if (item->job_id == job_id)
+        {
+            return item;
+        }
+        item = _lv_ll_get_next(&jpeg_decomp_list, item);
+    }
+    return NULL;
+}
+
+static void jpg_decompression_complete_cb(void *img, void *mem, int w, int h, void *user_data)
+{
+    uint32_t job_id = (uint32_t)(uintptr_t)user_data;
+
+    // The decoder normally writes straight into an atlas slot. Otherwise pack the image into the atlas before taking
+    // the lock so the copy doesn't hold up the gui
+    void *slot = img;
+    if (mem)
+    {
+        slot = (img) ? dash_atlas_alloc(img, w, &h) : NULL;
+        free(mem);
+    }
+
+    lvgl_getlock();
+
+    // The title may have been removed from its page, or the job aborted, while decompressing
+    jpeg_ll_value_t *item = jpeg_decomp_find_job(job_id);
+    title_t *t = (item) ? item->title : NULL;
+    if (t == NULL)
+    {
+        dash_atlas_free(slot);
+        lvgl_removelock();
+        return;
+    }
+
+    jpeg_decomp_remove(t);
+    if (slot == NULL)
+    {
+        lvgl_removelock();
+        return;
+    }
+
+    // An earlier request already finished
+    if (t->jpg_info->image)
+    {
+        dash_atlas_free(slot);
+        lvgl_removelock();
+        return;
+    }
 
-    assert(lv_obj_get_child_cnt(scroller) >= 1);
+    t->jpg_info->image = slot;
+    t->jpg_info->w = w;
+    t->jpg_info->h = h;
 
-    lv_obj_t *focus_item = lv_obj_get_child(scroller, *current_index);
-    if (lv_obj_is_valid(focus_item) == false)
+    cache_insert(t);
+    if (t->tile)
     {
-        // We were are trying to focus an invalid object, revert to index 0 which should always
-        // be present
-        *current_index = 0;
-        focus_item = lv_obj_get_child(scroller, *current_index);
-        assert(lv_obj_is_valid(scroller));
+        tile_show_thumbnail(t->tile, t);
     }
+    lvgl_removelock();
+}
 
-    dash_focus_set_final(lv_obj_get_child(scroller, 0));
-    dash_focus_change(focus_item);
+static void jpeg_decomp_set_priority(jpeg_ll_value_t *item, int priority)
+{
+    if (item->priority != priority)
+    {
+        item->priority = priority;
+        jpeg_decoder_set_priority(item->title->jpg_info->decomp_handle, priority);
+    }
 }
 
-static void jpg_decompression_complete_cb(void *img, void *mem, int w, int h, void *user_data)
+// Abort decompressing a title's thumbnail unless it was prefetched on purpose
+static void thumbnail_cancel(title_t *t)
 {
-    lv_obj_t *image_container = user_data;
-    title_t *t = image_container->user_data;
+    jpg_info_t *jpg_info = t->jpg_info;
+    if (jpg_info == NULL || jpg_info->decomp_handle == NULL || jpg_info->prevent_abort)
+    {
+        return;
+    }
+    jpeg_decoder_abort(jpg_info->decomp_handle);
+    jpeg_decomp_remove(t);
+}
 
-    lvgl_getlock();
+// Abort the jobs that are neither bound to a tile on the current page nor prefetched
+static void thumbnail_cancel_unwanted(void)
+{
+    jpeg_ll_value_t *item = _lv_ll_get_head(&jpeg_decomp_list);
+    while (item)
+    {
+        jpeg_ll_value_t *next = _lv_ll_get_next(&jpeg_decomp_list, item);
+        title_t *t = item->title;
+        if (t->tile == NULL || t->page != page_current)
+        {
+            thumbnail_cancel(t);
+        }
+        item = next;
+    }
+}
 
-    if (img == NULL)
+// Keep the priority of the jobs in step with what is on screen. Called as the page scrolls
+static void thumbnail_update_priority(void)
+{
+    jpeg_ll_value_t *item = _lv_ll_get_head(&jpeg_decomp_list);
+    while (item)
+    {
+        title_t *t = item->title;
+        bool visible = t->tile && lv_obj_is_visible(t->tile);
+        jpeg_decomp_set_priority(item, visible ? JPEG_PRIORITY_VISIBLE : JPEG_PRIORITY_PREFETCH);
+        item = _lv_ll_get_next(&jpeg_decomp_list, item);
+    }
+}
+
+// Queue the title's thumbnail for decompression if it isn't already decompressed or queued
+static void thumbnail_request(title_t *t, int priority)
+{
+    jpg_info_t *jpg_info = t->jpg_info;
+    if (jpg_info == NULL)
     {
-        t->jpg_info->decomp_handle = NULL;
-        lvgl_removelock();
         return;
     }
 
-    t->jpg_info->mem = mem;
-    t->jpg_info->image = img;
-    t->jpg_info->w = w;
-    t->jpg_info->h = h;
-    t->jpg_info->decomp_handle = NULL;
+    if (jpg_info->decomp_handle == NULL && jpg_info->image == NULL)
+    {
+        uint32_t job_id = jpeg_job_next_id++;
+        jpg_info->decomp_handle = jpeg_decoder_queue(jpg_info->thumb_path, jpg_decompression_complete_cb,
+                                                     (void *)(uintptr_t)job_id, priority);
+        if (jpg_info->decomp_handle) {
+            jpeg_ll_value_t *n = _lv_ll_ins_tail(&jpeg_decomp_list);
+            n->title = t;
+            n->priority = priority;
+            n->job_id = job_id;
+        }
+    }
+    // Already queued, but it may be more urgent now
+    else if (jpg_info->decomp_handle)
+    {
+        jpeg_ll_value_t *item = jpeg_decomp_find(t);
+        if (item && priority > item->priority)
+        {
+            jpeg_decomp_set_priority(item, priority);
+        }
+    }
+
+    // Poke it in cache
+    if (jpg_info->image) {
+        cache_touch(t);
+    }
+}
 
-    t->jpg_info->canvas = lv_canvas_create(image_container);
+// The number of thumbnails that can be prefetched without pushing the page's bound tiles out of the cache
+static int prefetch_budget(parse_handle_t *p)
+{
+    int capacity = thumbnail_cache_size / dash_atlas_slot_size();
+    return LV_MAX(0, capacity - p->pool_cnt);
+}
 
-    lv_img_cf_t cf = LV_IMG_CF_TRUE_COLOR;
-    assert(JPEG_BPP == 2 || JPEG_BPP == 4);
-    if (JPEG_BPP * 8 != LV_COLOR_DEPTH)
+// Forget the last prediction. Anything still wanted is marked again, the rest is aborted by thumbnail_cancel_unwanted()
+static void prefetch_reset(void)
+{
+    jpeg_ll_value_t *item = _lv_ll_get_head(&jpeg_decomp_list);
+    while (item)
     {
-        cf = (JPEG_BPP == 2) ? LV_IMG_CF_RGB565 : LV_IMG_CF_RGBA8888;
+        item->title->jpg_info->prevent_abort = false;
+        item = _lv_ll_get_next(&jpeg_decomp_list, item);
+    }
+}
+
+// Queue the thumbnails from index first towards last, up to budget of them. Returns how much of the budget is left
+static int prefetch_range(parse_handle_t *p, int first, int last, int budget)
+{
+    first = LV_CLAMP(1, first, p->title_cnt);
+    last = LV_CLAMP(1, last, p->title_cnt);
+    int step = (last >= first) ? 1 : -1;
+    int cnt = LV_MIN(budget, LV_ABS(last - first) + 1);
+
+    // The decoder takes the newest of equal priority jobs first, so queue the furthest away first
+    for (int i = cnt - 1; i >= 0; i--)
+    {
+        title_t *t = page_get_title(p, first + i * step);
+        if (t && t->jpg_info)
+        {
+            t->jpg_info->prevent_abort = true;
+            thumbnail_request(t, JPEG_PRIORITY_PREFETCH);
+        }
     }
+    return budget - cnt;
+}
 
-    lv_canvas_set_buffer(t->jpg_info->canvas, img, w, h, cf);
+// Called when the focus moves by step titles. The speed of recent key presses is projected forward to
+// prefetch the rows the user is about to land on, in the direction they are going.
+static void prefetch_on_move(parse_handle_t *p, int index, int step)
+{
+    uint32_t elapsed = LV_MAX(1, lv_tick_elaps(nav_tick));
+    nav_tick = lv_tick_get();
 
-    lv_img_set_size_mode(t->jpg_info->canvas, LV_IMG_SIZE_MODE_REAL);
-    lv_img_set_zoom(t->jpg_info->canvas, DASH_THUMBNAIL_WIDTH * 256 / w);
-    lv_obj_mark_layout_as_dirty(t->jpg_info->canvas);
+    // Key presses further apart than the lookahead start a fresh prediction
+    float velocity = (float)step * 1000.0f / elapsed;
+    nav_velocity = (elapsed > DASH_SCROLLER_PREFETCH_LOOKAHEAD_MS) ? velocity : (nav_velocity + velocity) / 2;
 
-    lv_lru_set(thumbnail_cache, &image_container, sizeof(lv_obj_t *), t, w * h * JPEG_BPP);
-    lvgl_removelock();
+    int dir = (step < 0) ? -1 : 1;
+    int ahead = LV_ABS((int)(nav_velocity * DASH_SCROLLER_PREFETCH_LOOKAHEAD_MS / 1000));
+    ahead += DASH_SCROLLER_PREFETCH_ROWS * p->columns;
+
+    if (index == 0)
+    {
+        return;
+    }
+    prefetch_reset();
+    prefetch_range(p, index + dir, index + dir * ahead, prefetch_budget(p));
+    thumbnail_cancel_unwanted();
 }
 
-static void update_thumbnail_callback(lv_event_t *event)
+// Called after changing page. The page landed on is filled from its current title, and if the user is
+// flicking through pages the screen of the next page in the same direction too.
+static void prefetch_on_page_change(int dir)
 {
-    lv_obj_t *image_container = lv_event_get_target(event);
-    title_t *t = image_container->user_data;
+    uint32_t elapsed = lv_tick_elaps(page_swap_tick);
+    page_swap_tick = lv_tick_get();
 
-    if (t->jpg_info == NULL)
+    parse_handle_t *p = parsers[page_current];
+    if (p == NULL)
     {
         return;
     }
+    prefetch_reset();
 
-    if (t->jpg_info->decomp_handle == NULL && t->jpg_info->mem == NULL)
+    int screen = p->pool_cnt - (2 * DASH_SCROLLER_PREFETCH_ROWS * p->columns);
+    int budget = prefetch_budget(p);
+    if (p->current_index)
     {
-        t->jpg_info->decomp_handle = jpeg_decoder_queue(t->jpg_info->thumb_path,
-                                                        jpg_decompression_complete_cb, image_container);
-        if (t->jpg_info->decomp_handle) {
-            jpeg_ll_value_t *n = _lv_ll_ins_tail(&jpeg_decomp_list);
-            n->image_container = image_container;
-        }
+        budget = prefetch_range(p, p->current_index, p->current_index + p->pool_cnt - 1, budget);
     }
 
-    // Poke it in cache
-    if (t->jpg_info->mem) {
-        lv_obj_t *obj;
-        lv_lru_get(thumbnail_cache, &image_container, sizeof(lv_obj_t *), (void **)&obj);
+    int next = page_current + dir;
+    if (elapsed < DASH_SCROLLER_PREFETCH_LOOKAHEAD_MS && next >= 0 && next < DASH_MAX_PAGES && parsers[next])
+    {
+        parse_handle_t *np = parsers[next];
+        int first = LV_MAX(1, np->current_index);
+        prefetch_range(np, first, first + screen - 1, budget);
+    }
+    thumbnail_cancel_unwanted();
+}
+
+static void update_thumbnail_callback(lv_event_t *event)
+{
+    lv_obj_t *tile = lv_event_get_target(event);
+    title_t *t = tile->user_data;
+
+    if (t == NULL)
+    {
+        return;
     }
+    thumbnail_request(t, JPEG_PRIORITY_VISIBLE);
 }
 
-static int get_launch_path_callback(void *param, int argc, char **argv, char **azColName)
+static int get_launch_path_callback(void *param, sqlite3_stmt *row)
 {
     (void) param;
-    (void) azColName;
-    (void) argc;
-    assert(argc == 1);
+    assert(sqlite3_column_count(row) == 1);
 
-    strncpy(dash_launch_path, argv[0], DASH_MAX_PATH);
-    return 0;
+    strncpy(dash_launch_path, (const char *)sqlite3_column_text(row, 0), DASH_MAX_PATH);
+    return 1;
 }
 
 static void item_selection_callback(lv_event_t *event)
@@ -144,7 +879,10 @@ static void item_selection_callback(lv_event_t *event)
         {
             lv_obj_set_style_border_width(item_container, border_width.num * 2, LV_PART_MAIN);
             lv_obj_set_style_border_color(item_container, lv_color_white(), LV_PART_MAIN);
-            lv_label_set_text(label_footer, t->title);
+            if (t)
+            {
+                lv_label_set_text(label_footer, t->title);
+            }
         }
         else
         {
@@ -152,25 +890,46 @@ static void item_selection_callback(lv_event_t *event)
             lv_obj_set_style_border_color(item_container, border_colour.color, LV_PART_MAIN);
         }
     }
-    else if (e == LV_EVENT_KEY)
+    // Pool tiles that aren't showing a title have no user data and ignore keys
+    else if (e == LV_EVENT_KEY && t)
     {
         lv_obj_t *scroller = lv_obj_get_parent(item_container);
-        int *current_index = (int *)&scroller->user_data;
+        parse_handle_t *p = scroller->user_data;
+        int *current_index = &p->current_index;
 
         lv_key_t key = *((lv_key_t *)lv_event_get_param(event));
         if (key == DASH_PREV_PAGE || key == DASH_NEXT_PAGE)
         {
-            page_current += (key == DASH_NEXT_PAGE) ? (1) : -1;
+            int dir = (key == DASH_NEXT_PAGE) ? (1) : -1;
+            page_current += dir;
             dash_scroller_set_page();
+            prefetch_on_page_change(dir);
         }
         // L and R are the back triggers
         else if (key == LV_KEY_RIGHT || key == LV_KEY_LEFT || key == LV_KEY_UP || key == LV_KEY_DOWN || key == 'L' || key == 'R')
         {
-            int last_index = lv_obj_get_child_cnt(scroller) - 1;
+            int last_index = p->title_cnt;
             int new_index = *current_index;
+            int step;
 
             // FIXME: Should really allow thumbnails of any width
-            int tiles_per_row = lv_obj_get_width(scroller) / DASH_THUMBNAIL_WIDTH;
+            int tiles_per_row = p->columns;
+
+            // Increment left or right one
+            if (key == LV_KEY_RIGHT || key == LV_KEY_LEFT)
+            {
+                step = (key == LV_KEY_RIGHT) ? 1 : -1;
+            }
+            // Increment up or down one
+            else if (key == LV_KEY_UP || key == LV_KEY_DOWN)
+            {
+                step = (key == LV_KEY_DOWN) ? tiles_per_row : -tiles_per_row;
+            }
+            // Increment up or down lots (LT and RT)
+            else
+            {
+                step = (key == 'R') ? (tiles_per_row * 8) : -(tiles_per_row * 8);
+            }
 
             // At the start, loop to end
             if (*current_index <= 1 && key == LV_KEY_UP)
@@ -182,78 +941,51 @@ static void item_selection_callback(lv_event_t *event)
             {
                 new_index = 1;
             }
-            // Increment left or right one
-            else if (key == LV_KEY_RIGHT || key == LV_KEY_LEFT)
-            {
-                new_index += (key == LV_KEY_RIGHT) ? 1 : -1;
-            }
-            // Increment up or down one
-            else if (key == LV_KEY_UP || key == LV_KEY_DOWN)
+            else if (new_index == 0 && (key == LV_KEY_UP || key == LV_KEY_DOWN))
             {
-                if (new_index == 0)
-                {
-                    new_index = 1;
-                }
-                else
-                {
-                    new_index += (key == LV_KEY_DOWN) ? tiles_per_row : -tiles_per_row;
-                }
+                new_index = 1;
             }
-            // Increment up or down lots (LT and RT)
-            else if (key == 'L' || key == 'R')
+            else
             {
-                new_index += (key == 'R') ? (tiles_per_row * 8) : -(tiles_per_row * 8);
+                new_index += step;
             }
             // Clamp the new index within the limits. Prefer index 1 as index 0 is the null
             // item. But will revert to 0 if no items in page
             new_index = LV_MAX(1, new_index);
             new_index = LV_CLAMP(0, new_index, last_index);
-            *current_index = new_index;
-
-            lv_obj_t *new_item_container = lv_obj_get_child(scroller, new_index);
-            assert(lv_obj_is_valid(new_item_container));
 
             // Scroll until our new selection is in view
-            lv_obj_scroll_to_view_recursive(new_item_container, LV_ANIM_ON);
-            dash_focus_change(new_item_container);
+            page_focus_index(p, new_index, LV_ANIM_ON);
 
-            int s = LV_MAX(1, new_index - 2 * tiles_per_row) * (key == LV_KEY_UP);
-            int e = LV_MIN(last_index, new_index + 2 * tiles_per_row) * (key == LV_KEY_DOWN);
-            for (int i = s; i < new_index + e; i++)
-            {
-                lv_event_t e;
-                e.target = lv_obj_get_child(scroller, i);
-                if (e.target)
-                {
-                    title_t *t = e.target->user_data;
-                    if (t->jpg_info)
-                    {
-                        t->jpg_info->prevent_abort = true;
-                        update_thumbnail_callback(&e);
-                    }
-                }
-            }
+            // Start decompressing the thumbnails the user is heading towards before they scroll into view
+            prefetch_on_move(p, new_index, step);
         }
         else if (key == DASH_INFO_PAGE && *current_index != 0)
         {
             dash_synop_open((t->db_id));
         }
+        else if (key == DASH_SEARCH_PAGE)
+        {
+            dash_search_open();
+        }
         else if (key == DASH_SETTINGS_PAGE)
         {
             dash_mainmenu_open();
         }
         else if (key == LV_KEY_ENTER && *current_index > 0)
         {
-            char cmd[SQL_MAX_COMMAND_LEN];
             char time_str[20];
-            lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_GET_LAUNCH_PATH, t->db_id);
-            db_command_with_callback(cmd, get_launch_path_callback, NULL);
+            sqlite3_stmt *stmt = db_query_begin(DB_QUERY_TITLE_GET_LAUNCH_PATH);
+            db_bind_int(stmt, 1, t->db_id);
+            db_query_run(stmt, get_launch_path_callback, NULL);
 
             if (dash_launcher_is_launchable(dash_launch_path))
             {
                 platform_get_iso8601_time(time_str);
-                lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_SET_LAST_LAUNCH_DATETIME, time_str, t->db_id);
-                db_command_with_callback(cmd, NULL, NULL);
+                stmt = db_query_begin(DB_QUERY_TITLE_SET_LAST_LAUNCH);
+                db_bind_text(stmt, 1, time_str);
+                db_bind_int(stmt, 2, t->db_id);
+                db_query_run(stmt, NULL, NULL);
 
                 lv_set_quit(LV_QUIT_OTHER);
             }
@@ -261,25 +993,162 @@ static void item_selection_callback(lv_event_t *event)
     }
 }
 
-static void item_deletion_callback(lv_event_t *event)
+static void tile_deletion_callback(lv_event_t *event)
 {
-    lv_obj_t *item_container = lv_event_get_target(event);
-    title_t *t = item_container->user_data;
-    if (t->jpg_info)
+    lv_obj_t *tile = lv_event_get_target(event);
+    title_t *t = tile->user_data;
+    if (t)
+    {
+        t->tile = NULL;
+    }
+}
+
+// Create a tile for the pool. It is hidden until it is bound to a title
+static lv_obj_t *tile_create(lv_obj_t *scroller)
+{
+    lv_obj_t *tile = lv_obj_create(scroller);
+    tile->user_data = NULL;
+    lv_obj_add_style(tile, &titleview_image_container_style, LV_PART_MAIN);
+    lv_obj_clear_flag(tile, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(tile, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_set_height(tile, DASH_THUMBNAIL_HEIGHT);
+    lv_obj_set_width(tile, DASH_THUMBNAIL_WIDTH);
+
+    // Create a canvas to show the thumbnail over the title label. It uses the title's decompressed jpeg as its
+    // buffer. The label is created by tile_get_label() when it's first needed
+    lv_obj_t *canvas = lv_canvas_create(tile);
+    lv_img_set_size_mode(canvas, LV_IMG_SIZE_MODE_REAL);
+    lv_obj_add_flag(canvas, LV_OBJ_FLAG_HIDDEN);
+
+    lv_group_add_obj(lv_group_get_default(), tile);
+    lv_obj_add_event_cb(tile, item_selection_callback, LV_EVENT_KEY, NULL);
+    lv_obj_add_event_cb(tile, item_selection_callback, LV_EVENT_FOCUSED, NULL);
+    lv_obj_add_event_cb(tile, item_selection_callback, LV_EVENT_DEFOCUSED, NULL);
+    lv_obj_add_event_cb(tile, update_thumbnail_callback, LV_EVENT_DRAW_MAIN_END, NULL);
+    lv_obj_add_event_cb(tile, tile_deletion_callback, LV_EVENT_DELETE, NULL);
+    return tile;
+}
+
+static title_t *title_create(int db_id, const char *title, const char *thumb_path)
+{
+    title_t *t = lv_mem_alloc(sizeof(title_t));
+    assert(t);
+    t->db_id = db_id;
+    t->title = lv_strdup(title);
+    t->tile = NULL;
+    t->jpg_info = NULL;
+    t->page = -1;
+    t->label_h = 0;
+
+    if (thumb_path)
+    {
+        t->jpg_info = lv_mem_alloc(sizeof(jpg_info_t));
+        assert(t->jpg_info);
+        lv_memset(t->jpg_info, 0, sizeof(jpg_info_t));
+        t->jpg_info->thumb_path = lv_strdup(thumb_path);
+    }
+    return t;
+}
+
+static void title_free(title_t *t)
+{
+    if (t->tile)
     {
-        t->jpg_info->decomp_handle = NULL;
-        lv_mem_free(t->jpg_info->thumb_path);
-        lv_mem_free(t->jpg_info);
-        lv_mem_free(t);
+        t->tile->user_data = NULL;
+        lv_obj_add_flag(t->tile, LV_OBJ_FLAG_HIDDEN);
+        t->tile = NULL;
     }
+
+    jpg_info_t *jpg_info = t->jpg_info;
+    if (jpg_info)
+    {
+        jpeg_decoder_abort(jpg_info->decomp_handle);
+        jpeg_decomp_remove(t);
+        if (jpg_info->image)
+        {
+            cache_remove(t);
+        }
+        lv_mem_free(jpg_info->thumb_path);
+        lv_mem_free(jpg_info);
+    }
+    lv_mem_free(t->title);
+    lv_mem_free(t);
+}
+
+// Add a title to the end of a page. Must be called with the lvgl lock held
+static void page_add_title(parse_handle_t *p, title_t *t)
+{
+    if (p->title_cnt == p->title_alloc)
+    {
+        p->title_alloc = LV_MAX(64, p->title_alloc * 2);
+        p->titles = lv_mem_realloc(p->titles, p->title_alloc * sizeof(title_t *));
+        assert(p->titles);
+    }
+    p->titles[p->title_cnt++] = t;
+
+    // Once the map is half full it is rebuilt from the page, which also clears out the removed titles
+    title_map_t *map = &p->title_map;
+    if (map->slots == NULL || (map->used + 1) * 2 > map->mask + 1)
+    {
+        lv_mem_free(map->slots);
+        bool ok = title_map_init(map, p->titles, p->title_cnt);
+        assert(ok);
+        (void)ok;
+    }
+    else
+    {
+        title_map_put(map, t);
+        map->used++;
+    }
+
+    for (int i = 0; i < DASH_MAX_PAGES; i++)
+    {
+        if (parsers[i] == p)
+        {
+            t->page = i;
+        }
+    }
+}
+
+// Remove the title at an index from a page. Must be called with the lvgl lock held
+static void page_remove_title(parse_handle_t *p, int index)
+{
+    title_t *t = p->titles[index - 1];
+    title_map_take(&p->title_map, t->db_id);
+    memmove(&p->titles[index - 1], &p->titles[index], (p->title_cnt - index) * sizeof(title_t *));
+    p->title_cnt--;
+    title_free(t);
+
+    if (index < p->current_index || p->current_index > p->title_cnt)
+    {
+        p->current_index--;
+    }
+}
+
+// Check if a title has a thumbnail. This touches the disk so is called without the lvgl lock held
+static bool title_find_thumbnail(const char *launch_path, char *thumb_path)
+{
+    strcpy(thumb_path, launch_path);
+    char *b = strrchr(thumb_path, DASH_PATH_SEPARATOR);
+    if (b == NULL)
+    {
+        return false;
+    }
+    strcpy(&b[1], DASH_GAME_THUMBNAIL);
+    DWORD fileAttributes = GetFileAttributes(thumb_path);
+    if (fileAttributes == INVALID_FILE_ATTRIBUTES || (fileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        return false;
+    }
+    return true;
 }
 
 typedef struct item_strings
 {
-    char id[8];
+    int id;
     char title[MAX_META_LEN];
     char *launch_path;
-    lv_obj_t *item_container;
+    char *thumb_path;
     struct item_strings *next;
 } item_strings_t;
 
@@ -290,29 +1159,29 @@ typedef struct item_strings_callback
 } item_strings_callback_t;
 
 // Callback when a new row is read from the SQL database. This is a new item to add
-static int item_scan_callback(void *param, int argc, char **argv, char **azColName)
+static int item_scan_callback(void *param, sqlite3_stmt *row)
 {
     item_strings_callback_t *item_cb = param;
-    (void) argc;
-    (void) azColName;
+    const char *title = (const char *)sqlite3_column_text(row, 1);
+    const char *launch_path = (const char *)sqlite3_column_text(row, 2);
 
     item_strings_t *item = lv_mem_alloc(sizeof(item_strings_t));
     lv_memset(item, 0, sizeof(item_strings_t));
 
-    assert(strcmp(azColName[0], SQL_TITLE_DB_ID) == 0);
-    assert(strcmp(azColName[1], SQL_TITLE_NAME) == 0);
-    assert(strcmp(azColName[2], SQL_TITLE_LAUNCH_PATH) == 0);
+    assert(strcmp(sqlite3_column_name(row, 0), SQL_TITLE_DB_ID) == 0);
+    assert(strcmp(sqlite3_column_name(row, 1), SQL_TITLE_NAME) == 0);
+    assert(strcmp(sqlite3_column_name(row, 2), SQL_TITLE_LAUNCH_PATH) == 0);
 
-    strncpy(item->id, argv[0], sizeof(item->id) - 1);
-    strncpy(item->title, argv[1], sizeof(item->title) - 1);
+    item->id = sqlite3_column_int(row, 0);
+    strncpy(item->title, title, sizeof(item->title) - 1);
 
-    if (strlen(argv[2]) <= 3)
+    if (launch_path == NULL || strlen(launch_path) <= 3)
     {
         lv_mem_free(item);
         return 0;
     }
 
-    item->launch_path = lv_strdup(argv[2]);
+    item->launch_path = lv_strdup(launch_path);
 
     if (item_cb->tail == NULL)
     {
@@ -328,153 +1197,96 @@ static int item_scan_callback(void *param, int argc, char **argv, char **azColNa
     return 0;
 }
 
-static void item_scan_add(lv_obj_t *scroller, item_strings_callback_t *item_cb)
+static void item_scan_add(parse_handle_t *p, item_strings_callback_t *item_cb)
 {
+    char *thumb_path = lv_mem_alloc(DASH_MAX_PATH);
     item_strings_t *item = item_cb->head;
-    // First we add all the items to lvgl so they display quickly
     while (item)
     {
-        title_t *t = lv_mem_alloc(sizeof(title_t));
-        assert(t);
-        if (t == NULL)
+        // Look for thumbnails a batch at a time without the lock, then add the batch so the page fills
+        // in quickly
+        item_strings_t *batch = item;
+        for (int i = 0; i < ITEM_SCAN_BATCH && item; i++, item = item->next)
         {
-            continue;
+            if (title_find_thumbnail(item->launch_path, thumb_path))
+            {
+                item->thumb_path = lv_strdup(thumb_path);
+            }
         }
-        t->jpg_info = NULL;
-        t->title[0] = '\0';
-        t->db_id = atoi(item->id);
 
         lvgl_getlock();
-        lv_obj_t *item_container = lv_obj_create(scroller);
-        item->item_container = item_container;
-        item_container->user_data = t;
-        lv_obj_add_style(item_container, &titleview_image_container_style, LV_PART_MAIN);
-        lv_obj_clear_flag(item_container, LV_OBJ_FLAG_SCROLLABLE);
-        lv_obj_set_height(item_container, DASH_THUMBNAIL_HEIGHT);
-        lv_obj_set_width(item_container, DASH_THUMBNAIL_WIDTH);
-
-        // Create a label with the game title
-        lv_obj_t *label = lv_label_create(item_container);
-        lv_obj_add_style(label, &titleview_image_text_style, LV_PART_MAIN);
-        lv_obj_set_width(label, DASH_THUMBNAIL_WIDTH);
-        lv_obj_update_layout(label);
-        lv_label_set_text(label, item->title);
-        lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
-
-        lv_group_add_obj(lv_group_get_default(), item_container);
-        lv_obj_add_event_cb(item_container, item_selection_callback, LV_EVENT_KEY, NULL);
-        lv_obj_add_event_cb(item_container, item_selection_callback, LV_EVENT_FOCUSED, NULL);
-        lv_obj_add_event_cb(item_container, item_selection_callback, LV_EVENT_DEFOCUSED, NULL);
-        lv_obj_add_event_cb(item_container, item_deletion_callback, LV_EVENT_DELETE, NULL);
-
-        strncpy(t->title, item->title, sizeof(t->title) - 1);
-        lvgl_removelock();
-        item = item->next;
-    }
-
-    // Next we scan for thumbnails
-    char *thumb_path = lv_mem_alloc(DASH_MAX_PATH);
-    item = item_cb->head;
-    while (item)
-    {
-        lv_obj_t *item_container = item->item_container;
-        title_t *t = item_container->user_data;
-
-        // Check if a thumbnail exists
-        strcpy(thumb_path, item->launch_path);
-        lv_mem_free(item->launch_path);
-        char *b = strrchr(thumb_path, DASH_PATH_SEPARATOR);
-        if (b == NULL)
-        {
-            item = item->next;
-            continue;
-        }
-        if (b)
-        {
-            strcpy(&b[1], DASH_GAME_THUMBNAIL);
-        }
-        DWORD fileAttributes = GetFileAttributes(thumb_path);
-        if (fileAttributes == INVALID_FILE_ATTRIBUTES || (fileAttributes & FILE_ATTRIBUTE_DIRECTORY))
-        {
-            item = item->next;
-            continue;
-        }
-
-        jpg_info_t *jpg_info = lv_mem_alloc(sizeof(jpg_info_t));
-        assert(jpg_info);
-        if (jpg_info == NULL)
+        for (; batch != item; batch = batch->next)
         {
-            item = item->next;
-            continue;
+            // A background rebuild may have already added this title, or removed it after we read it
+            if (page_find_title(p, batch->id) == NULL && page_find_removed(p, batch->id) < 0)
+            {
+                page_add_title(p, title_create(batch->id, batch->title, batch->thumb_path));
+            }
+            lv_mem_free(batch->launch_path);
+            lv_mem_free(batch->thumb_path);
         }
-        lv_memset(jpg_info, 0, sizeof(jpg_info_t));
-        jpg_info->thumb_path = lv_strdup(thumb_path);
-
-        lvgl_getlock();
-        t->jpg_info = jpg_info;
-        lv_obj_add_event_cb(item_container, update_thumbnail_callback, LV_EVENT_DRAW_MAIN_END, NULL);
-        lv_obj_invalidate(item_container);
+        page_refresh(p);
         lvgl_removelock();
-        item = item->next;
     }
     lv_mem_free(thumb_path);
+
+    // Everything the read returned is on the page now, so removals can be applied to the page directly again
+    lvgl_getlock();
+    p->scanning = false;
+    lv_mem_free(p->removed_ids);
+    p->removed_ids = NULL;
+    p->removed_cnt = 0;
+    p->removed_alloc = 0;
+    lvgl_removelock();
 }
 
-static void dash_scroller_get_sort_strings(unsigned int sort_index, const char **sort_by, const char **order_by)
+static db_query_t dash_scroller_get_sort_query(unsigned int sort_index)
 {
     switch (sort_index)
     {
     case DASH_SORT_RATING:
-        *sort_by = SQL_TITLE_RATING;
-        *order_by = "DESC";
-        break;
+        return DB_QUERY_TITLE_LIST_BY_RATING;
     case DASH_SORT_LAST_LAUNCH:
-        *sort_by = SQL_TITLE_LAST_LAUNCH;
-        *order_by = "DESC";
-        break;
+        return DB_QUERY_TITLE_LIST_BY_LAST_LAUNCH;
     case DASH_SORT_RELEASE_DATE:
-        *sort_by = SQL_TITLE_RELEASE_DATE;
-        *order_by = "DESC";
-        break;
+        return DB_QUERY_TITLE_LIST_BY_RELEASE_DATE;
     default:
-        *sort_by = SQL_TITLE_NAME;
-        *order_by = "ASC";
+        return DB_QUERY_TITLE_LIST_BY_NAME;
     }
 }
 
 static int db_scan_thread_f(void *param)
 {
     parse_handle_t *p = param;
-    char cmd[SQL_MAX_COMMAND_LEN];
+    sqlite3_stmt *stmt;
     SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    lx_mem_set_tag("scroller");
+
+    // Each page reads from its own connection so all pages can populate at the same time
+    db_reader_t *reader = db_reader_open();
 
     item_strings_callback_t item_cb;
     lv_memset(&item_cb, 0, sizeof(item_strings_callback_t));
 
     if (strcmp(p->page_title, "Recent") == 0)
     {
-        lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_GET_RECENT,
-                        SQL_TITLE_DB_ID "," SQL_TITLE_NAME "," SQL_TITLE_LAUNCH_PATH,
-                        dash_settings.earliest_recent_date, dash_settings.max_recent_items);
-
-        db_command_with_callback(cmd, item_scan_callback, &item_cb);
-        item_scan_add(p->scroller, &item_cb);
+        stmt = db_reader_query_begin(reader, DB_QUERY_TITLE_GET_RECENT);
+        db_bind_text(stmt, 1, dash_settings.earliest_recent_date);
+        db_bind_int(stmt, 2, dash_settings.max_recent_items);
+        db_query_run(stmt, item_scan_callback, &item_cb);
+        item_scan_add(p, &item_cb);
     }
     else
     {
         int sort_index = 0;
-        const char *sort_by;
-        const char *order_by;
         dash_scroller_get_sort_value(p->page_title, &sort_index);
-        dash_scroller_get_sort_strings(sort_index, &sort_by, &order_by);
-
-        lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_GET_SORTED_LIST,
-                            SQL_TITLE_DB_ID "," SQL_TITLE_NAME "," SQL_TITLE_LAUNCH_PATH,
-                            p->page_title, sort_by, order_by);
 
-        db_command_with_callback(cmd, item_scan_callback, &item_cb);
-        item_scan_add(p->scroller, &item_cb);
+        stmt = db_reader_query_begin(reader, dash_scroller_get_sort_query(sort_index));
+        db_bind_text(stmt, 1, p->page_title);
+        db_query_run(stmt, item_scan_callback, &item_cb);
+        item_scan_add(p, &item_cb);
     }
+    db_reader_close(reader);
 
     while (item_cb.head)
     {
@@ -485,68 +1297,68 @@ static int db_scan_thread_f(void *param)
     return 0;
 }
 
-static void cache_free(title_t *t)
+void dash_scroller_clear_page(const char *page_title)
 {
-    assert(lv_obj_is_valid(t->jpg_info->canvas));
-    jpeg_decoder_abort(t->jpg_info->decomp_handle);
-    assert(t->jpg_info->mem);
-    free(t->jpg_info->mem);
-    lv_obj_del(t->jpg_info->canvas);
-    t->jpg_info->decomp_handle = NULL;
-    t->jpg_info->mem = NULL;
-    t->jpg_info->image = NULL;
+    parse_handle_t *p = page_find(page_title);
+    if (p == NULL)
+    {
+        return;
+    }
+    while (p->title_cnt)
+    {
+        page_remove_title(p, p->title_cnt);
+    }
+    page_refresh(p);
+    page_refocus(p);
 }
 
-void dash_scroller_clear_page(const char *page_title)
+// Keeps the pages up to date while the database is being rebuilt in the background. New titles are
+// added to the end of their page. The page is put back in order with dash_scroller_resort_page()
+// once the rebuild completes.
+void dash_scroller_title_changed(db_rebuild_event_t event, const db_title_row_t *row)
 {
-    lv_obj_t *scroller = NULL;
-    for (int i = 0; i < DASH_MAX_PAGES; i++)
+    lvgl_getlock();
+    if (event == DB_REBUILD_BATCH_DONE)
     {
-        if (parsers[i] == NULL)
+        // Lay out each changed page once per batch rather than once per title
+        for (int i = 0; i < DASH_MAX_PAGES; i++)
         {
-            continue;
-        }
-        if (strcmp(page_title, parsers[i]->page_title) == 0)
-        {
-            scroller = parsers[i]->scroller;
-            lv_obj_t *item_container = lv_obj_get_child(scroller, 1);
-            while (item_container)
+            if (parsers[i] && parsers[i]->refresh_pending)
             {
-                lv_obj_del(item_container);
-                item_container = lv_obj_get_child(scroller, 1);
+                parsers[i]->refresh_pending = false;
+                page_refresh(parsers[i]);
+                page_refocus(parsers[i]);
             }
         }
+        lvgl_removelock();
+        return;
     }
-}
 
-static void jpeg_clear_timer(lv_timer_t *t)
-{
-    (void) t;
-    jpeg_ll_value_t *item = _lv_ll_get_head(&jpeg_decomp_list);
-    while (item)
+    parse_handle_t *p = page_find(row->page);
+    title_t *t = (p) ? page_find_title(p, row->db_id) : NULL;
+    if (p && event == DB_REBUILD_TITLE_REMOVED && t)
     {
-        lv_obj_t *image_container = item->image_container;
-        title_t *title = image_container->user_data;
-        assert(title->jpg_info);
-        // Still decompressing but no longer visible. Lets abort it.
-        if (lv_obj_is_visible(image_container) == false && title->jpg_info->prevent_abort == false)
-        {
-            jpeg_decoder_abort(title->jpg_info->decomp_handle);
-            title->jpg_info->decomp_handle = NULL;
-        }
-        // Jpeg finished decomp (or was aborted already), dont need to it anymore
-        if (title->jpg_info->decomp_handle == NULL)
-        {
-            _lv_ll_remove(&jpeg_decomp_list, item);
-            lv_mem_free(item);
-            item = _lv_ll_get_head(&jpeg_decomp_list);
-        }
-        // Still compressing, but still visible. Try next item
-        else
+        page_remove_title(p, page_title_index(p, t));
+        p->refresh_pending = true;
+    }
+    // The page may still be adding titles from a read that started before the title was removed
+    else if (p && event == DB_REBUILD_TITLE_REMOVED && p->scanning)
+    {
+        page_add_removed(p, row->db_id);
+    }
+    // The page may have already read this title from the database
+    else if (p && event == DB_REBUILD_TITLE_ADDED && t == NULL)
+    {
+        // A changed folder's title keeps the db_id of the one it replaced
+        int removed = page_find_removed(p, row->db_id);
+        if (removed >= 0)
         {
-            item = _lv_ll_get_next(&jpeg_decomp_list, item);
+            p->removed_ids[removed] = p->removed_ids[--p->removed_cnt];
         }
+        page_add_title(p, title_create(row->db_id, row->title, row->thumb_path));
+        p->refresh_pending = true;
     }
+    lvgl_removelock();
 }
 
 void dash_scroller_init()
@@ -556,14 +1368,24 @@ void dash_scroller_init()
     page_current = dash_settings.startup_page_index;
 
     lv_memset(parsers, 0, sizeof(parsers));
-    thumbnail_cache = lv_lru_create(thumbnail_cache_size, 175 * 248 * JPEG_BPP,
-                                    (lv_lru_free_t *)cache_free, NULL);
+    dash_atlas_init(DASH_THUMBNAIL_WIDTH, DASH_THUMBNAIL_HEIGHT, JPEG_BPP);
+    _lv_ll_init(&thumbnail_cache, sizeof(title_t *));
+
+    // Size the thumbnail cache from the RAM that is free at boot
+    size_t ram_total, ram_available;
+    platform_get_ram_usage(&ram_total, &ram_available);
+    thumbnail_cache_size = LV_CLAMP(DASH_THUMBNAIL_CACHE_MIN, ram_available / DASH_THUMBNAIL_CACHE_RAM_DIVISOR,
+                                    DASH_THUMBNAIL_CACHE_MAX);
+    thumbnail_cache_stats.capacity_bytes = thumbnail_cache_size;
+    lx_mem_add_low_memory_cb(cache_low_memory_cb);
+    lv_timer_create(cache_shed_timer, 100, NULL);
 
     jpeg_decoder_init(JPEG_BPP * 8, 256);
+    jpeg_decoder_set_target(dash_atlas_reserve, dash_atlas_free);
+    dash_thumbnail_init(DASH_THUMBNAIL_WIDTH, JPEG_BPP);
 
     _lv_ll_init(&jpeg_decomp_list, sizeof(jpeg_ll_value_t));
-    lv_timer_create(jpeg_clear_timer, LV_DISP_DEF_REFR_PERIOD, NULL);
- 
+
     // Create a tileview object to manage different pages
     page_tiles = lv_tileview_create(lv_scr_act());
     lv_obj_align(page_tiles, LV_ALIGN_TOP_MID, 0, DASH_YMARGIN);
@@ -585,15 +1407,23 @@ void dash_scroller_scan_db()
     toml_array_t *pages = toml_array_in(paths, "pages");
     int dash_num_pages = LV_MIN(toml_array_nelem(pages), DASH_MAX_PAGES);
 
-    lv_obj_clean(page_tiles);
     for (int i = 0; i < DASH_MAX_PAGES; i++)
     {
         parse_handle_t *parser = parsers[i];
         if (parser == NULL)
             continue;
+        while (parser->title_cnt)
+        {
+            title_free(parser->titles[--parser->title_cnt]);
+        }
+        lv_mem_free(parser->titles);
+        lv_mem_free(parser->title_map.slots);
+        lv_mem_free(parser->removed_ids);
+        lv_mem_free(parser->pool);
         lv_mem_free(parser);
         parsers[i] = NULL;
     }
+    lv_obj_clean(page_tiles);
 
     // Create a parser object for each page. This includes a container to show our game art
     // and all the parse directories to find our items
@@ -611,7 +1441,8 @@ void dash_scroller_scan_db()
 
         // Create a container that will have our scroller game art
         *scroller = lv_obj_create(*tile);
-        (*scroller)->user_data = (void *)1; // Store the currently active index here
+        (*scroller)->user_data = parser;
+        parser->current_index = 1;
 
         // Create a header label for the page from the xml
         lv_obj_t *label_page_title = lv_label_create(*tile);
@@ -635,25 +1466,41 @@ void dash_scroller_scan_db()
         lv_obj_align(*scroller, LV_ALIGN_TOP_MID, 0, lv_obj_get_height(label_page_title));
         lv_obj_set_width(*scroller, sc_w);
         lv_obj_set_height(*scroller, sc_h);
-        // Use flex layout, so new titles automatically get positioned nicely.
-        lv_obj_set_layout(*scroller, LV_LAYOUT_FLEX);
-        lv_obj_set_flex_flow(*scroller, LV_FLEX_FLOW_ROW_WRAP);
+        lv_obj_add_event_cb(*scroller, scroller_scroll_callback, LV_EVENT_SCROLL, parser);
         lv_obj_update_layout(*scroller);
 
         // Create atleast ONE item in the scroller. This is just a null item when nothing is present
-        title_t *t = lv_mem_alloc(sizeof(title_t));
-        t->db_id = -1;
-        strcpy(t->title, "No item selected");
         lv_obj_t *null_item = lv_obj_create(*scroller);
-        null_item->user_data = t;
+        null_item->user_data = &null_title;
         lv_obj_add_flag(null_item, LV_OBJ_FLAG_HIDDEN);
         lv_group_add_obj(lv_group_get_default(), null_item);
         lv_obj_add_event_cb(null_item, item_selection_callback, LV_EVENT_KEY, NULL);
         lv_obj_add_event_cb(null_item, item_selection_callback, LV_EVENT_FOCUSED, NULL);
         lv_obj_add_event_cb(null_item, item_selection_callback, LV_EVENT_DEFOCUSED, NULL);
 
+        // Tiles are positioned by hand, so an invisible object the height of all the rows gives the
+        // scroller its full scroll range
+        parser->spacer = lv_obj_create(*scroller);
+        lv_obj_remove_style_all(parser->spacer);
+        lv_obj_clear_flag(parser->spacer, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_set_size(parser->spacer, 1, 1);
+
+        // Only create enough tiles to cover the visible rows and the prefetch rows either side.
+        // They are rebound to titles as the page scrolls.
+        int tile_h = DASH_THUMBNAIL_HEIGHT;
+        int pool_rows = (sc_h + tile_h - 1) / tile_h + 1 + (2 * DASH_SCROLLER_PREFETCH_ROWS);
+        parser->columns = LV_MAX(1, sc_w / DASH_THUMBNAIL_WIDTH);
+        parser->pool_cnt = pool_rows * parser->columns;
+        parser->pool = lv_mem_alloc(parser->pool_cnt * sizeof(lv_obj_t *));
+        assert(parser->pool);
+        for (int j = 0; j < parser->pool_cnt; j++)
+        {
+            parser->pool[j] = tile_create(*scroller);
+        }
+
         // Start a thread that starts reading the database for items on this page.
         // Thread needs to have a mutex on the database and lvgl
+        parser->scanning = true;
         parser->db_scan_thread = SDL_CreateThread(db_scan_thread_f, "game_parser_thread", parser);
     }
 }
@@ -676,6 +1523,11 @@ int dash_scroller_get_page_count()
     return lv_obj_get_child_cnt(page_tiles);
 }
 
+void dash_scroller_get_cache_stats(dash_scroller_cache_stats_t *stats)
+{
+    *stats = thumbnail_cache_stats;
+}
+
 bool dash_scroller_get_sort_value(const char *page_title, int *sort_value)
 {
     if (page_title == NULL || sort_value == NULL)
@@ -705,89 +1557,61 @@ bool dash_scroller_get_sort_value(const char *page_title, int *sort_value)
 
 struct resort_param
 {
+    title_map_t map;
     int sort_index;
-    lv_obj_t **sorted_objs;
+    int title_cnt;
+    title_t **sorted_titles;
 };
 
-static int resort_page_callback(void *param, int argc, char **argv, char **azColName)
+static int resort_page_callback(void *param, sqlite3_stmt *row)
 {
-    (void) param;
-    (void) azColName;
-    (void) argc;
-
-    assert(argc == 1);
-
-    struct resort_param *p = param;
-    lv_obj_t *scroller = p->sorted_objs[0];
-    int db_id = atoi(argv[0]);
-    lv_task_handler();
-    for (unsigned int i = 1; i < lv_obj_get_child_cnt(scroller); i++)
+    struct resort_param *r = param;
+    title_t *t = title_map_take(&r->map, sqlite3_column_int(row, 0));
+    // The database can be ahead of the page while a background rebuild is running
+    if (t && r->sort_index < r->title_cnt)
     {
-        lv_obj_t *item_container = lv_obj_get_child(scroller, i);
-        //assert(lv_obj_is_valid(item_container));
-        title_t *t = item_container->user_data;
-        if (t->db_id == db_id)
-        {
-            p->sorted_objs[p->sort_index] = item_container;
-            p->sort_index++;
-            return 0;
-        }
+        r->sorted_titles[r->sort_index++] = t;
     }
-    assert(0);
     return 0;
 }
 
 void dash_scroller_resort_page(const char *page_title)
 {
-    char cmd[SQL_MAX_COMMAND_LEN];
     int sort_index;
     if (dash_scroller_get_sort_value(page_title, &sort_index) == false)
     {
         return;
     }
-    
-    lv_obj_t *scroller = NULL;
-    for (int i = 0; i < DASH_MAX_PAGES; i++)
+
+    parse_handle_t *p = page_find(page_title);
+    assert(p);
+
+    // If the page has no items leave
+    if (p->title_cnt == 0)
     {
-        if (parsers[i] == NULL)
-        {
-            continue;
-        }
-        if (strcmp(page_title, parsers[i]->page_title) == 0)
-        {
-            scroller = parsers[i]->scroller;
-            break;
-        }
+        return;
     }
-    assert(scroller);
 
-    // If the scroller has no items leave. 1st item is a null item
-    if (lv_obj_get_child_cnt(scroller) <= 1)
+    // The database does the sorting, each row is then placed in a single pass
+    struct resort_param r;
+    r.sort_index = 0;
+    r.title_cnt = p->title_cnt;
+    r.sorted_titles = lv_mem_alloc(sizeof(title_t *) * r.title_cnt);
+    if (r.sorted_titles == NULL || title_map_init(&r.map, p->titles, r.title_cnt) == false)
     {
+        lv_mem_free(r.sorted_titles);
         return;
     }
 
-    const char *sort_by;
-    const char *order_by;
-    dash_scroller_get_sort_strings(sort_index, &sort_by, &order_by);
-
-    lv_snprintf(cmd, sizeof(cmd), SQL_TITLE_GET_SORTED_LIST, SQL_TITLE_DB_ID, page_title, sort_by, order_by);
-
-    int child_cnt = lv_obj_get_child_cnt(scroller);
-
-    struct resort_param *p = lv_mem_alloc(sizeof(struct resort_param));
-    p->sort_index = 1;
-    p->sorted_objs = lv_mem_alloc(sizeof(lv_obj_t *) * child_cnt);
-    
-    lv_memset(p->sorted_objs, 0, sizeof(lv_obj_t *) * child_cnt);
-    p->sorted_objs[0] = scroller;
-
-    db_command_with_callback(cmd, resort_page_callback, p);
-    for (int i = 1; i < child_cnt; i++)
+    sqlite3_stmt *stmt = db_query_begin(dash_scroller_get_sort_query(sort_index));
+    db_bind_text(stmt, 1, page_title);
+    db_query_run(stmt, resort_page_callback, &r);
+    // Only reorder if the page and database agree, otherwise we'd lose items
+    if (r.sort_index == r.title_cnt && p->title_cnt == r.title_cnt)
     {
-        scroller->spec_attr->children[i] = p->sorted_objs[i];
+        lv_memcpy(p->titles, r.sorted_titles, sizeof(title_t *) * r.title_cnt);
     }
-    lv_mem_free(p->sorted_objs);
-    lv_mem_free(p);
-    lv_obj_mark_layout_as_dirty(scroller);
+    lv_mem_free(r.map.slots);
+    lv_mem_free(r.sorted_titles);
+    page_refresh(p);
 }
@@ -16,14 +16,26 @@ extern "C" {
 #define DASH_SORT_RELEASE_DATE 3
 #define DASH_SORT_MAX 4
 
+typedef struct
+{
+    uint32_t hits;      // A title scrolled into view with its thumbnail already decompressed
+    uint32_t misses;    // A title scrolled into view and its thumbnail had to be decompressed
+    uint32_t evictions; // Thumbnails dropped to make room for another
+    size_t resident_bytes;
+    size_t capacity_bytes;
+} dash_scroller_cache_stats_t;
+
 void dash_scroller_init(void);
 void dash_scroller_scan_db(void);
 void dash_scroller_set_page(void);
+bool dash_scroller_jump_to(const char *page_title, int db_id);
 const char *dash_scroller_get_title(int index);
 bool dash_scroller_get_sort_value(const char *page_title, int *sort_value);
 void dash_scroller_resort_page(const char *page_title);
 void dash_scroller_clear_page(const char *page_title);
+void dash_scroller_title_changed(db_rebuild_event_t event, const db_title_row_t *row);
 int dash_scroller_get_page_count();
+void dash_scroller_get_cache_stats(dash_scroller_cache_stats_t *stats);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+#include "lithiumx.h"
+
+#define SEARCH_WIDTH (LV_MIN(600, lv_obj_get_width(lv_scr_act()) * 2 / 3))
+#define SEARCH_HEIGHT (LV_MIN(440, lv_obj_get_height(lv_scr_act()) * 5 / 6))
+
+typedef struct
+{
+    lv_obj_t *textarea;
+    lv_obj_t *results;
+    lv_obj_t *keyboard;
+    db_reader_t *reader;
+    int result_cnt;
+    int db_id[DASH_SEARCH_MAX_RESULTS];
+    char page[DASH_SEARCH_MAX_RESULTS][MAX_META_LEN];
+} search_ctx_t;
+
+static int search_result_callback(void *param, sqlite3_stmt *row)
+{
+    search_ctx_t *ctx = param;
+    int i = ctx->result_cnt++;
+
+    ctx->db_id[i] = sqlite3_column_int(row, 0);
+    strncpy(ctx->page[i], (const char *)sqlite3_column_text(row, 2), MAX_META_LEN - 1);
+    ctx->page[i][MAX_META_LEN - 1] = '\0';
+
+    lv_table_set_row_cnt(ctx->results, ctx->result_cnt);
+    lv_table_add_cell_ctrl(ctx->results, i, 0, LV_TABLE_CELL_CTRL_TEXT_CROP);
+    lv_table_add_cell_ctrl(ctx->results, i, 1, LV_TABLE_CELL_CTRL_TEXT_CROP);
+    lv_table_set_cell_value(ctx->results, i, 0, (const char *)sqlite3_column_text(row, 1));
+    lv_table_set_cell_value(ctx->results, i, 1, ctx->page[i]);
+    return (ctx->result_cnt == DASH_SEARCH_MAX_RESULTS);
+}
+
+// Turn what the user typed into an fts5 query. Each word is quoted so punctuation is taken literally and
+// the last character is a prefix match so results appear while still typing.
+static void search_build_query(const char *text, char *query, int query_len)
+{
+    int len = 0;
+    while (*text)
+    {
+        while (*text == ' ')
+        {
+            text++;
+        }
+        if (*text == '\0')
+        {
+            break;
+        }
+        // Worst case is every character being a quote that needs escaping
+        if (len + 5 >= query_len)
+        {
+            break;
+        }
+        query[len++] = '"';
+        while (*text && *text != ' ' && len + 4 < query_len)
+        {
+            if (*text == '"')
+            {
+                query[len++] = '"';
+            }
+            query[len++] = *text++;
+        }
+        query[len++] = '"';
+        query[len++] = '*';
+        query[len++] = ' ';
+    }
+    query[len] = '\0';
+}
+
+static void search_update(lv_event_t *event)
+{
+    search_ctx_t *ctx = lv_event_get_user_data(event);
+    char query[DASH_MAX_PATH];
+
+    ctx->result_cnt = 0;
+    lv_table_set_row_cnt(ctx->results, 1);
+    lv_table_set_cell_value(ctx->results, 0, 0, "");
+    lv_table_set_cell_value(ctx->results, 0, 1, "");
+
+    search_build_query(lv_textarea_get_text(ctx->textarea), query, sizeof(query));
+    if (query[0] != '\0')
+    {
+        sqlite3_stmt *stmt = db_reader_query_begin(ctx->reader, DB_QUERY_TITLE_SEARCH);
+        db_bind_text(stmt, 1, query);
+        db_bind_int(stmt, 2, DASH_SEARCH_MAX_RESULTS);
+        db_query_run(stmt, search_result_callback, ctx);
+        if (ctx->result_cnt == 0)
+        {
+            lv_table_set_cell_value(ctx->results, 0, 0, "No matches");
+        }
+    }
+
+    lv_obj_scroll_to_y(ctx->results, 0, LV_ANIM_OFF);
+    lv_obj_invalidate(ctx->results);
+}
+
+static void search_close(search_ctx_t *ctx)
+{
+    lv_obj_t *window = lv_obj_get_parent(lv_obj_get_parent(ctx->keyboard));
+    lv_obj_del(window);
+    dash_focus_pop_depth();
+}
+
+static void search_delete(lv_event_t *event)
+{
+    lv_obj_t *window = lv_event_get_target(event);
+    search_ctx_t *ctx = window->user_data;
+    db_reader_close(ctx->reader);
+    lv_mem_free(ctx);
+}
+
+static void keyboard_callback(lv_event_t *event)
+{
+    lv_event_code_t e = lv_event_get_code(event);
+    search_ctx_t *ctx = lv_event_get_user_data(event);
+
+    if (e == LV_EVENT_KEY)
+    {
+        lv_key_t key = *((lv_key_t *)lv_event_get_param(event));
+        if (key == LV_KEY_ESC || key == DASH_SETTINGS_PAGE)
+        {
+            search_close(ctx);
+        }
+        else if (key == DASH_SEARCH_PAGE)
+        {
+            lv_textarea_del_char(ctx->textarea);
+        }
+    }
+    else if (e == LV_EVENT_CANCEL)
+    {
+        search_close(ctx);
+    }
+    else if (e == LV_EVENT_READY && ctx->result_cnt > 0)
+    {
+        dash_focus_change(ctx->results);
+    }
+}
+
+static void results_callback(lv_event_t *event)
+{
+    lv_event_code_t e = lv_event_get_code(event);
+    search_ctx_t *ctx = lv_event_get_user_data(event);
+
+    if (e == LV_EVENT_KEY)
+    {
+        lv_key_t key = *((lv_key_t *)lv_event_get_param(event));
+        if (key == LV_KEY_ESC || key == DASH_SEARCH_PAGE)
+        {
+            dash_focus_change(ctx->keyboard);
+        }
+    }
+    else if (e == LV_EVENT_PRESSED)
+    {
+        uint16_t row, col;
+        lv_table_get_selected_cell(ctx->results, &row, &col);
+        if (row >= ctx->result_cnt)
+        {
+            return;
+        }
+
+        // Close the search window first so the focus stack is back on the scroller before we jump
+        char page[MAX_META_LEN];
+        int db_id = ctx->db_id[row];
+        strcpy(page, ctx->page[row]);
+        search_close(ctx);
+        dash_scroller_jump_to(page, db_id);
+    }
+}
+
+void dash_search_open(void)
+{
+    search_ctx_t *ctx = lv_mem_alloc(sizeof(search_ctx_t));
+    assert(ctx);
+    lv_memset_00(ctx, sizeof(search_ctx_t));
+
+    lv_obj_t *window = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(window, lv_obj_get_width(lv_scr_act()), lv_obj_get_height(lv_scr_act()));
+    lv_obj_add_style(window, &menu_table_style, LV_PART_MAIN);
+    lv_obj_set_style_border_width(window, 0, LV_PART_MAIN);
+    lv_obj_set_style_bg_opa(window, LV_OPA_60, LV_PART_MAIN);
+    lv_obj_clear_flag(window, LV_OBJ_FLAG_SCROLLABLE);
+    window->user_data = ctx;
+    lv_obj_add_event_cb(window, search_delete, LV_EVENT_DELETE, NULL);
+
+    lv_obj_t *panel = lv_obj_create(window);
+    lv_obj_add_style(panel, &menu_table_style, LV_PART_MAIN);
+    lv_obj_set_size(panel, SEARCH_WIDTH, SEARCH_HEIGHT);
+    lv_obj_align(panel, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_clear_flag(panel, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_flex_flow(panel, LV_FLEX_FLOW_COLUMN);
+
+    ctx->textarea = lv_textarea_create(panel);
+    lv_textarea_set_one_line(ctx->textarea, true);
+    lv_textarea_set_placeholder_text(ctx->textarea, "Search titles, developers, publishers...");
+    lv_textarea_set_max_length(ctx->textarea, MAX_META_LEN - 1);
+    lv_obj_add_style(ctx->textarea, &menu_table_cell_style, LV_PART_MAIN);
+    lv_obj_set_width(ctx->textarea, LV_PCT(100));
+    lv_obj_add_event_cb(ctx->textarea, search_update, LV_EVENT_VALUE_CHANGED, ctx);
+
+    ctx->results = lv_table_create(panel);
+    lv_table_set_col_cnt(ctx->results, 2);
+    lv_table_set_row_cnt(ctx->results, 1);
+    lv_obj_update_layout(panel);
+    lv_coord_t w = lv_obj_get_content_width(panel);
+    lv_table_set_col_width(ctx->results, 0, w * 3 / 4);
+    lv_table_set_col_width(ctx->results, 1, w - (w * 3 / 4));
+    lv_obj_set_width(ctx->results, w);
+    lv_obj_set_flex_grow(ctx->results, 1);
+    lv_obj_add_style(ctx->results, &menu_table_style, LV_PART_MAIN);
+    lv_obj_add_style(ctx->results, &menu_table_style, LV_PART_MAIN | LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(ctx->results, &menu_table_cell_style, LV_PART_ITEMS);
+    lv_obj_add_style(ctx->results, &menu_table_highlight_style, LV_PART_ITEMS | LV_STATE_FOCUS_KEY);
+    lv_obj_add_event_cb(ctx->results, results_callback, LV_EVENT_KEY, ctx);
+    lv_obj_add_event_cb(ctx->results, results_callback, LV_EVENT_PRESSED, ctx);
+    lv_obj_add_event_cb(ctx->results, menu_scroll_to_selected, LV_EVENT_VALUE_CHANGED, NULL);
+    lv_group_add_obj(lv_group_get_default(), ctx->results);
+
+    ctx->keyboard = lv_keyboard_create(panel);
+    lv_obj_set_size(ctx->keyboard, LV_PCT(100), SEARCH_HEIGHT * 2 / 5);
+    lv_keyboard_set_textarea(ctx->keyboard, ctx->textarea);
+    lv_obj_add_event_cb(ctx->keyboard, keyboard_callback, LV_EVENT_KEY, ctx);
+    lv_obj_add_event_cb(ctx->keyboard, keyboard_callback, LV_EVENT_READY, ctx);
+    lv_obj_add_event_cb(ctx->keyboard, keyboard_callback, LV_EVENT_CANCEL, ctx);
+
+    // Searches are run on a separate read connection so they are not held up by a rescan
+    ctx->reader = db_reader_open();
+
+    dash_focus_change_depth(ctx->keyboard);
+}
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+#ifndef _DASH_SEARCH_H
+#define _DASH_SEARCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lithiumx.h"
+
+void dash_search_open(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
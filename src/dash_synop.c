@@ -3,11 +3,8 @@
 
 #include "lithiumx.h"
 
-static int synop_info_callback(void *param, int argc, char **argv, char **azColName)
+static int synop_info_callback(void *param, sqlite3_stmt *row)
 {
-    (void) azColName;
-    (void) argc;
-
     lv_obj_t *synop_text = param;
     const char *format = "%s Title:# %s\n"
                          "%s Developer:# %s\n"
@@ -15,24 +12,24 @@ static int synop_info_callback(void *param, int argc, char **argv, char **azColN
                          "%s Release Date:# %s\n"
                          "%s Rating:# %s/10\n"
                          "%s Overview:# %s";
-    assert(argc == DB_INDEX_MAX);
-    assert(strcmp(azColName[DB_INDEX_TITLE], "title") == 0);
-    assert(strcmp(azColName[DB_INDEX_DEVELOPER], "developer") == 0);
-    assert(strcmp(azColName[DB_INDEX_PUBLISHER], "publisher") == 0);
-    assert(strcmp(azColName[DB_INDEX_RELEASE_DATE], "release_date") == 0);
-    assert(strcmp(azColName[DB_INDEX_RATING], "rating") == 0);
-    assert(strcmp(azColName[DB_INDEX_OVERVIEW], "overview") == 0);
+    assert(sqlite3_column_count(row) == DB_INDEX_MAX);
+    assert(strcmp(sqlite3_column_name(row, DB_INDEX_TITLE), "title") == 0);
+    assert(strcmp(sqlite3_column_name(row, DB_INDEX_DEVELOPER), "developer") == 0);
+    assert(strcmp(sqlite3_column_name(row, DB_INDEX_PUBLISHER), "publisher") == 0);
+    assert(strcmp(sqlite3_column_name(row, DB_INDEX_RELEASE_DATE), "release_date") == 0);
+    assert(strcmp(sqlite3_column_name(row, DB_INDEX_RATING), "rating") == 0);
+    assert(strcmp(sqlite3_column_name(row, DB_INDEX_OVERVIEW), "overview") == 0);
 
 
     lv_label_set_text_fmt(synop_text, format,
-                DASH_MENU_COLOR, argv[DB_INDEX_TITLE],
-                DASH_MENU_COLOR, argv[DB_INDEX_DEVELOPER],
-                DASH_MENU_COLOR, argv[DB_INDEX_PUBLISHER],
-                DASH_MENU_COLOR, argv[DB_INDEX_RELEASE_DATE],
-                DASH_MENU_COLOR, argv[DB_INDEX_RATING],
-                DASH_MENU_COLOR, argv[DB_INDEX_OVERVIEW]);
+                DASH_MENU_COLOR, sqlite3_column_text(row, DB_INDEX_TITLE),
+                DASH_MENU_COLOR, sqlite3_column_text(row, DB_INDEX_DEVELOPER),
+                DASH_MENU_COLOR, sqlite3_column_text(row, DB_INDEX_PUBLISHER),
+                DASH_MENU_COLOR, sqlite3_column_text(row, DB_INDEX_RELEASE_DATE),
+                DASH_MENU_COLOR, sqlite3_column_text(row, DB_INDEX_RATING),
+                DASH_MENU_COLOR, sqlite3_column_text(row, DB_INDEX_OVERVIEW));
 
-    return 0;
+    return 1;
 }
 
 static void synop_close(lv_event_t *event)
@@ -57,10 +54,9 @@ void dash_synop_open(int id)
     lv_label_set_long_mode(synop_text, LV_LABEL_LONG_WRAP);
 
     // Read synop info from database
-    char *cmd = lv_mem_alloc(SQL_MAX_COMMAND_LEN);
-    lv_snprintf(cmd, SQL_MAX_COMMAND_LEN, SQL_TITLE_GET_BY_ID, id);
-    db_command_with_callback(cmd, synop_info_callback, synop_text);
-    lv_mem_free(cmd);
+    sqlite3_stmt *stmt = db_query_begin(DB_QUERY_TITLE_GET_BY_ID);
+    db_bind_int(stmt, 1, id);
+    db_query_run(stmt, synop_info_callback, synop_text);
     lv_obj_update_layout(window);
     
 
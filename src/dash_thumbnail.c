@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+// A store of thumbnails that have already been decompressed and scaled to the tile width. Each one is kept
+// as raw pixels in its own file in DASH_THUMBNAIL_CACHE_PATH, named after a hash of the source jpeg path.
+// Showing a stored thumbnail is a single read with no jpeg decompression. Files are written under a temporary
+// name and renamed into place, so the scan and decoder threads can store the same thumbnail at once and a
+// reader never sees a partly written file.
+
+#include "lithiumx.h"
+
+#define THUMBNAIL_MAGIC 0x4254584C // "LXTB"
+#define THUMBNAIL_VERSION 2
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t bpp;
+    uint16_t w;
+    uint16_t h;
+    uint32_t reserved;
+    int64_t src_size; // Size and modified time of the source jpeg. If either changes the thumbnail is regenerated
+    int64_t src_mtime;
+    uint64_t src_hash; // Hash of the source jpeg path, so a file name shared by two paths isn't shown for both
+} thumbnail_header_t;
+
+static int thumbnail_width;
+static int thumbnail_bpp;
+
+// FNV-1a
+static uint64_t thumbnail_hash(const char *str)
+{
+    uint64_t hash = 14695981039346656037ull;
+    while (*str)
+    {
+        hash ^= (uint8_t)*str++;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void thumbnail_cache_path(const char *thumb_path, char *cache_path)
+{
+    uint64_t hash = thumbnail_hash(thumb_path);
+    lv_snprintf(cache_path, DASH_MAX_PATH, "%s%c%08x%08x.raw", DASH_THUMBNAIL_CACHE_PATH, DASH_PATH_SEPARATOR,
+                (unsigned int)(hash >> 32), (unsigned int)hash);
+}
+
+static bool thumbnail_header_valid(const thumbnail_header_t *header, const char *thumb_path)
+{
+    if (header->src_hash != thumbnail_hash(thumb_path))
+    {
+        return false;
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (GetFileAttributesEx(thumb_path, GetFileExInfoStandard, &attr) == 0)
+    {
+        return false;
+    }
+    int64_t size = ((int64_t)attr.nFileSizeHigh << 32) | (int64_t)attr.nFileSizeLow;
+    int64_t mtime = ((int64_t)attr.ftLastWriteTime.dwHighDateTime << 32) | (int64_t)attr.ftLastWriteTime.dwLowDateTime;
+
+    return header->magic == THUMBNAIL_MAGIC && header->version == THUMBNAIL_VERSION &&
+           header->bpp == thumbnail_bpp && header->w == thumbnail_width &&
+           header->src_size == size && header->src_mtime == mtime;
+}
+
+// Called by the jpeg decoder threads before decompressing a jpeg
+static int thumbnail_load(const char *thumb_path, void **img, void **mem, int *w, int *h)
+{
+    char cache_path[DASH_MAX_PATH];
+    thumbnail_cache_path(thumb_path, cache_path);
+
+    FILE *fp = fopen(cache_path, "rb");
+    if (fp == NULL)
+    {
+        return 0;
+    }
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (len <= (long)sizeof(thumbnail_header_t))
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    // Read the whole file in one go. It is placed so the pixels after the header are 16 byte aligned
+    *mem = malloc(len + 16);
+    if (*mem == NULL)
+    {
+        fclose(fp);
+        return 0;
+    }
+    uint8_t *pixels = (uint8_t *)(((uintptr_t)*mem + sizeof(thumbnail_header_t) + 15) & ~(uintptr_t)15);
+    thumbnail_header_t *header = (thumbnail_header_t *)(pixels - sizeof(thumbnail_header_t));
+    size_t read = fread(header, 1, len, fp);
+    fclose(fp);
+
+    if (read != (size_t)len || thumbnail_header_valid(header, thumb_path) == false ||
+        len != (long)(sizeof(thumbnail_header_t) + header->w * header->h * header->bpp))
+    {
+        free(*mem);
+        *mem = NULL;
+        return 0;
+    }
+
+    *img = pixels;
+    *w = header->w;
+    *h = header->h;
+    return 1;
+}
+
+// Called by the jpeg decoder threads after decompressing a jpeg
+static void thumbnail_store(const char *thumb_path, const void *img, int w, int h, int pitch)
+{
+    char cache_path[DASH_MAX_PATH];
+    char tmp_path[DASH_MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+
+    // Only images that were scaled to the tile width are stored
+    if (w != thumbnail_width || GetFileAttributesEx(thumb_path, GetFileExInfoStandard, &attr) == 0)
+    {
+        return;
+    }
+
+    thumbnail_header_t header = {
+        .magic = THUMBNAIL_MAGIC,
+        .version = THUMBNAIL_VERSION,
+        .bpp = thumbnail_bpp,
+        .w = w,
+        .h = h,
+        .reserved = 0,
+        .src_size = ((int64_t)attr.nFileSizeHigh << 32) | (int64_t)attr.nFileSizeLow,
+        .src_mtime = ((int64_t)attr.ftLastWriteTime.dwHighDateTime << 32) | (int64_t)attr.ftLastWriteTime.dwLowDateTime,
+        .src_hash = thumbnail_hash(thumb_path),
+    };
+
+    // Each thread writes its own temporary file
+    thumbnail_cache_path(thumb_path, cache_path);
+    lv_snprintf(tmp_path, sizeof(tmp_path), "%s.%08x", cache_path, (unsigned int)SDL_ThreadID());
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp == NULL)
+    {
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (pitch == w * thumbnail_bpp)
+    {
+        ok &= fwrite(img, w * h * thumbnail_bpp, 1, fp) == 1;
+    }
+    else
+    {
+        // The image was decompressed into padded texture memory
+        for (int y = 0; y < h; y++)
+        {
+            ok &= fwrite((const uint8_t *)img + y * pitch, w * thumbnail_bpp, 1, fp) == 1;
+        }
+    }
+    ok &= fclose(fp) == 0;
+    if (ok == false)
+    {
+        remove(tmp_path);
+        return;
+    }
+
+    // rename() replaces an existing file in one step where the file system allows it. Where it doesn't, the old
+    // file is removed first. Whoever renames last wins, both files are complete
+    if (rename(tmp_path, cache_path) != 0)
+    {
+        remove(cache_path);
+        if (rename(tmp_path, cache_path) != 0)
+        {
+            remove(tmp_path);
+        }
+    }
+}
+
+void dash_thumbnail_init(int width, int bpp)
+{
+    thumbnail_width = width;
+    thumbnail_bpp = bpp;
+    CreateDirectory(DASH_THUMBNAIL_CACHE_PATH, NULL);
+
+    jpeg_decoder_set_width(width);
+    jpeg_decoder_set_cache(thumbnail_load, thumbnail_store);
+}
+
+// Make sure a stored thumbnail exists and is up to date. This decompresses the jpeg in the calling thread so it is
+// used by the database rebuild, before the title is ever shown.
+void dash_thumbnail_generate(const char *thumb_path)
+{
+    char cache_path[DASH_MAX_PATH];
+    thumbnail_header_t header;
+
+    thumbnail_cache_path(thumb_path, cache_path);
+    FILE *fp = fopen(cache_path, "rb");
+    if (fp)
+    {
+        size_t read = fread(&header, sizeof(header), 1, fp);
+        fclose(fp);
+        if (read == 1 && thumbnail_header_valid(&header, thumb_path))
+        {
+            return;
+        }
+    }
+
+    void *mem;
+    int w, h;
+    void *img = jpeg_decoder_decode(thumb_path, &mem, &w, &h);
+    if (img)
+    {
+        thumbnail_store(thumb_path, img, w, h, w * thumbnail_bpp);
+    }
+    free(mem);
+}
+
+typedef struct
+{
+    uint64_t *hashes;
+    int cnt;
+    int alloc;
+    bool failed;
+} thumbnail_prune_t;
+
+static int thumbnail_prune_callback(void *param, int argc, char **argv, char **azColName)
+{
+    thumbnail_prune_t *prune = param;
+    char thumb_path[DASH_MAX_PATH];
+    (void)argc;
+    (void)azColName;
+
+    // The thumbnail sits next to the launch xbe, the same as the rebuild finds it
+    if (argv[0] == NULL)
+    {
+        return 0;
+    }
+    lv_snprintf(thumb_path, sizeof(thumb_path), "%s", argv[0]);
+    char *b = strrchr(thumb_path, DASH_PATH_SEPARATOR);
+    if (b == NULL)
+    {
+        return 0;
+    }
+    b[1] = '\0';
+    strncat(thumb_path, DASH_GAME_THUMBNAIL, sizeof(thumb_path) - strlen(thumb_path) - 1);
+
+    if (prune->cnt == prune->alloc)
+    {
+        prune->alloc = LV_MAX(256, prune->alloc * 2);
+        uint64_t *hashes = lv_mem_realloc(prune->hashes, prune->alloc * sizeof(uint64_t));
+        if (hashes == NULL)
+        {
+            prune->failed = true;
+            return 1;
+        }
+        prune->hashes = hashes;
+    }
+    prune->hashes[prune->cnt++] = thumbnail_hash(thumb_path);
+    return 0;
+}
+
+static int thumbnail_hash_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Delete stored thumbnails that no title in the database uses any more, and temporary files left by an
+// interrupted write. Called once a rebuild has completed.
+void dash_thumbnail_prune(void)
+{
+    char path[DASH_MAX_PATH];
+    WIN32_FIND_DATA findData;
+    thumbnail_prune_t prune = {NULL, 0, 0, false};
+    int removed = 0;
+
+    db_command_with_callback(SQL_TITLE_GET_ALL_LAUNCH_PATHS, thumbnail_prune_callback, &prune);
+    // Without the full list nothing can be safely deleted
+    if (prune.failed)
+    {
+        lv_mem_free(prune.hashes);
+        return;
+    }
+    qsort(prune.hashes, prune.cnt, sizeof(uint64_t), thumbnail_hash_compare);
+
+    lv_snprintf(path, sizeof(path), "%s\\*", DASH_THUMBNAIL_CACHE_PATH);
+    HANDLE hFind = FindFirstFile(path, &findData);
+    if (hFind == INVALID_HANDLE_VALUE)
+    {
+        lv_mem_free(prune.hashes);
+        return;
+    }
+    do
+    {
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            continue;
+        }
+
+        // Anything that isn't a complete thumbnail named after its hash is removed
+        unsigned int hi, lo;
+        char ext[8] = {0};
+        bool keep = false;
+        if (strlen(findData.cFileName) == 20 && sscanf(findData.cFileName, "%8x%8x.%3s", &hi, &lo, ext) == 3 &&
+            strcmp(ext, "raw") == 0)
+        {
+            uint64_t hash = ((uint64_t)hi << 32) | lo;
+            keep = bsearch(&hash, prune.hashes, prune.cnt, sizeof(uint64_t), thumbnail_hash_compare) != NULL;
+        }
+        if (keep == false)
+        {
+            lv_snprintf(path, sizeof(path), "%s%c%s", DASH_THUMBNAIL_CACHE_PATH, DASH_PATH_SEPARATOR,
+                        findData.cFileName);
+            removed += (remove(path) == 0);
+        }
+    } while (FindNextFile(hFind, &findData));
+    FindClose(hFind);
+
+    lv_mem_free(prune.hashes);
+    dash_printf(LEVEL_TRACE, "Removed %d unused thumbnails\n", removed);
+}
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+#ifndef _DASH_THUMBNAIL_H
+#define _DASH_THUMBNAIL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lithiumx.h"
+
+void dash_thumbnail_init(int width, int bpp);
+void dash_thumbnail_generate(const char *thumb_path);
+void dash_thumbnail_prune(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
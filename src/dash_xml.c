@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+// Reads the fields we show from a game's _resources/default.xml metadata file.
+
+#include "lithiumx.h"
+
+// A tag we want the text of from a metadata xml. Only the first occurrence of each tag is used
+typedef struct
+{
+    const char *tag;
+    char *buf;
+    int buf_len;
+    int len;
+    bool found;
+} xml_field_t;
+
+typedef struct
+{
+    xml_field_t *fields;
+    int field_cnt;
+    xml_field_t *active;
+} xml_extract_t;
+
+static void xml_append(xml_field_t *field, const char *str, int len)
+{
+    len = LV_MIN(len, field->buf_len - 1 - field->len);
+    if (len <= 0)
+    {
+        return;
+    }
+    memcpy(&field->buf[field->len], str, len);
+    field->len += len;
+    field->buf[field->len] = '\0';
+}
+
+// Process a batch of tokens from sxml. Character data can be split over several tokens (at entities
+// or where the read buffer was refilled) so text is appended until the next non-character token.
+static void xml_extract_tokens(const char *xml, const sxmltok_t *tokens, int num_tokens, xml_extract_t *ex)
+{
+    static const struct
+    {
+        const char *entity;
+        char c;
+    } entities[] = {{"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}};
+
+    for (int i = 0; i < num_tokens; i++)
+    {
+        const sxmltok_t *t = &tokens[i];
+        const char *str = &xml[t->startpos];
+        int len = t->endpos - t->startpos;
+
+        if (t->type == SXML_CHARACTER && ex->active)
+        {
+            int e;
+            for (e = 0; e < (int)DASH_ARRAY_SIZE(entities); e++)
+            {
+                if (len == (int)strlen(entities[e].entity) && strncmp(str, entities[e].entity, len) == 0)
+                {
+                    xml_append(ex->active, &entities[e].c, 1);
+                    break;
+                }
+            }
+            if (e == (int)DASH_ARRAY_SIZE(entities))
+            {
+                xml_append(ex->active, str, len);
+            }
+            continue;
+        }
+
+        ex->active = NULL;
+        if (t->type != SXML_STARTTAG)
+        {
+            continue;
+        }
+
+        for (int j = 0; j < ex->field_cnt; j++)
+        {
+            xml_field_t *field = &ex->fields[j];
+            if (field->found == false && (int)strlen(field->tag) == len && strncmp(str, field->tag, len) == 0)
+            {
+                field->found = true;
+                ex->active = field;
+                break;
+            }
+        }
+    }
+}
+
+// The dates in the xbmc xml format are dd MMM YYYY, We want it to be YYYY-MM-DD
+static void convert_xml_date_to_iso8601(const char* input, char output[11]) {
+    int day, year;
+    char month[4];
+
+    sscanf(input, "%d %3s %d", &day, month, &year);
+
+    static const char* months[] = {
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+    };
+
+    int monthNumber = 0;
+    for (int i = 0; i < 12; i++) {
+        if (strcmp(month, months[i]) == 0) {
+            monthNumber = i + 1;
+            break;
+        }
+    }
+    lv_snprintf(output, 11, "%04d-%02d-%02d", year, monthNumber, day);
+}
+
+// The xml is streamed through a small fixed buffer and all tags are matched in a single pass, so memory
+// use doesn't depend on the size of the file.
+bool dash_xml_parse(const char *xml_path, char *title, char *title_id, char *developer,
+                    char *publisher, char *release_date, float *rating, char *overview)
+{
+    sxml_t parser;
+    sxmlerr_t err;
+    sxmltok_t tokens[DASH_XML_TOKENS];
+    char xml_buf[DASH_XML_CHUNK_SIZE];
+    char rating_str[12] = {0};
+
+    xml_field_t fields[] = {
+        {"title", title, MAX_META_LEN, 0, false},
+        {"developer", developer, MAX_META_LEN, 0, false},
+        {"publisher", publisher, MAX_META_LEN, 0, false},
+        {"release_date", release_date, MAX_META_LEN, 0, false},
+        {"titleid", title_id, MAX_META_LEN, 0, false},
+        {"overview", overview, MAX_OVERVIEW_LEN, 0, false},
+        {"rating", rating_str, sizeof(rating_str), 0, false},
+    };
+    xml_extract_t ex = {fields, DASH_ARRAY_SIZE(fields), NULL};
+
+    FILE *fp = fopen(xml_path, "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    unsigned int len = fread(xml_buf, 1, sizeof(xml_buf), fp);
+    sxml_init(&parser);
+    while (1)
+    {
+        err = sxml_parse(&parser, xml_buf, len, tokens, DASH_ARRAY_SIZE(tokens));
+        unsigned int ntokens = parser.ntokens;
+        xml_extract_tokens(xml_buf, tokens, ntokens, &ex);
+        parser.ntokens = 0;
+
+        // If no tokens were returned a single tag needs more tokens than we have. Give up
+        if (err == SXML_ERROR_TOKENSFULL && ntokens > 0)
+        {
+            continue;
+        }
+        if (err != SXML_ERROR_BUFFERDRY)
+        {
+            break;
+        }
+
+        // Keep the unparsed tail and top the buffer back up
+        len -= parser.bufferpos;
+        memmove(xml_buf, &xml_buf[parser.bufferpos], len);
+        parser.bufferpos = 0;
+        unsigned int read_len = fread(&xml_buf[len], 1, sizeof(xml_buf) - len, fp);
+        if (read_len == 0)
+        {
+            // End of file before the document closed, or a tag larger than our buffer
+            break;
+        }
+        len += read_len;
+    }
+    fclose(fp);
+
+    if (err != SXML_SUCCESS)
+    {
+        dash_printf(LEVEL_WARN, "Could not parse %s (%d)\n", xml_path, err);
+        return false;
+    }
+
+    *rating = atof(rating_str);
+    if (release_date[0] != '\0')
+    {
+        char iso8601_date[11];
+        convert_xml_date_to_iso8601(release_date, iso8601_date);
+        strcpy(release_date, iso8601_date);
+    }
+
+    return true;
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Ryzee119
+
+#ifndef _DASH_XML_H
+#define _DASH_XML_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lithiumx.h"
+
+bool dash_xml_parse(const char *xml_path, char *title, char *title_id, char *developer,
+                    char *publisher, char *release_date, float *rating, char *overview);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
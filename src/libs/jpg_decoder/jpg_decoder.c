@@ -1,10 +1,12 @@
 // SPDX-License-Identifier: MIT
 // SPDX-FileCopyrightText: 2022 Ryzee119
 
-/* Uses jpegturbo to decompress a jpeg file. Decompression is run in a different thread to minimise blocking.
- * jpegs are queued with jpeg_decoder_queue(). A callback is made when the compression is complete.
- * Up to JPEG_DECODER_QUEUE_SIZE
- * files can be queued.
+/* Uses jpegturbo to decompress a jpeg file. Decompression is run in a pool of JPEG_DECODER_THREADS worker threads
+ * to minimise blocking. jpegs are queued with jpeg_decoder_queue(). A callback is made when the compression is complete.
+ * Up to JPEG_DECODER_QUEUE_SIZE files can be queued. Queued jobs are kept in a binary heap so the highest priority
+ * job is always decompressed next. For equal priorities the most recently queued job runs first.
+ * Aborted jobs are pulled straight out of the queue. A job that is already decompressing checks for an abort between
+ * each iMCU row, and each worker keeps its decompressor object so an aborted file is dropped with jpeg_abort_decompress().
  * SDL2 is used for portable thread, mutex and atomic support
  */
 
@@ -19,7 +21,8 @@ typedef enum
 {
     STATE_FREE,          // Mempool item free and ready to use
     STATE_DECOMP_QUEUED, // Mempool item currently queued
-    STATE_DECOMP_ABORTED // Mempool item had started decompression, but was aborted
+    STATE_DECOMP_ABORTED, // Mempool item had started decompression, but was aborted
+    STATE_DECOMP_COMPLETING // Mempool item is finished and its complete_cb is being called. It can no longer be aborted
 } jpeg_image_state_t;
 
 typedef struct jpeg
@@ -27,27 +30,42 @@ typedef struct jpeg
     char fn[256];       // Stores the filename for this jpeg
     SDL_atomic_t state; // jpeg_image_state_t. Track state of jpeg decompression
     void *user_data;    // User data to be returned on complete_cb;
-    uint8_t *mem;
-    uint8_t *decompressed_image;
     jpg_complete_cb_t complete_cb; // Callback for jpeg decompression complete. Warning: Called from decomp thread context.
-    struct jpeg *next;             // Singley linked list for decompression queue
+    int priority;                  // Higher priority jobs are decompressed first
+    uint32_t sequence;             // Order the job was queued in. Newer jobs win between equal priorities
+    int heap_index;                // Position in jpegdecomp_heap, or -1 if not queued
 } jpeg_t;
 
 static int jpeg_decoder_running = 0;
 static int jpeg_colour_depth;                      // What colour depth should the decompress jpeg be (16 (RGB565) or 32 (BGRA))
 static int jpeg_max_dimension;                     // The maximum output dimension of the width or height (whichever is larger)
+static int jpeg_output_width;                      // If set, images are scaled to exactly this width instead
+static jpg_cache_load_cb_t jpeg_cache_load;        // Optional cache of decompressed images checked before decompressing
+static jpg_cache_store_cb_t jpeg_cache_store;
+static jpg_target_alloc_cb_t jpeg_target_alloc;    // Optional memory that images are decompressed straight into
+static jpg_target_free_cb_t jpeg_target_free;
 static SDL_mutex *jpegdecomp_qmutex;               // Mutex for the jpeg decompressor thread queue
 static SDL_sem *jpegdecomp_queue;                  // Semaphore to track nubmer of items in decompressor queue
-static SDL_Thread *jpegdecomp_thread;              // Thread for the jpeg decompressor
+static SDL_Thread *jpegdecomp_threads[JPEG_DECODER_THREADS]; // Worker threads for the jpeg decompressor
 static jpeg_t jpeg_mpool[JPEG_DECODER_QUEUE_SIZE]; // Local mempool for jpeg objects
 static jpeg_t *jpeg_mpool_free;                    // Stores a free pointer in mempool that can be used to quickly allocate from pool
-static jpeg_t *jpegdecomp_qhead;                   // Tracks a singly linked list of queued jpegs for decompression in thread
+static jpeg_t *jpegdecomp_heap[JPEG_DECODER_QUEUE_SIZE]; // Max heap of queued jpegs waiting for a worker thread
+static int jpegdecomp_heap_cnt;
+static uint32_t jpegdecomp_sequence;
 
 struct jpeg_decoder_error_mgr {
   struct jpeg_error_mgr pub;
   jmp_buf setjmp_buffer;
 };
 
+// A decompressor that is kept between files
+typedef struct
+{
+    struct jpeg_decompress_struct jinfo;
+    struct jpeg_decoder_error_mgr jerr;
+    uint8_t *target; // Decode target memory for the current file, if any
+} jpeg_decoder_ctx_t;
+
 static void error_exit_stub(j_common_ptr cinfo)
 {
     struct jpeg_decoder_error_mgr *myerr = (void *)cinfo->err;
@@ -66,126 +84,468 @@ static void* align_pointer(void* ptr, int align)
     return (void*)address;
 }
 
-static int decomp_thread(void *ptr)
+// The heap functions must be called with jpegdecomp_qmutex held
+static int heap_before(const jpeg_t *a, const jpeg_t *b)
 {
-    FILE *jfile;
-    jpeg_t *jpeg;
-    struct jpeg_decompress_struct jinfo;
-    struct jpeg_decoder_error_mgr jerr;
-    JSAMPARRAY line_buffer;
-    int row_stride;
-    void *old_line_buffer;
-    jpeg_image_state_t state;
-
-    while (1)
+    if (a->priority != b->priority)
     {
-        // Wait for a jpeg item to be in the decomp queue.
-        SDL_SemWait(jpegdecomp_queue);
+        return a->priority > b->priority;
+    }
+    return (int32_t)(a->sequence - b->sequence) > 0;
+}
 
-        if (jpeg_decoder_running == 0)
+static void heap_set(int index, jpeg_t *jpeg)
+{
+    jpegdecomp_heap[index] = jpeg;
+    jpeg->heap_index = index;
+}
+
+static void heap_sift_up(int index)
+{
+    jpeg_t *jpeg = jpegdecomp_heap[index];
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (heap_before(jpeg, jpegdecomp_heap[parent]) == 0)
         {
-            return 0;
+            break;
         }
-        SDL_LockMutex(jpegdecomp_qmutex);
-        jpeg = jpegdecomp_qhead;
-        jpegdecomp_qhead = jpeg->next;
-        SDL_UnlockMutex(jpegdecomp_qmutex);
+        heap_set(index, jpegdecomp_heap[parent]);
+        index = parent;
+    }
+    heap_set(index, jpeg);
+}
 
-        state = SDL_AtomicGet(&jpeg->state);
-        if (state == STATE_DECOMP_ABORTED)
+static void heap_sift_down(int index)
+{
+    jpeg_t *jpeg = jpegdecomp_heap[index];
+    while (1)
+    {
+        int child = index * 2 + 1;
+        if (child >= jpegdecomp_heap_cnt)
         {
-            goto leave_error;
+            break;
         }
-
-        jfile = fopen(jpeg->fn, "rb");
-        if (jfile == NULL)
+        if (child + 1 < jpegdecomp_heap_cnt && heap_before(jpegdecomp_heap[child + 1], jpegdecomp_heap[child]))
+        {
+            child++;
+        }
+        if (heap_before(jpegdecomp_heap[child], jpeg) == 0)
         {
-            printf("Could not open %s\n", jpeg->fn);
-            goto leave_error;
+            break;
         }
+        heap_set(index, jpegdecomp_heap[child]);
+        index = child;
+    }
+    heap_set(index, jpeg);
+}
 
-        jpeg_create_decompress(&jinfo);
-        jinfo.err = jpeg_std_error(&jerr.pub);
-        jerr.pub.error_exit = error_exit_stub;
+static void heap_push(jpeg_t *jpeg)
+{
+    assert(jpegdecomp_heap_cnt < JPEG_DECODER_QUEUE_SIZE);
+    heap_set(jpegdecomp_heap_cnt++, jpeg);
+    heap_sift_up(jpeg->heap_index);
+}
 
-        if (setjmp(jerr.setjmp_buffer)) {
-            jpeg_destroy_decompress(&jinfo);
-            fclose(jfile);
-            goto leave_error;
-        }
+static void heap_remove(jpeg_t *jpeg)
+{
+    int index = jpeg->heap_index;
+    jpeg->heap_index = -1;
+    if (--jpegdecomp_heap_cnt > index)
+    {
+        // Fill the hole with the last item and move it to wherever it belongs
+        jpeg_t *moved = jpegdecomp_heap[jpegdecomp_heap_cnt];
+        heap_set(index, moved);
+        heap_sift_up(index);
+        heap_sift_down(moved->heap_index);
+    }
+}
 
-        jpeg_stdio_src(&jinfo, jfile);
-        if (jpeg_read_header(&jinfo, TRUE) != JPEG_HEADER_OK)
+static jpeg_t *heap_pop(void)
+{
+    if (jpegdecomp_heap_cnt == 0)
+    {
+        return NULL;
+    }
+    jpeg_t *jpeg = jpegdecomp_heap[0];
+    heap_remove(jpeg);
+    return jpeg;
+}
+
+static uint8_t blend_channel(int a, int b, int f)
+{
+    return a + (((b - a) * f) >> 8);
+}
+
+static uint16_t blend_rgb565(uint16_t a, uint16_t b, int f)
+{
+    int r = blend_channel(a >> 11, b >> 11, f);
+    int g = blend_channel((a >> 5) & 0x3F, (b >> 5) & 0x3F, f);
+    int bl = blend_channel(a & 0x1F, b & 0x1F, f);
+    return (r << 11) | (g << 5) | bl;
+}
+
+// Bilinear resize of a decompressed image into dst, which is pitch bytes per row. The decoder has already scaled it
+// to less than 2x the output size. Only the first rows of the dw x dh output are written.
+static void resize_into(const uint8_t *src, int sw, int sh, uint8_t *dst, int pitch, int dw, int dh, int rows)
+{
+    int bpp = jpeg_colour_depth / 8;
+
+    // 16.16 fixed point steps through the source image
+    uint32_t x_step = ((uint32_t)sw << 16) / dw;
+    uint32_t y_step = ((uint32_t)sh << 16) / dh;
+    for (int y = 0; y < rows; y++)
+    {
+        uint32_t sy = y * y_step;
+        int y0 = sy >> 16;
+        int y1 = (y0 + 1 < sh) ? y0 + 1 : y0;
+        int fy = (sy >> 8) & 0xFF;
+        uint8_t *dst_row = &dst[y * pitch];
+        for (int x = 0; x < dw; x++)
         {
-            printf("Invalid jpeg file at %s\n", jpeg->fn);
-            jpeg_destroy_decompress(&jinfo);
-            fclose(jfile);
-            goto leave_error;
+            uint32_t sx = x * x_step;
+            int x0 = sx >> 16;
+            int x1 = (x0 + 1 < sw) ? x0 + 1 : x0;
+            int fx = (sx >> 8) & 0xFF;
+            if (bpp == 2)
+            {
+                const uint16_t *s = (const uint16_t *)src;
+                uint16_t top = blend_rgb565(s[y0 * sw + x0], s[y0 * sw + x1], fx);
+                uint16_t bottom = blend_rgb565(s[y1 * sw + x0], s[y1 * sw + x1], fx);
+                ((uint16_t *)dst_row)[x] = blend_rgb565(top, bottom, fy);
+            }
+            else
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    int top = blend_channel(src[(y0 * sw + x0) * 4 + c], src[(y0 * sw + x1) * 4 + c], fx);
+                    int bottom = blend_channel(src[(y1 * sw + x0) * 4 + c], src[(y1 * sw + x1) * 4 + c], fx);
+                    dst_row[x * 4 + c] = blend_channel(top, bottom, fy);
+                }
+            }
         }
-        jinfo.out_color_space = (jpeg_colour_depth == 16) ? JCS_RGB565 : JCS_EXT_BGRA;
+    }
+}
 
+static uint8_t *resize_image(const uint8_t *src, int sw, int sh, int dw, int dh, void **mem)
+{
+    int bpp = jpeg_colour_depth / 8;
+    *mem = malloc(dw * dh * bpp + 16);
+    if (*mem == NULL)
+    {
+        return NULL;
+    }
+    uint8_t *dst = align_pointer(*mem, 16);
+    resize_into(src, sw, sh, dst, dw * bpp, dw, dh, dh);
+    return dst;
+}
+
+// Copy a packed image into the decode target. On success the image is replaced with the target and mem is freed.
+static void move_to_target(uint8_t **image, void **mem, int w, int *h)
+{
+    int pitch;
+    int rows = *h;
+    int row_size = w * (jpeg_colour_depth / 8);
+    uint8_t *target = jpeg_target_alloc(w, &rows, &pitch);
+    if (target == NULL)
+    {
+        return;
+    }
+    for (int y = 0; y < rows; y++)
+    {
+        memcpy(&target[y * pitch], &(*image)[y * row_size], row_size);
+    }
+    free(*mem);
+    *mem = NULL;
+    *image = target;
+    *h = rows;
+}
+
+static void decoder_ctx_init(jpeg_decoder_ctx_t *ctx)
+{
+    ctx->jinfo.err = jpeg_std_error(&ctx->jerr.pub);
+    ctx->jerr.pub.error_exit = error_exit_stub;
+    jpeg_create_decompress(&ctx->jinfo);
+}
+
+static int is_aborted(SDL_atomic_t *state)
+{
+    return state && SDL_AtomicGet(state) == STATE_DECOMP_ABORTED;
+}
+
+static void release_target(jpeg_decoder_ctx_t *ctx)
+{
+    if (ctx->target)
+    {
+        jpeg_target_free(ctx->target);
+        ctx->target = NULL;
+    }
+}
+
+// Decompress a jpeg file. Returns a 16 byte aligned image or NULL on error or if the job was aborted.
+// mem is set to the allocation that must be freed with free(). If want_target is set and a target allocator is
+// registered, the final pass writes straight into target memory instead, mem is NULL and pitch is the target's row size.
+// The decompressor is left ready for the next file.
+static uint8_t *decode_file(jpeg_decoder_ctx_t *ctx, const char *fn, SDL_atomic_t *state, int want_target,
+                            void **mem, int *w, int *h, int *pitch)
+{
+    struct jpeg_decompress_struct *jinfo = &ctx->jinfo;
+    FILE *jfile;
+    JSAMPROW rows[32];
+    int row_stride;
+    int target_rows = 0;
+    // Both live across the setjmp below, so must not be kept in registers a libjpeg error would clobber
+    JSAMPARRAY volatile scratch = NULL;
+    volatile int use_target = want_target && jpeg_target_alloc && jpeg_output_width > 0;
+    uint8_t *image = NULL;
+
+    ctx->target = NULL;
+
+    *mem = NULL;
+    jfile = fopen(fn, "rb");
+    if (jfile == NULL)
+    {
+        printf("Could not open %s\n", fn);
+        return NULL;
+    }
+
+    if (setjmp(ctx->jerr.setjmp_buffer)) {
+        jpeg_abort_decompress(jinfo);
+        fclose(jfile);
+        free(*mem);
+        *mem = NULL;
+        release_target(ctx);
+        return NULL;
+    }
+
+    jpeg_stdio_src(jinfo, jfile);
+    if (jpeg_read_header(jinfo, TRUE) != JPEG_HEADER_OK)
+    {
+        printf("Invalid jpeg file at %s\n", fn);
+        jpeg_abort_decompress(jinfo);
+        fclose(jfile);
+        return NULL;
+    }
+    jinfo->out_color_space = (jpeg_colour_depth == 16) ? JCS_RGB565 : JCS_EXT_BGRA;
+
+    if (jpeg_output_width > 0)
+    {
+        // Scale down as far as possible in the decoder while staying at least as wide as the output
+        jinfo->scale_num = 8;
+        jinfo->scale_denom = 8;
+        jpeg_calc_output_dimensions(jinfo);
+        while (jinfo->scale_num > 1)
+        {
+            jinfo->scale_num--;
+            jpeg_calc_output_dimensions(jinfo);
+            if ((int)jinfo->output_width < jpeg_output_width)
+            {
+                jinfo->scale_num++;
+                jpeg_calc_output_dimensions(jinfo);
+                break;
+            }
+        }
+    }
+    else
+    {
         int max_size;
-        jinfo.scale_num = 9;
-        jinfo.scale_denom = 8;
+        jinfo->scale_num = 9;
+        jinfo->scale_denom = 8;
         do
         {
-            jinfo.scale_num--;
-            jpeg_calc_output_dimensions(&jinfo);
-            max_size = (jinfo.output_width < jinfo.output_height) ? jinfo.output_height : jinfo.output_width;
-            if (jinfo.scale_num == 1)
+            jinfo->scale_num--;
+            jpeg_calc_output_dimensions(jinfo);
+            max_size = (jinfo->output_width < jinfo->output_height) ? jinfo->output_height : jinfo->output_width;
+            if (jinfo->scale_num == 1)
             {
                 break;
             }
         } while (max_size > jpeg_max_dimension);
-        jinfo.do_fancy_upsampling = FALSE;
-        jinfo.do_block_smoothing = FALSE;
-        jinfo.two_pass_quantize = FALSE;
-        jinfo.dct_method = JDCT_FASTEST;
-        jinfo.dither_mode = JDITHER_NONE;
-        jpeg_start_decompress(&jinfo);
-        jinfo.output_components = jpeg_colour_depth / 8;
-        row_stride = jinfo.output_width * jinfo.output_components;
-        line_buffer = (*jinfo.mem->alloc_sarray)((j_common_ptr)&jinfo, JPOOL_IMAGE, row_stride, 1);
-
-        old_line_buffer = line_buffer[0]; // Save the original allocation
-
-        jpeg->mem = malloc(jinfo.output_width * jinfo.output_height * (jpeg_colour_depth / 8) + 16);
+    }
+    jinfo->do_fancy_upsampling = FALSE;
+    jinfo->do_block_smoothing = FALSE;
+    jinfo->two_pass_quantize = FALSE;
+    jinfo->dct_method = JDCT_FASTEST;
+    jinfo->dither_mode = JDITHER_NONE;
+
+    // Aborted while reading the header, don't bother starting
+    if (is_aborted(state))
+    {
+        jpeg_abort_decompress(jinfo);
+        fclose(jfile);
+        return NULL;
+    }
+
+    jpeg_start_decompress(jinfo);
+    row_stride = jinfo->output_width * (jpeg_colour_depth / 8);
+
+    // If the decoder already produces the output width there is no resize, so scanlines go straight into the target.
+    // The target may hold fewer rows than the image, the rest are decoded into a scratch row and dropped
+    if (use_target && (int)jinfo->output_width == jpeg_output_width)
+    {
+        target_rows = jinfo->output_height;
+        ctx->target = jpeg_target_alloc(jinfo->output_width, &target_rows, &row_stride);
+    }
+    if (ctx->target)
+    {
+        image = ctx->target;
+        scratch = (*jinfo->mem->alloc_sarray)((j_common_ptr)jinfo, JPOOL_IMAGE, row_stride, 1);
+    }
+    else
+    {
+        target_rows = jinfo->output_height;
+        *mem = malloc(jinfo->output_width * jinfo->output_height * (jpeg_colour_depth / 8) + 16);
         //Get a 16 byte aligned pointer to return to the user
-        jpeg->decompressed_image = align_pointer(jpeg->mem, 16);
+        image = (*mem) ? align_pointer(*mem, 16) : NULL;
+    }
 
-        while (jinfo.output_scanline < jinfo.output_height)
+    // Scanlines are read straight into the image one iMCU row at a time, which is the unit the decoder works in
+#if JPEG_LIB_VERSION >= 70
+    int chunk = jinfo->max_v_samp_factor * jinfo->min_DCT_v_scaled_size;
+#else
+    int chunk = jinfo->max_v_samp_factor * jinfo->min_DCT_scaled_size;
+#endif
+    chunk = (chunk < 1) ? 1 : (chunk > 32) ? 32 : chunk;
+    while (image && jinfo->output_scanline < jinfo->output_height)
+    {
+        if (is_aborted(state))
         {
-            state = SDL_AtomicGet(&jpeg->state);
-            if (state == STATE_DECOMP_ABORTED)
-            {
-                free(jpeg->mem);
-                jpeg->decompressed_image = NULL;
-            }
+            free(*mem);
+            *mem = NULL;
+            release_target(ctx);
+            image = NULL;
+            break;
+        }
 
-            if (jpeg->decompressed_image == NULL)
-            {
-                break;
-            }
+        int n = jinfo->output_height - jinfo->output_scanline;
+        n = (n < chunk) ? n : chunk;
+        for (int i = 0; i < n; i++)
+        {
+            int y = jinfo->output_scanline + i;
+            rows[i] = (y < target_rows) ? &image[y * row_stride] : scratch[0];
+        }
+        jpeg_read_scanlines(jinfo, rows, n);
+    }
 
-            // Save a memcpy and put our buffer directly into JSAMPARRAY
-            line_buffer[0] = (void *)&jpeg->decompressed_image[jinfo.output_scanline * row_stride];
-            jpeg_read_scanlines(&jinfo, line_buffer, 1);
+    // Drops any remaining work and the image's memory pool, but keeps the decompressor for the next file
+    jpeg_abort_decompress(jinfo);
+    fclose(jfile);
 
-            if (jinfo.output_scanline % 200 == 0)
-            {
-                SDL_Delay(1);
-            }
+    *w = jinfo->output_width;
+    *h = target_rows;
+    *pitch = row_stride;
+
+    // Finish the scaling to the exact output width. This is the final pass so it writes into the target if there is one
+    if (image && jpeg_output_width > 0 && *w != jpeg_output_width && is_aborted(state) == 0)
+    {
+        void *scaled_mem = NULL;
+        uint8_t *scaled = NULL;
+        int scaled_h = (*h * jpeg_output_width + *w / 2) / *w;
+        int rows_out = scaled_h;
+        if (use_target)
+        {
+            ctx->target = jpeg_target_alloc(jpeg_output_width, &rows_out, pitch);
+            scaled = ctx->target;
         }
+        if (scaled)
+        {
+            resize_into(image, *w, *h, scaled, *pitch, jpeg_output_width, scaled_h, rows_out);
+        }
+        else
+        {
+            rows_out = scaled_h;
+            *pitch = jpeg_output_width * (jpeg_colour_depth / 8);
+            scaled = resize_image(image, *w, *h, jpeg_output_width, scaled_h, &scaled_mem);
+        }
+        free(*mem);
+        *mem = scaled_mem;
+        image = scaled;
+        *w = jpeg_output_width;
+        *h = rows_out;
+    }
+    else if (image == NULL || is_aborted(state))
+    {
+        free(*mem);
+        *mem = NULL;
+        release_target(ctx);
+        image = NULL;
+    }
+    return image;
+}
 
-        line_buffer[0] = old_line_buffer; // Restore original allocation so it gets cleared
-        jpeg_destroy_decompress(&jinfo);
-        fclose(jfile);
+static void jpeg_release(jpeg_t *jpeg)
+{
+    SDL_AtomicSet(&jpeg->state, STATE_FREE);
+    jpeg_mpool_free = jpeg;
+}
+
+static int decomp_thread(void *ptr)
+{
+    jpeg_t *jpeg;
+    jpeg_decoder_ctx_t ctx;
+    (void)ptr;
+
+    // Decompression competes with the UI for the cpu, the UI should win
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    decoder_ctx_init(&ctx);
+
+    while (1)
+    {
+        // Wait for a jpeg item to be in the decomp queue.
+        SDL_SemWait(jpegdecomp_queue);
+
+        if (jpeg_decoder_running == 0)
+        {
+            break;
+        }
+        SDL_LockMutex(jpegdecomp_qmutex);
+        jpeg = heap_pop();
+        SDL_UnlockMutex(jpegdecomp_qmutex);
+
+        // The job was aborted and pulled out of the queue before we got to it
+        if (jpeg == NULL)
+        {
+            continue;
+        }
 
-        jpeg->complete_cb(jpeg->decompressed_image, jpeg->mem, jinfo.output_width, jinfo.output_height, jpeg->user_data);
+        void *mem = NULL;
+        uint8_t *image = NULL;
+        int w = 0, h = 0, pitch = 0;
 
-    leave_error:
-        SDL_AtomicSet(&jpeg->state, STATE_FREE);
+        // A pre-scaled copy of the image may be cached already which saves decompressing it.
+        // Nothing is done if it was aborted after being taken from the queue
+        if (SDL_AtomicGet(&jpeg->state) != STATE_DECOMP_ABORTED &&
+            (jpeg_cache_load == NULL || jpeg_cache_load(jpeg->fn, (void **)&image, &mem, &w, &h) == 0))
+        {
+            image = decode_file(&ctx, jpeg->fn, &jpeg->state, 1, &mem, &w, &h, &pitch);
+            if (image && jpeg_cache_store)
+            {
+                jpeg_cache_store(jpeg->fn, image, w, h, pitch);
+            }
+        }
+        else if (image && jpeg_target_alloc && w == jpeg_output_width)
+        {
+            move_to_target(&image, &mem, w, &h);
+        }
+
+        // Once completing the job can no longer be aborted. An aborted job has no callback
+        if (SDL_AtomicCAS(&jpeg->state, STATE_DECOMP_QUEUED, STATE_DECOMP_COMPLETING))
+        {
+            jpeg->complete_cb(image, mem, w, h, jpeg->user_data);
+        }
+        else if (mem == NULL && image)
+        {
+            jpeg_target_free(image);
+        }
+        else
+        {
+            free(mem);
+        }
+        SDL_LockMutex(jpegdecomp_qmutex);
+        jpeg_release(jpeg);
+        SDL_UnlockMutex(jpegdecomp_qmutex);
     }
+    jpeg_destroy_decompress(&ctx.jinfo);
     return 0;
 }
 
@@ -200,30 +560,45 @@ void jpeg_decoder_init(int colour_depth, int max_dimension)
     jpeg_decoder_running = 1;
 
     memset(jpeg_mpool, 0, sizeof(jpeg_mpool));
+    for (int i = 0; i < JPEG_DECODER_QUEUE_SIZE; i++)
+    {
+        jpeg_mpool[i].heap_index = -1;
+    }
     jpeg_colour_depth = colour_depth;
     jpeg_max_dimension = max_dimension;
-    jpegdecomp_qhead = NULL;
+    jpegdecomp_heap_cnt = 0;
+    jpegdecomp_sequence = 0;
     jpeg_mpool_free = &jpeg_mpool[0];
     jpegdecomp_qmutex = SDL_CreateMutex();
     jpegdecomp_queue = SDL_CreateSemaphore(0);
-    jpegdecomp_thread = SDL_CreateThread(decomp_thread, "jpegdecomp_thread", (void *)NULL);
 
     assert(jpegdecomp_qmutex != NULL);
-    assert(jpegdecomp_thread != NULL);
     assert(jpegdecomp_queue != NULL);
+
+    for (int i = 0; i < JPEG_DECODER_THREADS; i++)
+    {
+        jpegdecomp_threads[i] = SDL_CreateThread(decomp_thread, "jpegdecomp_thread", (void *)NULL);
+        assert(jpegdecomp_threads[i] != NULL);
+    }
 }
 
 void jpeg_decoder_deinit()
 {
     int thread_status;
-    jpeg_decoder_running = 0;      // This will make decomp thread quit on next run
-    SDL_SemPost(jpegdecomp_queue); // Force thread run.
-    SDL_WaitThread(jpegdecomp_thread, &thread_status);
+    jpeg_decoder_running = 0; // This will make decomp threads quit on next run
+    for (int i = 0; i < JPEG_DECODER_THREADS; i++)
+    {
+        SDL_SemPost(jpegdecomp_queue); // Force thread run.
+    }
+    for (int i = 0; i < JPEG_DECODER_THREADS; i++)
+    {
+        SDL_WaitThread(jpegdecomp_threads[i], &thread_status);
+    }
     SDL_DestroyMutex(jpegdecomp_qmutex);
     SDL_DestroySemaphore(jpegdecomp_queue);
 }
 
-void *jpeg_decoder_queue(const char *fn, jpg_complete_cb_t complete_cb, void *user_data)
+void *jpeg_decoder_queue(const char *fn, jpg_complete_cb_t complete_cb, void *user_data, int priority)
 {
 
     jpeg_t *jpeg = NULL;
@@ -258,18 +633,12 @@ void *jpeg_decoder_queue(const char *fn, jpg_complete_cb_t complete_cb, void *us
     strncpy(jpeg->fn, fn, sizeof(jpeg->fn) - 1);
     jpeg->user_data = user_data;
     jpeg->complete_cb = complete_cb;
+    jpeg->priority = priority;
     SDL_AtomicSet(&jpeg->state, STATE_DECOMP_QUEUED);
 
     SDL_LockMutex(jpegdecomp_qmutex);
-    if (jpegdecomp_qhead == NULL)
-    {
-        jpegdecomp_qhead = jpeg;
-    }
-    else
-    {
-        jpeg->next = jpegdecomp_qhead;
-        jpegdecomp_qhead = jpeg;
-    }
+    jpeg->sequence = jpegdecomp_sequence++;
+    heap_push(jpeg);
     SDL_UnlockMutex(jpegdecomp_qmutex);
     SDL_SemPost(jpegdecomp_queue);
 
@@ -280,9 +649,62 @@ void jpeg_decoder_abort(void *handle)
 {
     SDL_LockMutex(jpegdecomp_qmutex);
     jpeg_t *jpeg = (jpeg_t *)handle;
-    if (jpeg)
+    if (jpeg && SDL_AtomicCAS(&jpeg->state, STATE_DECOMP_QUEUED, STATE_DECOMP_ABORTED))
+    {
+        // Not started yet, it can go straight back in the pool. A running job notices at its next iMCU row
+        if (jpeg->heap_index >= 0)
+        {
+            heap_remove(jpeg);
+            jpeg_release(jpeg);
+        }
+    }
+    SDL_UnlockMutex(jpegdecomp_qmutex);
+}
+
+void jpeg_decoder_set_priority(void *handle, int priority)
+{
+    SDL_LockMutex(jpegdecomp_qmutex);
+    jpeg_t *jpeg = (jpeg_t *)handle;
+    // Only jobs still waiting for a worker can be reordered
+    if (jpeg && jpeg->heap_index >= 0 && jpeg->priority != priority)
     {
-        SDL_AtomicCAS(&jpeg->state, STATE_DECOMP_QUEUED, STATE_DECOMP_ABORTED);
+        int raised = priority > jpeg->priority;
+        jpeg->priority = priority;
+        if (raised)
+        {
+            heap_sift_up(jpeg->heap_index);
+        }
+        else
+        {
+            heap_sift_down(jpeg->heap_index);
+        }
     }
     SDL_UnlockMutex(jpegdecomp_qmutex);
 }
+
+void jpeg_decoder_set_width(int width)
+{
+    jpeg_output_width = width;
+}
+
+void jpeg_decoder_set_cache(jpg_cache_load_cb_t load_cb, jpg_cache_store_cb_t store_cb)
+{
+    jpeg_cache_load = load_cb;
+    jpeg_cache_store = store_cb;
+}
+
+void jpeg_decoder_set_target(jpg_target_alloc_cb_t alloc_cb, jpg_target_free_cb_t free_cb)
+{
+    jpeg_target_alloc = alloc_cb;
+    jpeg_target_free = free_cb;
+}
+
+void *jpeg_decoder_decode(const char *fn, void **mem, int *w, int *h)
+{
+    jpeg_decoder_ctx_t ctx;
+    decoder_ctx_init(&ctx);
+    int pitch;
+    void *image = decode_file(&ctx, fn, NULL, 0, mem, w, h, &pitch);
+    jpeg_destroy_decompress(&ctx.jinfo);
+    return image;
+}
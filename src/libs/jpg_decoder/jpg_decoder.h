@@ -12,9 +12,25 @@ extern "C" {
 #define JPEG_DECODER_QUEUE_SIZE 64
 #endif
 
-//jpg Decompression compelte cb. Buffer must be freed with free() when complete.
+#ifndef JPEG_DECODER_THREADS
+#define JPEG_DECODER_THREADS 2
+#endif
+
+//jpg Decompression compelte cb. Buffer must be freed with free() when complete. img is NULL if the job failed.
+//If mem is NULL and img is not, img was allocated from the decode target and belongs to the callback.
 typedef void (*jpg_complete_cb_t)(void *img, void *mem, int w, int h, void *user_data);
 
+//Optional cache of decompressed images. load returns non-zero and fills img, mem, w and h on a hit.
+//store is given the row size of img in bytes as pitch. Both are called from thread context.
+typedef int (*jpg_cache_load_cb_t)(const char *fn, void **img, void **mem, int *w, int *h);
+typedef void (*jpg_cache_store_cb_t)(const char *fn, const void *img, int w, int h, int pitch);
+
+//Optional memory for queued jobs to decompress into. alloc returns memory for w pixel wide rows, with the row size
+//in bytes in pitch. It can lower h if it holds fewer rows, the image is cropped to fit. Returns NULL to fall back
+//to malloc(). Both are called from thread context.
+typedef void *(*jpg_target_alloc_cb_t)(int w, int *h, int *pitch);
+typedef void (*jpg_target_free_cb_t)(void *img);
+
 /**
  * @brief Initialise the jpeg_decoder library. Must be called before use.
  * @param colour_depth 16 or 32 for RGB565 or RGBA8888 output.
@@ -24,6 +40,37 @@ typedef void (*jpg_complete_cb_t)(void *img, void *mem, int w, int h, void *user
  */
 void jpeg_decoder_init(int colour_depth, int max_dimension);
 
+/**
+ * @brief Scale all output images to exactly this width, maintaining the aspect ratio. This overrides max_dimension.
+ * @param width The output width, or 0 to go back to using max_dimension.
+ */
+void jpeg_decoder_set_width(int width);
+
+/**
+ * @brief Set a cache that is checked before decompressing a file, and given each newly decompressed image.
+ * @param load_cb Called before decompressing. Can be NULL.
+ * @param store_cb Called after decompressing. Can be NULL.
+ */
+void jpeg_decoder_set_cache(jpg_cache_load_cb_t load_cb, jpg_cache_store_cb_t store_cb);
+
+/**
+ * @brief Set memory that queued jobs decompress straight into, such as texture memory. The final pass of the
+ * decode writes into it so the image never needs copying. Only used when a width is set with jpeg_decoder_set_width().
+ * @param alloc_cb Allocate the image. Can be NULL to always use malloc().
+ * @param free_cb Free an image from alloc_cb if the job is aborted.
+ */
+void jpeg_decoder_set_target(jpg_target_alloc_cb_t alloc_cb, jpg_target_free_cb_t free_cb);
+
+/**
+ * @brief Decompress a jpeg file synchronously in the calling thread.
+ * @param fn The filename of the jpeg file.
+ * @param mem Set to the allocation that must be freed with free().
+ * @param w Set to the width of the image.
+ * @param h Set to the height of the image.
+ * @return The decompressed image, or NULL on error.
+ */
+void *jpeg_decoder_decode(const char *fn, void **mem, int *w, int *h);
+
 /**
  * @brief Deinitialise the jpeg_decoder library
  */
@@ -34,12 +81,22 @@ void jpeg_decoder_deinit();
  * @param fn The filename of the jpeg file.
  * @param complete_cb The callback function which is called when decompression is complete. Note this is called from thread context.
  * @param user_data A user defined variable that is returned with the complete_cb.
+ * @param priority Jobs with a higher priority are decompressed first.
  * @return A handle for the jpeg job, or NULL on error.
  */
-void *jpeg_decoder_queue(const char *fn, jpg_complete_cb_t complete_cb, void *user_data);
+void *jpeg_decoder_queue(const char *fn, jpg_complete_cb_t complete_cb, void *user_data, int priority);
+
+/**
+ * @brief Change the priority of a queued decompression job.
+ * @param handle The handle returned by jpeg_decoder_queue(). If the job has started, this has no effect.
+ * @param priority The new priority.
+ */
+void jpeg_decoder_set_priority(void *handle, int priority);
 
 /**
- * @brief Abort a previously queued decompression job.
+ * @brief Abort a previously queued decompression job. A job waiting in the queue is removed straight away,
+ * a running job stops at its next iMCU row. The complete_cb is not called for an aborted job unless it was
+ * already being called.
  * @param handle The handle returned by jpeg_decoder_queue(). If the job is finished, this has no effect.
  */
 void jpeg_decoder_abort(void *handle);
@@ -402,7 +402,9 @@ static sxmlerr_t parse_start (sxml_t* state, sxml_args_t* args)
 	if (space == end)
 		return SXML_ERROR_BUFFERDRY;
 
-	state_pushtoken (state, args, SXML_STARTTAG, name, space);
+	/* parse_attributes() writes the size of the start tag token, so it must have fitted */
+	if (!state_pushtoken (state, args, SXML_STARTTAG, name, space))
+		return SXML_ERROR_TOKENSFULL;
 
 	state_setpos (state, args, space);
 	err= parse_attributes (state, args);
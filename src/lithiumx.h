@@ -31,6 +31,10 @@ int strcasecmp(const char *s1, const char *s2);
 #include "dash_settings.h"
 #include "dash_styles.h"
 #include "dash_synop.h"
+#include "dash_search.h"
+#include "dash_thumbnail.h"
+#include "dash_xml.h"
+#include "dash_atlas.h"
 #include "dash_browser.h"
 #include "dash_launcher.h"
 #include "dash_debug.h"
@@ -77,6 +81,30 @@ int strcasecmp(const char *s1, const char *s2);
 #endif
 #endif
 
+#ifndef DASH_THUMBNAIL_CACHE_PATH
+#ifdef NXDK
+#define DASH_THUMBNAIL_CACHE_PATH "E:\\UDATA\\LithiumX\\thumbs"
+#else
+#define DASH_THUMBNAIL_CACHE_PATH "thumbs"
+#endif
+#endif
+
+#ifndef DASH_MEM_PROFILE_PATH
+#ifdef NXDK
+#define DASH_MEM_PROFILE_PATH "E:\\UDATA\\LithiumX\\memprofile.txt"
+#else
+#define DASH_MEM_PROFILE_PATH "memprofile.txt"
+#endif
+#endif
+
+#ifndef DASH_FRAME_TRACE_PATH
+#define DASH_FRAME_TRACE_PATH "frametrace.json"
+#endif
+
+#ifndef DASH_LOCK_TRACE_PATH
+#define DASH_LOCK_TRACE_PATH "locktrace.txt"
+#endif
+
 #ifndef DASH_ROOT_PATH
 #ifdef NXDK
 #define DASH_ROOT_PATH ""
@@ -105,6 +133,98 @@ int strcasecmp(const char *s1, const char *s2);
 #define DASH_MAX_PATHLEN 256 //Per page
 #endif
 
+#ifndef DASH_SCAN_THREADS
+#define DASH_SCAN_THREADS 4 //Number of worker threads used to scan folders during a database rebuild
+#endif
+
+#ifndef DASH_XML_CHUNK_SIZE
+#define DASH_XML_CHUNK_SIZE 1024 //Size of the buffer metadata xml files are streamed through. Must fit the largest tag
+#endif
+
+#ifndef DASH_XML_TOKENS
+#define DASH_XML_TOKENS 32 //Number of sxml tokens parsed per batch. Must fit the largest tag, 1 plus 2 per attribute
+#endif
+
+#ifndef DASH_SEARCH_MAX_RESULTS
+#define DASH_SEARCH_MAX_RESULTS 50 //Number of matches shown in the search window
+#endif
+
+#ifndef DASH_SCROLLER_PREFETCH_ROWS
+#define DASH_SCROLLER_PREFETCH_ROWS 2 //Rows of tiles kept alive above and below the visible rows of a page
+#endif
+
+#ifndef DASH_SCROLLER_PREFETCH_LOOKAHEAD_MS
+#define DASH_SCROLLER_PREFETCH_LOOKAHEAD_MS 500 //How far ahead the navigation speed is projected to pick thumbnails to prefetch
+#endif
+
+#ifndef DASH_THUMBNAIL_CACHE_RAM_DIVISOR
+#define DASH_THUMBNAIL_CACHE_RAM_DIVISOR 4 //Decompressed thumbnails can use this fraction of the RAM that is free at boot
+#endif
+
+#ifndef DASH_THUMBNAIL_CACHE_MIN
+#define DASH_THUMBNAIL_CACHE_MIN (4 * 1024 * 1024)
+#endif
+
+#ifndef DASH_THUMBNAIL_CACHE_MAX
+#define DASH_THUMBNAIL_CACHE_MAX (64 * 1024 * 1024)
+#endif
+
+#ifndef DASH_ATLAS_PAGE_SLOTS
+#define DASH_ATLAS_PAGE_SLOTS 16 //Thumbnails packed into each atlas page. At most 32
+#endif
+
+#ifndef DASH_ATLAS_POT_LAYOUT
+#ifdef NXDK
+#define DASH_ATLAS_POT_LAYOUT 1 //Pad atlas pages to power of two textures that the gpu reads in place
+#else
+#define DASH_ATLAS_POT_LAYOUT 0
+#endif
+#endif
+
+#ifndef DASH_ATLAS_MAX_PAGE_HEIGHT
+#define DASH_ATLAS_MAX_PAGE_HEIGHT 4096 //Tallest texture the gpu can use. Atlas pages hold fewer thumbnails to fit
+#endif
+
+#ifndef DASH_MEM_CACHE_MAX_SIZE
+#define DASH_MEM_CACHE_MAX_SIZE 256 //Allocations up to this size are served from a per thread cache in front of the gui heap
+#endif
+
+#ifndef DASH_MEM_CACHE_DEPTH
+#define DASH_MEM_CACHE_DEPTH 32 //Free blocks each thread keeps per size class. Half are returned when it fills
+#endif
+
+#ifndef DASH_MEM_CACHE_FLUSH_OPS
+#define DASH_MEM_CACHE_FLUSH_OPS 4096 //A thread returns half of its cached blocks after this many allocations
+#endif
+
+#ifndef DASH_MEM_POOL_GROW_SIZE
+#define DASH_MEM_POOL_GROW_SIZE (1024 * 1024) //The gui heap grows by at least this much when it runs out
+#endif
+
+#ifndef DASH_MEM_POOL_RAM_DIVISOR
+#define DASH_MEM_POOL_RAM_DIVISOR 8 //On Xbox the gui heap can grow to this fraction of total RAM. Other platforms are unlimited
+#endif
+
+#ifndef DASH_MEM_LOW_WATERMARK
+#define DASH_MEM_LOW_WATERMARK 90 //Percent of the gui heap budget in use before caches are asked to free memory
+#endif
+
+#ifndef DASH_FRAME_HISTORY
+#define DASH_FRAME_HISTORY 512 //Number of frames of timing kept for the debug overlay and trace export
+#endif
+
+#ifndef DASH_LOCK_TRACE_SITES
+#define DASH_LOCK_TRACE_SITES 32 //Number of places that take the lvgl lock that are traced separately
+#endif
+
+#ifndef DASH_MEM_PROFILE
+#define DASH_MEM_PROFILE 0 //Track gui heap usage by tag. Adds a 16 byte header to every allocation
+#endif
+
+#ifndef DASH_MEM_PROFILE_TAGS
+#define DASH_MEM_PROFILE_TAGS 16 //Number of different tags that can be tracked
+#endif
+
 #ifndef DASH_THUMBNAIL_WIDTH
 #define DASH_THUMBNAIL_WIDTH ((lv_obj_get_width(lv_scr_act()) - (2 * DASH_XMARGIN)) / dash_settings.items_per_row)
 #endif
@@ -132,37 +252,65 @@ int strcasecmp(const char *s1, const char *s2);
 #define DASH_PREV_PAGE '<'
 #define DASH_SETTINGS_PAGE 's'
 #define DASH_INFO_PAGE 'i'
-
-// There is one 'parser' per 'tile'. The parser asynchronously parses all the path set my the xml and adds
-// eatch item. Each parser contains a image scrolling container 'scroller' to show all the game art etc.
-// Each 'tile' is a child of a tileview object 'pagetiles'. These are swiped left and right to change page.
-typedef struct
-{
-    char page_title[32];
-    void *db_scan_thread;
-    lv_obj_t *tile;     // The tile in the tileview parent 'pagetiles'
-    lv_obj_t *scroller; // The scroller contains image containers for each item
-} parse_handle_t;
+#define DASH_SEARCH_PAGE 'f'
 
 typedef struct
 {
     char *thumb_path;
-    lv_obj_t *canvas;
     void *decomp_handle;
-    void *mem; //Memory is the allocated block from malloc
-    void *image; //image is the decompressed image with mem (this may be byte aligned etc)
+    void *image; //image is the decompressed image. It is stored in a dash_atlas slot
     int w;
     int h;
     bool prevent_abort;
+    void *cache_node; //This title's entry in the thumbnail cache while image is set
 } jpg_info_t;
 
+// One per title on a page. Only the titles in view are bound to a tile object
 typedef struct
 {
     int db_id;
-    char title[MAX_META_LEN];
+    char *title;
+    lv_obj_t *tile; // The tile currently showing this title, NULL if scrolled out of view
     jpg_info_t *jpg_info;
+    int page;       // Index of the page in parsers[] the title is on
+    lv_coord_t label_h; // Height of the wrapped title text. Measured the first time it is shown, 0 until then
 } title_t;
 
+// Open addressing table from db_id to title, so rows from the database find their title without searching a page
+typedef struct
+{
+    title_t **slots;
+    uint32_t mask;
+    uint32_t used; // Slots holding a title or a removed marker
+} title_map_t;
+
+// There is one 'parser' per 'tile'. The parser asynchronously reads the page's titles from the database.
+// Each parser contains a image scrolling container 'scroller' to show all the game art etc.
+// Each 'tile' is a child of a tileview object 'pagetiles'. These are swiped left and right to change page.
+// The scroller only has enough tile objects for the visible rows plus DASH_SCROLLER_PREFETCH_ROWS
+// above and below. They are rebound to titles as the page scrolls.
+typedef struct
+{
+    char page_title[32];
+    void *db_scan_thread;
+    lv_obj_t *tile;     // The tile in the tileview parent 'pagetiles'
+    lv_obj_t *scroller; // The scroller contains the pool of tiles and the null item
+    lv_obj_t *spacer;   // Invisible object sized to all rows so the scroller scrolls the full page
+    lv_obj_t **pool;    // Tile objects, the title at position n is shown by pool[n % pool_cnt]
+    int pool_cnt;
+    int columns;
+    int current_index;  // 0 is the null item, 1 to title_cnt are the titles
+    title_t **titles;   // Titles in display order
+    int title_cnt;
+    int title_alloc;
+    title_map_t title_map; // The page's titles by db_id
+    bool refresh_pending;  // Titles changed during a background rebuild. Refreshed at the end of its batch
+    bool scanning;         // Still adding the titles it read from the database
+    int *removed_ids;      // Titles a rebuild removed before the page read them. Skipped if the read returns them
+    int removed_cnt;
+    int removed_alloc;
+} parse_handle_t;
+
 #ifndef NANO_DEBUG_LEVEL
 #define NANO_DEBUG_LEVEL LEVEL_WARN
 #endif
@@ -180,13 +328,66 @@ void dash_printf(dash_debug_level_t level, const char *format, ...);
 void dash_init(void);
 void dash_create();
 void dash_deinit(void);
-void lvgl_getlock(void);
+bool dash_rescan_start(void);
+bool dash_rescan_running(void);
+void lvgl_getlock_at(const char *func, int line);
 void lvgl_removelock(void);
+
+// The call site is recorded so time spent waiting for the lock can be traced back to whoever was holding it
+#define lvgl_getlock() lvgl_getlock_at(__func__, __LINE__)
+
+#define LVGL_LOCK_HIST_BUCKETS 8 // Hold times <0.1, <0.5, <1, <2, <5, <10, <20 and >=20ms
+
+typedef struct
+{
+    const char *func;
+    int line;
+    SDL_threadID thread;  // Last thread to take the lock from here
+    uint32_t count;
+    uint32_t contended;   // Times the lock was already held by another thread
+    uint32_t max_waiters; // Most threads waiting at once, including this one
+    uint64_t wait_us;
+    uint32_t max_wait_us;
+    uint64_t hold_us;
+    uint32_t max_hold_us;
+    uint64_t blocking_us; // Time other threads spent waiting for the lock to be released from here
+    uint32_t hold_hist[LVGL_LOCK_HIST_BUCKETS];
+} lvgl_lock_stats_t;
+
+int lvgl_lock_get_stats(lvgl_lock_stats_t *stats, int max);
+void lvgl_lock_dump(const char *path);
+void lx_mem_init(void);
 void *lx_mem_alloc(size_t size);
 void *lx_mem_realloc(void *data, size_t new_size);
 void lx_mem_free(void *data);
 void lx_mem_usage(uint32_t *used, uint32_t *capacity);
 
+typedef struct
+{
+    const char *name;
+    size_t live_bytes;
+    uint32_t live_count;
+} lx_mem_tag_stats_t;
+
+typedef struct
+{
+    size_t used_bytes;
+    size_t peak_bytes;
+    size_t free_bytes;
+    size_t largest_free;
+    uint32_t fragmentation; // Percent of free memory outside the largest free block
+    int tag_cnt;            // Only set with DASH_MEM_PROFILE
+    lx_mem_tag_stats_t tags[DASH_MEM_PROFILE_TAGS];
+} lx_mem_profile_t;
+
+// Called from any thread when the gui heap is nearly full. It must not block, lock lvgl or allocate
+typedef void (*lx_mem_low_cb_t)(void);
+
+void lx_mem_add_low_memory_cb(lx_mem_low_cb_t cb);
+const char *lx_mem_set_tag(const char *tag);
+void lx_mem_get_profile(lx_mem_profile_t *profile);
+void lx_mem_dump_profile(const char *path);
+
 void dash_focus_set_final(lv_obj_t *focus);
 void dash_focus_change_depth(lv_obj_t *new_focus);
 lv_obj_t *dash_focus_pop_depth();
@@ -35,12 +35,13 @@ static void begin_frame()
     pb_end(p);
 }
 
-void lvgl_getlock(void);
-void lvgl_removelock(void);
+void lx_mem_add_low_memory_cb(void (*cb)(void));
 
 static void disp_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
 {
     end_frame();
+    // The previous frame is finished with its textures, so they can be freed if memory is low
+    lv_draw_xgu_trim(disp_drv->draw_ctx);
     begin_frame();
     lv_disp_flush_ready(disp_drv);
 }
@@ -65,6 +66,7 @@ void lv_port_disp_init(int width, int height)
     lv_draw_xgu_data_t *data = lv_mem_alloc(sizeof(lv_draw_xgu_data_t));
     disp_drv.user_data = data;
     lv_disp_drv_register(&disp_drv);
+    lx_mem_add_low_memory_cb(lv_draw_xgu_request_trim);
 
     if (LV_COLOR_DEPTH == 16)
     {
@@ -9,10 +9,16 @@
 #include <xboxkrnl/xboxkrnl.h>
 
 int lv_texture_cache_size = 16 * 1024 * 1024;
+lv_draw_xgu_atlas_lookup_t lv_xgu_atlas_lookup;
+static volatile bool lv_xgu_trim_requested;
 
 static void cache_free(draw_cache_value_t *texture)
 {
-    MmFreeContiguousMemory(texture->texture);
+    if (texture->external == false)
+    {
+        MmFreeContiguousMemory(texture->texture);
+    }
+    lv_mem_free(texture->atlas_generation);
     lv_mem_free(texture);
 }
 
@@ -47,6 +53,40 @@ void lv_draw_xgu_init_ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
     xgu_ctx->xgu_data->texture_cache = lv_lru_create(lv_texture_cache_size, 65536, (lv_lru_free_t *)cache_free, NULL);
 }
 
+void lv_draw_xgu_set_atlas_lookup(lv_draw_xgu_atlas_lookup_t lookup)
+{
+    lv_xgu_atlas_lookup = lookup;
+}
+
+// Ask for the texture cache to be trimmed on the next frame. Safe to call from any thread
+void lv_draw_xgu_request_trim(void)
+{
+    lv_xgu_trim_requested = true;
+}
+
+// Free the least recently used half of the texture cache if a trim was requested. Call from the gui thread
+void lv_draw_xgu_trim(lv_draw_ctx_t *draw_ctx)
+{
+    if (lv_xgu_trim_requested == false)
+    {
+        return;
+    }
+    lv_xgu_trim_requested = false;
+
+    lv_lru_t *cache = ((lv_draw_xgu_ctx_t *)draw_ctx)->xgu_data->texture_cache;
+    size_t target = cache->free_memory + (cache->total_memory - cache->free_memory) / 2;
+    while (cache->free_memory < target)
+    {
+        size_t free_memory = cache->free_memory;
+        lv_lru_remove_lru_item(cache);
+        if (cache->free_memory == free_memory)
+        {
+            break;
+        }
+    }
+    ((lv_draw_xgu_ctx_t *)draw_ctx)->xgu_data->current_tex = 0;
+}
+
 void lv_draw_xgu_deinit_ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
 {
     LV_UNUSED(drv);
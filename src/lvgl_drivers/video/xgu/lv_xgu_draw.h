@@ -34,8 +34,27 @@ typedef struct
     uint32_t ih;
     XguTexFormatColor format;
     uint32_t bytes_pp;
+    uint32_t *atlas_generation; // For atlas pages, the generation of each slot when it was copied in. Otherwise NULL
+    bool external;              // The texture memory belongs to someone else and isn't freed with the texture
 } draw_cache_value_t;
 
+// Images can be packed into a shared atlas page. The whole page is uploaded as one texture and each image is
+// drawn as a sub-rectangle of it.
+typedef struct
+{
+    void *page;
+    uint32_t page_w;
+    uint32_t page_h;
+    uint32_t slot;
+    uint32_t slots;
+    uint32_t y;          // First row of the image within the page
+    uint32_t generation; // Changes whenever the slot holds a new image
+    bool direct;         // The page is contiguous, power of two sized texture memory that can be bound as is
+} lv_draw_xgu_atlas_region_t;
+
+// Returns true and fills region if buf is inside an atlas page
+typedef bool (*lv_draw_xgu_atlas_lookup_t)(const void *buf, lv_draw_xgu_atlas_region_t *region);
+
 /**********************
  * GLOBAL PROTOTYPES
  **********************/
@@ -61,6 +80,9 @@ static inline int npot2pot(int num)
 
 void lv_draw_xgu_init_ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
 void lv_draw_xgu_deinit_ctx(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+void lv_draw_xgu_set_atlas_lookup(lv_draw_xgu_atlas_lookup_t lookup);
+void lv_draw_xgu_request_trim(void);
+void lv_draw_xgu_trim(lv_draw_ctx_t *draw_ctx);
 
 //Rect types
 void xgu_draw_rect(struct _lv_draw_ctx_t *draw_ctx, const lv_draw_rect_dsc_t *dsc, const lv_area_t *coords);
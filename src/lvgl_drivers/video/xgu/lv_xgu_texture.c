@@ -7,6 +7,7 @@
 #include "src/misc/lv_lru.h"
 
 extern uint32_t *p;
+extern lv_draw_xgu_atlas_lookup_t lv_xgu_atlas_lookup;
 
 static const uint8_t _lv_bpp1_opa_table[2] = {0, 255};          /*Opacity mapping with bpp = 1 (Just for compatibility)*/
 
@@ -114,6 +115,8 @@ static void *create_texture(lv_draw_xgu_ctx_t *xgu_ctx, const uint8_t *src_buf,
     texture->th = th;
     texture->format = fmt;
     texture->bytes_pp = bytes_pp;
+    texture->atlas_generation = NULL;
+    texture->external = false;
     lv_lru_set(xgu_ctx->xgu_data->texture_cache, &key, sizeof(key), texture, (sz + (PAGE_SIZE - 1)) & -PAGE_SIZE);
 
     uint8_t *dst_buf = (uint8_t *)MmAllocateContiguousMemoryEx(sz, 0, 0xFFFFFFFF, 0,
@@ -126,6 +129,12 @@ static void *create_texture(lv_draw_xgu_ctx_t *xgu_ctx, const uint8_t *src_buf,
     }
     texture->texture = dst_buf;
 
+    // Atlas pages are filled in a slot at a time as they are drawn
+    if (src_buf == NULL)
+    {
+        return texture;
+    }
+
     uint32_t dst_px = 0, src_px = 0;
     for (int y = 0; y < ih; y++)
     {
@@ -137,15 +146,39 @@ static void *create_texture(lv_draw_xgu_ctx_t *xgu_ctx, const uint8_t *src_buf,
     return texture;
 }
 
-static void map_textured_rect(draw_cache_value_t *texture, const lv_area_t *tex_area,
+// Use memory that is already laid out as a texture, such as an atlas page the jpeg decoder writes into.
+// Nothing is copied and the memory isn't freed when the texture is evicted.
+static void *wrap_texture(lv_draw_xgu_ctx_t *xgu_ctx, void *buf, uint32_t tw, uint32_t th, XguTexFormatColor fmt,
+                          uint32_t bytes_pp, uint32_t key)
+{
+    draw_cache_value_t *texture = lv_mem_alloc(sizeof(draw_cache_value_t));
+    if (texture == NULL)
+    {
+        return NULL;
+    }
+    texture->texture = buf;
+    texture->iw = tw;
+    texture->ih = th;
+    texture->tw = tw;
+    texture->th = th;
+    texture->format = fmt;
+    texture->bytes_pp = bytes_pp;
+    texture->atlas_generation = NULL;
+    texture->external = true;
+    lv_lru_set(xgu_ctx->xgu_data->texture_cache, &key, sizeof(key), texture, sizeof(draw_cache_value_t));
+    return texture;
+}
+
+// Map the image at (x, y) with size iw x ih within the texture onto the draw area
+static void map_textured_rect(float x, float y, float iw, float ih, const lv_area_t *tex_area,
                               lv_area_t *draw_area, float zoom)
 {
     float zm, s0, s1, t0, t1;
     zm = zoom / 256.0f;
-    s0 = (float)(draw_area->x1 - tex_area->x1) / zm;
-    s1 = texture->iw - ((float)(tex_area->x2 - draw_area->x2) / zm);
-    t0 = (float)(draw_area->y1 - tex_area->y1) / zm;
-    t1 = texture->ih - ((float)(tex_area->y2 - draw_area->y2) / zm);
+    s0 = x + (float)(draw_area->x1 - tex_area->x1) / zm;
+    s1 = x + iw - ((float)(tex_area->x2 - draw_area->x2) / zm);
+    t0 = y + (float)(draw_area->y1 - tex_area->y1) / zm;
+    t1 = y + ih - ((float)(tex_area->y2 - draw_area->y2) / zm);
 
     p = xgu_begin(p, XGU_TRIANGLE_STRIP);
 
@@ -236,7 +269,7 @@ void xgu_draw_letter(struct _lv_draw_ctx_t *draw_ctx, const lv_draw_label_dsc_t
 
     bind_texture(xgu_ctx, texture, (uint32_t)bmp, XGU_TEXTURE_FILTER_LINEAR);
 
-    map_textured_rect(texture, &letter_area, &draw_area, 256.0f);
+    map_textured_rect(0, 0, texture->iw, texture->ih, &letter_area, &draw_area, 256.0f);
     pb_end(p);
 }
 
@@ -272,6 +305,42 @@ lv_res_t xgu_draw_img(struct _lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc_t *
     return LV_RES_OK;
 }
 
+static bool texture_format(lv_img_cf_t cf, XguTexFormatColor *xgu_cf, uint8_t *bytes_pp)
+{
+    switch (cf)
+    {
+    case LV_IMG_CF_TRUE_COLOR:
+        *xgu_cf = (sizeof(lv_color_t) == 2) ?
+            XGU_TEXTURE_FORMAT_R5G6B5 : XGU_TEXTURE_FORMAT_A8R8G8B8;
+        *bytes_pp = sizeof(lv_color_t);
+        break;
+    case LV_IMG_CF_TRUE_COLOR_ALPHA:
+        if (sizeof(lv_color_t) == 2) return false;
+        *xgu_cf = XGU_TEXTURE_FORMAT_A8R8G8B8;
+        *bytes_pp = sizeof(lv_color_t);
+    case LV_IMG_CF_RGB888:
+        *xgu_cf = XGU_TEXTURE_FORMAT_X8R8G8B8;
+        *bytes_pp = 4;
+        break;
+    case LV_IMG_CF_RGBA8888:
+    case LV_IMG_CF_RGBX8888:
+        *xgu_cf = XGU_TEXTURE_FORMAT_R8G8B8A8;
+        *bytes_pp = 4;
+        break;
+    case LV_IMG_CF_RGB565:
+        *xgu_cf = XGU_TEXTURE_FORMAT_R5G6B5;
+        *bytes_pp = 2;
+        break;
+    case LV_IMG_CF_INDEXED_1BIT:
+        *xgu_cf = XGU_TEXTURE_FORMAT_A8;
+        *bytes_pp = 1;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
 void draw_rect_simple(const lv_area_t *draw_area);
 void xgu_draw_img_decoded(struct _lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc_t *dsc,
                           const lv_area_t *src_area, const uint8_t *src_buf, lv_img_cf_t cf)
@@ -317,66 +386,90 @@ void xgu_draw_img_decoded(struct _lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc
         recolor.ch.blue = c1->ch.blue;
     }
 
-    // Create a checksum of some initial data to create a unique key for the texture cache
-    uint32_t key = 0;
-    uint32_t max = (lv_area_get_width(src_area) *
-               lv_area_get_height(src_area) * sizeof(lv_color_t)) / 4;
-    uint32_t *_src = (uint32_t *)src_buf;
-    int i = 0, end = LV_MIN(i + 16, max);
-    while (i < end) key += _src[i++];
-    i = max / 2; end = LV_MIN(i + 16, max);
-    while (i < end) key += _src[i++];
     if (xgu_ctx->xgu_data->combiner_mode != 1)
     {
         #include "lvgl_drivers/video/xgu/texture.inl"
         xgu_ctx->xgu_data->combiner_mode = 1;
     }
 
-    lv_lru_get(xgu_ctx->xgu_data->texture_cache, &key, sizeof(key), (void **)&texture);
+    XguTexFormatColor xgu_cf;
+    uint8_t bytes_pp;
+    if (texture_format(cf, &xgu_cf, &bytes_pp) == false)
+    {
+        DbgPrint("Unsupported texture format %d\n", cf);
+        pb_end(p);
+        return;
+    }
+
+    // Images in an atlas page share the page's texture. If the page is already texture memory it is bound as is,
+    // otherwise only slots that have changed since they were last drawn are copied in.
+    lv_draw_xgu_atlas_region_t region;
+    uint32_t key = 0;
+    uint32_t iw = lv_area_get_width(src_area);
+    uint32_t ih = lv_area_get_height(src_area);
+    uint32_t ty = 0;
+    if (cf != LV_IMG_CF_INDEXED_1BIT && lv_xgu_atlas_lookup && lv_xgu_atlas_lookup(src_buf, &region))
+    {
+        key = (uint32_t)region.page;
+        lv_lru_get(xgu_ctx->xgu_data->texture_cache, &key, sizeof(key), (void **)&texture);
+        if (texture == NULL && region.direct)
+        {
+            texture = wrap_texture(xgu_ctx, region.page, region.page_w, region.page_h, xgu_cf, bytes_pp, key);
+            if (texture == NULL)
+            {
+                pb_end(p);
+                return;
+            }
+        }
+        else if (texture == NULL)
+        {
+            lv_area_t page_area = {0, 0, region.page_w - 1, region.page_h - 1};
+            texture = create_texture(xgu_ctx, NULL, &page_area, xgu_cf, bytes_pp, key);
+            if (texture == NULL)
+            {
+                pb_end(p);
+                return;
+            }
+            texture->atlas_generation = lv_mem_alloc(region.slots * sizeof(uint32_t));
+            lv_memset_00(texture->atlas_generation, region.slots * sizeof(uint32_t));
+        }
+
+        if (texture->atlas_generation && texture->atlas_generation[region.slot] != region.generation)
+        {
+            uint8_t *dst_buf = (uint8_t *)texture->texture + region.y * texture->tw * bytes_pp;
+            for (int y = 0; y < ih; y++)
+            {
+                lv_memcpy(&dst_buf[y * texture->tw * bytes_pp], &src_buf[y * iw * bytes_pp], iw * bytes_pp);
+            }
+            texture->atlas_generation[region.slot] = region.generation;
+        }
+        ty = region.y;
+    }
+    else
+    {
+        // Create a checksum of some initial data to create a unique key for the texture cache
+        uint32_t max = (iw * ih * sizeof(lv_color_t)) / 4;
+        uint32_t *_src = (uint32_t *)src_buf;
+        int i = 0, end = LV_MIN(i + 16, max);
+        while (i < end) key += _src[i++];
+        i = max / 2; end = LV_MIN(i + 16, max);
+        while (i < end) key += _src[i++];
+
+        lv_lru_get(xgu_ctx->xgu_data->texture_cache, &key, sizeof(key), (void **)&texture);
+    }
+
     if (texture == NULL)
     {
-        XguTexFormatColor xgu_cf;
-        uint8_t bytes_pp;
-        switch (cf)
+        if (cf == LV_IMG_CF_INDEXED_1BIT)
         {
-        case LV_IMG_CF_TRUE_COLOR:
-            xgu_cf = (sizeof(lv_color_t) == 2) ? 
-                XGU_TEXTURE_FORMAT_R5G6B5 : XGU_TEXTURE_FORMAT_A8R8G8B8;
-            bytes_pp = sizeof(lv_color_t);
-            break;
-        case LV_IMG_CF_TRUE_COLOR_ALPHA:
-            if (sizeof(lv_color_t) == 2) return;
-            xgu_cf = XGU_TEXTURE_FORMAT_A8R8G8B8;
-            bytes_pp = sizeof(lv_color_t);
-        case LV_IMG_CF_RGB888:
-            xgu_cf = XGU_TEXTURE_FORMAT_X8R8G8B8;
-            bytes_pp = 4;
-            break;
-        case LV_IMG_CF_RGBA8888:
-        case LV_IMG_CF_RGBX8888:
-            xgu_cf = XGU_TEXTURE_FORMAT_R8G8B8A8;
-            bytes_pp = 4;
-            break;
-        case LV_IMG_CF_RGB565:
-            xgu_cf = XGU_TEXTURE_FORMAT_R5G6B5;
-            bytes_pp = 2;
-            break;
-        case LV_IMG_CF_INDEXED_1BIT:
-            xgu_cf = XGU_TEXTURE_FORMAT_A8;
-            bytes_pp = 1;
-            int w = lv_area_get_width(src_area);
-            int h = lv_area_get_height(src_area);
-            void *buf = lv_mem_alloc(w * h * bytes_pp);
+            void *buf = lv_mem_alloc(iw * ih * bytes_pp);
             if (buf == NULL)
             {
+                pb_end(p);
                 return;
             }
-            amask_to_a(buf, &src_buf[8], w, h, w, bytes_pp);
+            amask_to_a(buf, &src_buf[8], iw, ih, iw, bytes_pp);
             src_buf = buf;
-            break;
-        default:
-            DbgPrint("Unsupported texture format %d\n", cf);
-            return;
         }
         texture = create_texture(xgu_ctx, src_buf, src_area, xgu_cf, bytes_pp, (uint32_t)key);
         if (cf == LV_IMG_CF_INDEXED_1BIT)
@@ -403,6 +496,6 @@ void xgu_draw_img_decoded(struct _lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc
     bind_texture(xgu_ctx, texture, (uint32_t)key,
                  (dsc->antialias) ? XGU_TEXTURE_FILTER_LINEAR : XGU_TEXTURE_FILTER_NEAREST);
 
-    map_textured_rect(texture, &src_area_transformed, &draw_area, (float)dsc->zoom);
+    map_textured_rect(0, ty, iw, ih, &src_area_transformed, &draw_area, (float)dsc->zoom);
     pb_end(p);
 }
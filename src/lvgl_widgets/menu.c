@@ -37,7 +37,7 @@ static void menu_clean(lv_event_t *event)
     lv_mem_free(menu->user_data);
 }
 
-static void main_scroll(lv_event_t *e)
+void menu_scroll_to_selected(lv_event_t *e)
 {
     lv_obj_t *obj = lv_event_get_target(e);
 
@@ -106,7 +106,7 @@ static void menu_wrap(lv_event_t *event)
             }
         }
         lv_obj_get_parent(menu)->user_data = (void *)(intptr_t)t->row_act;
-        main_scroll(event);
+        menu_scroll_to_selected(event);
     }
 }
 
@@ -148,7 +148,7 @@ static void menu_fast_scroll(lv_event_t *e)
 
     lv_obj_get_parent(obj)->user_data = (void *)(intptr_t)t->row_act;
     lv_obj_invalidate(obj);
-    main_scroll(e);
+    menu_scroll_to_selected(e);
 }
 
 lv_obj_t *menu_open(menu_items_t *menu_items, int cnt)
@@ -187,7 +187,7 @@ lv_obj_t *menu_open_static(const menu_items_t *menu_items, int cnt)
 
         lv_obj_add_event_cb(menu, menu_pressed, LV_EVENT_PRESSED, NULL);
         lv_obj_add_event_cb(menu, menu_wrap, LV_EVENT_KEY, NULL);
-        lv_obj_add_event_cb(menu, main_scroll, LV_EVENT_VALUE_CHANGED, NULL);
+        lv_obj_add_event_cb(menu, menu_scroll_to_selected, LV_EVENT_VALUE_CHANGED, NULL);
     }
     else
     {
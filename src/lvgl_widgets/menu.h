@@ -23,6 +23,7 @@ typedef struct menu_items
 lv_obj_t *menu_open(menu_items_t *menu_items, int cnt);
 lv_obj_t *menu_open_static(const menu_items_t *menu_items, int cnt);
 void menu_force_value(lv_obj_t *menu, int row);
+void menu_scroll_to_selected(lv_event_t *e);
 
 #ifdef __cplusplus
 }
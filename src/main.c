@@ -3,12 +3,20 @@
 #include <lvgl.h>
 #include "lithiumx.h"
 
-static CRITICAL_SECTION tlsf_crit_sec;
-static tlsf_t mem_pool;
-static uint8_t mem_pool_data[3U * 1024U * 1024U];
-
 static SDL_mutex *lvgl_mutex;
 
+// Lock tracing. Everything below except lock_waiters is only touched with lvgl_mutex held
+static lvgl_lock_stats_t lock_sites[DASH_LOCK_TRACE_SITES];
+static int lock_site_cnt;
+static lvgl_lock_stats_t *lock_holder;   // Site that took the lock, NULL while it's free
+static lvgl_lock_stats_t *lock_releaser; // Site that last released the lock
+static int lock_depth;
+static uint64_t lock_hold_start;
+static uint64_t lock_base_count;
+static uint64_t lock_freq;
+static SDL_atomic_t lock_waiters;
+static const uint32_t lock_hist_limits_us[LVGL_LOCK_HIST_BUCKETS - 1] = {100, 500, 1000, 2000, 5000, 10000, 20000};
+
 keyboard_map_t lvgl_keyboard_map[] =
 {
     {.sdl_map = SDLK_ESCAPE, .lvgl_map = DASH_SETTINGS_PAGE},
@@ -16,6 +24,7 @@ keyboard_map_t lvgl_keyboard_map[] =
     {.sdl_map = SDLK_RETURN, .lvgl_map = LV_KEY_ENTER},
     {.sdl_map = SDLK_PAGEDOWN, .lvgl_map = DASH_PREV_PAGE},
     {.sdl_map = SDLK_PAGEUP, .lvgl_map = DASH_NEXT_PAGE},
+    {.sdl_map = SDLK_F3, .lvgl_map = DASH_SEARCH_PAGE},
     {.sdl_map = SDLK_UP, .lvgl_map = LV_KEY_UP},
     {.sdl_map = SDLK_DOWN, .lvgl_map = LV_KEY_DOWN},
     {.sdl_map = SDLK_LEFT, .lvgl_map = LV_KEY_LEFT},
@@ -27,7 +36,7 @@ gamecontroller_map_t lvgl_gamecontroller_map[] =
 {
     {.sdl_map = SDL_CONTROLLER_BUTTON_A, .lvgl_map = LV_KEY_ENTER},
     {.sdl_map = SDL_CONTROLLER_BUTTON_B, .lvgl_map = LV_KEY_ESC},
-    {.sdl_map = SDL_CONTROLLER_BUTTON_X, .lvgl_map = LV_KEY_BACKSPACE},
+    {.sdl_map = SDL_CONTROLLER_BUTTON_X, .lvgl_map = DASH_SEARCH_PAGE},
     {.sdl_map = SDL_CONTROLLER_BUTTON_Y, .lvgl_map = DASH_INFO_PAGE},
     {.sdl_map = SDL_CONTROLLER_BUTTON_BACK, .lvgl_map = DASH_INFO_PAGE},
     {.sdl_map = SDL_CONTROLLER_BUTTON_GUIDE, .lvgl_map = 0},
@@ -43,72 +52,162 @@ gamecontroller_map_t lvgl_gamecontroller_map[] =
     {.sdl_map = 0, .lvgl_map = 0}
 };
 
+static uint64_t lock_now_us(void)
+{
+    uint64_t count = SDL_GetPerformanceCounter() - lock_base_count;
+    return count / lock_freq * 1000000 + count % lock_freq * 1000000 / lock_freq;
+}
+
+static lvgl_lock_stats_t *lock_site_get(const char *func, int line)
+{
+    for (int i = 0; i < lock_site_cnt; i++)
+    {
+        if (lock_sites[i].line == line && lock_sites[i].func == func)
+        {
+            return &lock_sites[i];
+        }
+    }
+    // Once full, new sites share the last slot
+    if (lock_site_cnt == DASH_LOCK_TRACE_SITES)
+    {
+        return &lock_sites[DASH_LOCK_TRACE_SITES - 1];
+    }
+    lvgl_lock_stats_t *site = &lock_sites[lock_site_cnt++];
+    site->func = (lock_site_cnt == DASH_LOCK_TRACE_SITES) ? "other" : func;
+    site->line = (lock_site_cnt == DASH_LOCK_TRACE_SITES) ? 0 : line;
+    return site;
+}
+
 // lvgl isn't thread safe, but we can somewhat make it
 // by wrapping task handler and any other interactions with these locks
-void lvgl_getlock(void)
+void lvgl_getlock_at(const char *func, int line)
 {
-    if (SDL_LockMutex(lvgl_mutex))
+    uint32_t wait_us = 0;
+    int waiters = 0;
+
+    // Only time the wait if someone else has it
+    if (SDL_TryLockMutex(lvgl_mutex) != 0)
     {
-        assert(0);
+        waiters = SDL_AtomicIncRef(&lock_waiters) + 1;
+        uint64_t start = lock_now_us();
+        if (SDL_LockMutex(lvgl_mutex))
+        {
+            assert(0);
+        }
+        wait_us = lock_now_us() - start;
+        SDL_AtomicAdd(&lock_waiters, -1);
+    }
+
+    // Nested locks from the same thread are counted as part of the outer one
+    if (lock_depth++ > 0)
+    {
+        return;
+    }
+
+    lvgl_lock_stats_t *site = lock_site_get(func, line);
+    site->thread = SDL_ThreadID();
+    site->count++;
+    if (waiters)
+    {
+        site->contended++;
+        site->wait_us += wait_us;
+        site->max_wait_us = LV_MAX(site->max_wait_us, wait_us);
+        site->max_waiters = LV_MAX(site->max_waiters, (uint32_t)waiters);
+        // Whoever released the lock last is the one that was holding us up
+        if (lock_releaser)
+        {
+            lock_releaser->blocking_us += wait_us;
+        }
     }
+    lock_holder = site;
+    lock_hold_start = lock_now_us();
 }
 
 void lvgl_removelock(void)
 {
+    assert(lock_depth > 0);
+    if (--lock_depth == 0)
+    {
+        lvgl_lock_stats_t *site = lock_holder;
+        uint32_t hold_us = lock_now_us() - lock_hold_start;
+        int bucket = 0;
+        while (bucket < LVGL_LOCK_HIST_BUCKETS - 1 && hold_us >= lock_hist_limits_us[bucket])
+        {
+            bucket++;
+        }
+        site->hold_us += hold_us;
+        site->max_hold_us = LV_MAX(site->max_hold_us, hold_us);
+        site->hold_hist[bucket]++;
+        lock_releaser = site;
+        lock_holder = NULL;
+    }
+
     if (SDL_UnlockMutex(lvgl_mutex))
     {
         assert(0);
     }
 }
 
-// Output handler for lvgl
-void lvgl_putstring(const char *buf)
+static int lock_stats_compare(const void *a, const void *b)
 {
-    printf("%s", buf);
+    const lvgl_lock_stats_t *sa = a;
+    const lvgl_lock_stats_t *sb = b;
+    if (sa->blocking_us != sb->blocking_us)
+    {
+        return (sa->blocking_us < sb->blocking_us) ? 1 : -1;
+    }
+    return (sa->max_hold_us < sb->max_hold_us) ? 1 : (sa->max_hold_us > sb->max_hold_us) ? -1 : 0;
 }
 
-size_t tlsf_usage = 0;
-// Replace lvgls internal allocator with basically the same thing
-// but wrapped in crit sec for thread safety.
-void *lx_mem_alloc(size_t size)
+// Copy out up to max sites, worst offenders first. Returns the number copied
+int lvgl_lock_get_stats(lvgl_lock_stats_t *stats, int max)
 {
-    EnterCriticalSection(&tlsf_crit_sec);
-    void *ptr = tlsf_malloc(mem_pool, size);
-    tlsf_usage += tlsf_block_size(ptr);
-    LeaveCriticalSection(&tlsf_crit_sec);
-    return ptr;
-}
+    static lvgl_lock_stats_t sorted[DASH_LOCK_TRACE_SITES];
 
-void *lx_mem_realloc(void *data, size_t new_size)
-{
-    EnterCriticalSection(&tlsf_crit_sec);
-    tlsf_usage -= tlsf_block_size(data);
-    void *ptr = tlsf_realloc(mem_pool, data, new_size);
-    tlsf_usage += tlsf_block_size(ptr);
-    LeaveCriticalSection(&tlsf_crit_sec);
-    return ptr;
+    lvgl_getlock();
+    int cnt = lock_site_cnt;
+    lv_memcpy(sorted, lock_sites, sizeof(lvgl_lock_stats_t) * cnt);
+    qsort(sorted, cnt, sizeof(lvgl_lock_stats_t), lock_stats_compare);
+    cnt = LV_MIN(cnt, max);
+    lv_memcpy(stats, sorted, sizeof(lvgl_lock_stats_t) * cnt);
+    lvgl_removelock();
+    return cnt;
 }
 
-void lx_mem_free(void *data)
+void lvgl_lock_dump(const char *path)
 {
-    EnterCriticalSection(&tlsf_crit_sec);
-    tlsf_usage -= tlsf_block_size(data);
-    tlsf_free(mem_pool, data);
-    LeaveCriticalSection(&tlsf_crit_sec);
-}
+    static lvgl_lock_stats_t stats[DASH_LOCK_TRACE_SITES];
+    int cnt = lvgl_lock_get_stats(stats, DASH_LOCK_TRACE_SITES);
 
-void lx_mem_usage(uint32_t *used, uint32_t *capacity)
-{
-    if (used)
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
     {
-        EnterCriticalSection(&tlsf_crit_sec);
-        *used = tlsf_usage;
-        LeaveCriticalSection(&tlsf_crit_sec);
+        return;
     }
-    if (capacity)
+    fprintf(fp, "%-32s %8s %8s %8s %10s %10s %10s %10s %10s  hold <0.1 <0.5 <1 <2 <5 <10 <20 >=20ms\n", "site", "thread",
+            "count", "waited", "wait us", "max wait", "hold us", "max hold", "blocking");
+    for (int i = 0; i < cnt; i++)
     {
-        *capacity = sizeof(mem_pool_data);
+        lvgl_lock_stats_t *s = &stats[i];
+        char site[48];
+        lv_snprintf(site, sizeof(site), "%s:%d", s->func, s->line);
+        fprintf(fp, "%-32s %8lu %8u %8u %10llu %10u %10llu %10u %10llu ", site, (unsigned long)s->thread,
+                (unsigned int)s->count, (unsigned int)s->contended, (unsigned long long)s->wait_us,
+                (unsigned int)s->max_wait_us, (unsigned long long)s->hold_us, (unsigned int)s->max_hold_us,
+                (unsigned long long)s->blocking_us);
+        for (int j = 0; j < LVGL_LOCK_HIST_BUCKETS; j++)
+        {
+            fprintf(fp, " %u", (unsigned int)s->hold_hist[j]);
+        }
+        fprintf(fp, "  (max waiters %u)\n", (unsigned int)s->max_waiters);
     }
+    fclose(fp);
+}
+
+// Output handler for lvgl
+void lvgl_putstring(const char *buf)
+{
+    printf("%s", buf);
 }
 
 static void npf_putchar(int c, void *ctx)
@@ -138,8 +237,8 @@ int main(int argc, char* argv[]) {
     (void) argv;
 
     int w,h;
-    InitializeCriticalSection(&tlsf_crit_sec);
-    mem_pool = tlsf_create_with_pool(mem_pool_data, sizeof(mem_pool_data));
+    lx_mem_init();
+    lx_mem_set_tag("lvgl");
 
     toml_set_memutil(lx_mem_alloc, lx_mem_free);
 
@@ -148,6 +247,8 @@ int main(int argc, char* argv[]) {
 
     lvgl_mutex = SDL_CreateMutex();
     assert(lvgl_mutex);
+    lock_base_count = SDL_GetPerformanceCounter();
+    lock_freq = SDL_GetPerformanceFrequency();
 
     dash_printf(LEVEL_TRACE, "Initialising LVGL\n");
     lv_init();
@@ -160,23 +261,34 @@ int main(int argc, char* argv[]) {
     dash_init();
     dash_printf(LEVEL_TRACE, "Enter dash busy loop\n");
 
-    #ifdef NXDK
+    // The display is refreshed directly from the loop so each part of the frame can be timed
     lv_disp_t *disp = lv_obj_get_disp(lv_scr_act());
     lv_timer_del(disp->refr_timer);
     disp->refr_timer = NULL;
-    #endif
+    dash_debug_frame_init();
 
     while (lv_get_quit() == LV_QUIT_NONE)
     {
         int s,e,t;
         s = SDL_GetTicks();
+        dash_debug_frame_begin();
         lvgl_getlock();
+        dash_debug_frame_mark(DASH_FRAME_LOCK_WAIT);
         lv_task_handler();
+        dash_debug_frame_mark(DASH_FRAME_TIMERS);
         lvgl_removelock();
-        #ifdef NXDK
         lvgl_getlock();
+        dash_debug_frame_mark(DASH_FRAME_LOCK_WAIT);
+        // The refresh would do this first anyway
+        lv_obj_update_layout(lv_scr_act());
+        lv_obj_update_layout(lv_layer_top());
+        lv_obj_update_layout(lv_layer_sys());
+        dash_debug_frame_mark(DASH_FRAME_LAYOUT);
         _lv_disp_refr_timer(NULL);
+        dash_debug_frame_mark(DASH_FRAME_DRAW);
         lvgl_removelock();
+        dash_debug_frame_end();
+        #ifdef NXDK
         pb_wait_for_vbl();
         #else
         e = SDL_GetTicks();
@@ -188,6 +300,7 @@ int main(int argc, char* argv[]) {
         #endif
     }
     dash_printf(LEVEL_TRACE, "Quitting dash with quit event %d\n", lv_get_quit());
+    dash_deinit();
     lv_port_disp_deinit();
     lv_port_indev_deinit();
     platform_quit(lv_get_quit());
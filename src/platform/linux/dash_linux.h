@@ -5,12 +5,32 @@ typedef struct {
     pthread_mutex_t mutex;
 } CRITICAL_SECTION;
 
+typedef unsigned long DWORD;
+
+typedef struct {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME;
+
 typedef struct {
     char cFileName[260]; // Max path length
     unsigned long dwFileAttributes;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
 } WIN32_FIND_DATA;
 
-typedef unsigned long DWORD;
+typedef struct {
+    unsigned long dwFileAttributes;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+} WIN32_FILE_ATTRIBUTE_DATA;
+
+typedef enum {
+    GetFileExInfoStandard
+} GET_FILEEX_INFO_LEVELS;
+
 typedef void * HANDLE;
 typedef unsigned long LONG_PTR;
 
@@ -25,6 +45,10 @@ void *FindFirstFileA(const char *path, WIN32_FIND_DATA *findData);
 int FindNextFileA(void *hFindFile, WIN32_FIND_DATA *findData);
 void FindClose(void *hFindFile);
 unsigned long GetFileAttributes(const char *path);
+int GetFileAttributesExA(const char *path, GET_FILEEX_INFO_LEVELS level, void *info);
+int CreateDirectoryA(const char *path, void *security);
 
 #define FindFirstFile FindFirstFileA
-#define FindNextFile FindNextFileA
\ No newline at end of file
+#define FindNextFile FindNextFileA
+#define GetFileAttributesEx GetFileAttributesExA
+#define CreateDirectory CreateDirectoryA
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <dirent.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #include "dash_linux.h"
 
@@ -44,6 +45,22 @@ static char *convert_path(const char *path)
     return _path;
 }
 
+// Windows FILETIME is 100ns ticks, but we only need something that changes when the file changes
+static void stat_to_filetime(const struct stat *statbuf, FILETIME *ft)
+{
+    uint64_t t = (uint64_t)statbuf->st_mtime;
+    ft->dwLowDateTime = (DWORD)(t & 0xFFFFFFFF);
+    ft->dwHighDateTime = (DWORD)(t >> 32);
+}
+
+static void stat_to_find_data(const struct stat *statbuf, WIN32_FIND_DATA *findData)
+{
+    findData->dwFileAttributes = (S_ISDIR(statbuf->st_mode)) ? FILE_ATTRIBUTE_DIRECTORY : 0;
+    findData->nFileSizeLow = (DWORD)((uint64_t)statbuf->st_size & 0xFFFFFFFF);
+    findData->nFileSizeHigh = (DWORD)((uint64_t)statbuf->st_size >> 32);
+    stat_to_filetime(statbuf, &findData->ftLastWriteTime);
+}
+
 typedef struct
 {
     DIR* dir;
@@ -67,14 +84,7 @@ void *FindFirstFileA(const char *path, WIN32_FIND_DATA *findData)
             struct stat statbuf;
             if (stat(_path, &statbuf) == 0)
             {
-                if (S_ISDIR(statbuf.st_mode))
-                {
-                    findData->dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
-                }
-                else
-                {
-                    findData->dwFileAttributes = 0;
-                }
+                stat_to_find_data(&statbuf, findData);
             }
             free(_path);
             DIR_PATH *dir_path = malloc(sizeof(DIR_PATH));
@@ -106,14 +116,7 @@ int FindNextFileA(void *hFindFile, WIN32_FIND_DATA *findData)
         struct stat statbuf;
         if (stat(_path, &statbuf) == 0)
         {
-            if (S_ISDIR(statbuf.st_mode))
-            {
-                findData->dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
-            }
-            else
-            {
-                findData->dwFileAttributes = 0;
-            }
+            stat_to_find_data(&statbuf, findData);
         }
         free(_path);
         return 1;
@@ -151,3 +154,33 @@ unsigned long GetFileAttributes(const char *path)
     free(_path);
     return INVALID_FILE_ATTRIBUTES;
 }
+
+int GetFileAttributesExA(const char *path, GET_FILEEX_INFO_LEVELS level, void *info)
+{
+    struct stat statbuf;
+    WIN32_FILE_ATTRIBUTE_DATA *data = info;
+    (void)level;
+
+    char *_path = convert_path(path);
+    int ret = stat(_path, &statbuf);
+    free(_path);
+    if (ret != 0)
+    {
+        return 0;
+    }
+
+    data->dwFileAttributes = (S_ISDIR(statbuf.st_mode)) ? FILE_ATTRIBUTE_DIRECTORY : 0;
+    data->nFileSizeLow = (DWORD)((uint64_t)statbuf.st_size & 0xFFFFFFFF);
+    data->nFileSizeHigh = (DWORD)((uint64_t)statbuf.st_size >> 32);
+    stat_to_filetime(&statbuf, &data->ftLastWriteTime);
+    return 1;
+}
+
+int CreateDirectoryA(const char *path, void *security)
+{
+    (void)security;
+    char *_path = convert_path(path);
+    int ret = mkdir(_path, 0755);
+    free(_path);
+    return ret == 0;
+}
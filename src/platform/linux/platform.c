@@ -1,4 +1,5 @@
 #include <lvgl.h>
+#include <sys/sysinfo.h>
 #include "lithiumx.h"
 #include "../platform.h"
 #include "lvgl_drivers/lv_port_disp.h"
@@ -51,3 +52,16 @@ void platform_get_iso8601_time(char time_str[20])
     strftime(time_str, 20, "%Y-%m-%dT%H %M:%S", timeinfo);
 
 }
+
+void platform_get_ram_usage(size_t *total, size_t *available)
+{
+    struct sysinfo info;
+    if (sysinfo(&info) != 0)
+    {
+        *total = 0;
+        *available = 0;
+        return;
+    }
+    *total = (size_t)info.totalram * info.mem_unit;
+    *available = (size_t)(info.freeram + info.bufferram) * info.mem_unit;
+}
@@ -41,6 +41,12 @@ void platform_flush_cache(void);
  */
 void platform_get_iso8601_time(char time_str[20]);
 
+/*
+ * Retrieve the total and currently available physical RAM in bytes.
+ * Set both to 0 if it's unknown.
+ */
+void platform_get_ram_usage(size_t *total, size_t *available);
+
 
 
 #define PLATFORM_XBOX_ISO_SUPPORTED 0x01
@@ -55,6 +61,14 @@ void platform_get_iso8601_time(char time_str[20]);
 */
 uint32_t platform_iso_supported();
 
+#ifdef WIN32
+/*
+ * Win32 and Xbox. sqlite is built with SQLITE_OS_OTHER so it has no mutexes of its own.
+ * Registers ours. Must be called before sqlite3_initialize()
+ */
+void sqlite3_register_win32_mutex(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
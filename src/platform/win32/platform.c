@@ -48,3 +48,17 @@ void platform_get_iso8601_time(char time_str[20])
     lv_snprintf(time_str, 20, "%04d-%02d-%02d %02d:%02d:%02d",
         st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
 }
+
+void platform_get_ram_usage(size_t *total, size_t *available)
+{
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status) == 0)
+    {
+        *total = 0;
+        *available = 0;
+        return;
+    }
+    *total = (size_t)status.ullTotalPhys;
+    *available = (size_t)status.ullAvailPhys;
+}
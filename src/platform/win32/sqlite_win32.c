@@ -23,24 +23,135 @@ include $(NXDK_DIR)/Makefile
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <windows.h>
 #include "sqlite3/sqlite3.h"
 
 #define UNUSED_PARAMETER(x) (void)(x)
 
+struct _winShared;
+
 typedef struct _winFile
 {
     sqlite3_file base;
     HANDLE h;
+    struct _winShared *shared; // Only set for main database files
+    int lock;                  // SQLITE_LOCK_* held by this handle
+    int shm_mapped;
+    uint16_t shm_shared_mask;  // WAL-index locks held by this handle
+    uint16_t shm_excl_mask;
 } winFile;
 
+// Every open handle to the same database file shares one of these so connections within this
+// process see each other's locks. There is only ever one process, so the WAL-index that would
+// normally be in a -shm file is kept in ordinary memory instead.
+typedef struct _winShared
+{
+    char *filename;
+    int ref_cnt;
+    int shared_cnt;       // Number of handles holding SHARED_LOCK or higher
+    winFile *writer;      // The handle holding RESERVED_LOCK or higher
+    int writer_lock;
+    int shm_ref_cnt;
+    int shm_region_cnt;
+    char **shm_regions;
+    int shm_locks[SQLITE_SHM_NLOCK]; // >0 is number of shared holders, -1 is exclusive
+    struct _winShared *next;
+} winShared;
+
+static winShared *shared_list;
+
+static sqlite3_mutex *shared_mutex(void)
+{
+    return sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_VFS1);
+}
+
+static winShared *shared_get(const char *filename)
+{
+    winShared *s;
+
+    sqlite3_mutex_enter(shared_mutex());
+    for (s = shared_list; s; s = s->next)
+    {
+        if (strcmp(s->filename, filename) == 0)
+        {
+            break;
+        }
+    }
+    if (s == NULL)
+    {
+        s = calloc(1, sizeof(winShared));
+        if (s)
+        {
+            s->filename = malloc(strlen(filename) + 1);
+            if (s->filename == NULL)
+            {
+                free(s);
+                s = NULL;
+            }
+            else
+            {
+                strcpy(s->filename, filename);
+                s->next = shared_list;
+                shared_list = s;
+            }
+        }
+    }
+    if (s)
+    {
+        s->ref_cnt++;
+    }
+    sqlite3_mutex_leave(shared_mutex());
+    return s;
+}
+
+static void shared_free_regions(winShared *s)
+{
+    for (int i = 0; i < s->shm_region_cnt; i++)
+    {
+        free(s->shm_regions[i]);
+    }
+    free(s->shm_regions);
+    s->shm_regions = NULL;
+    s->shm_region_cnt = 0;
+}
+
+static void shared_put(winShared *s)
+{
+    sqlite3_mutex_enter(shared_mutex());
+    if (--s->ref_cnt == 0)
+    {
+        winShared **p = &shared_list;
+        while (*p != s)
+        {
+            p = &(*p)->next;
+        }
+        *p = s->next;
+        shared_free_regions(s);
+        free(s->filename);
+        free(s);
+    }
+    sqlite3_mutex_leave(shared_mutex());
+}
+
 #define sql_DbgPrint (void)
 
+static int winUnlock(sqlite3_file *id, int locktype);
+static int winShmUnmap(sqlite3_file *id, int deleteFlag);
+
 static int winClose(sqlite3_file *id)
 {
     winFile *f;
 
     f = (winFile *)id;
+    if (f->shared)
+    {
+        winShmUnmap(id, 0);
+        winUnlock(id, SQLITE_LOCK_NONE);
+        shared_put(f->shared);
+        f->shared = NULL;
+    }
     if (CloseHandle(f->h))
     {
         return SQLITE_OK;
@@ -98,7 +209,18 @@ static int winWrite(sqlite3_file *id, const void *pBuf, int amt, sqlite3_int64 o
 
 static int winTruncate(sqlite3_file *id, sqlite3_int64 nByte)
 {
-    return SQLITE_IOERR_TRUNCATE;
+    winFile *f;
+    LARGE_INTEGER loffset;
+
+    f = (winFile *)id;
+    loffset.QuadPart = nByte;
+
+    // Checkpointing a WAL can shrink the database file
+    if (SetFilePointerEx(f->h, loffset, NULL, FILE_BEGIN) == 0 || SetEndOfFile(f->h) == 0)
+    {
+        return SQLITE_IOERR_TRUNCATE;
+    }
+    return SQLITE_OK;
 }
 
 static int winSync(sqlite3_file *id, int flags)
@@ -127,24 +249,98 @@ static int winFileSize(sqlite3_file *id, sqlite3_int64 *pSize)
     return SQLITE_OK;
 }
 
+// File locks only need to work between connections in this process. A handle holding
+// PENDING_LOCK blocks new SHARED_LOCKs until the other readers have gone and it can become EXCLUSIVE.
 static int winLock(sqlite3_file *id, int locktype)
 {
-    UNUSED_PARAMETER(id);
-    UNUSED_PARAMETER(locktype);
-    return SQLITE_OK;
+    winFile *f = (winFile *)id;
+    winShared *s = f->shared;
+    int rc = SQLITE_OK;
+
+    if (s == NULL || f->lock >= locktype)
+    {
+        return SQLITE_OK;
+    }
+
+    sqlite3_mutex_enter(shared_mutex());
+    if (locktype == SQLITE_LOCK_SHARED)
+    {
+        if (s->writer && s->writer != f && s->writer_lock >= SQLITE_LOCK_PENDING)
+        {
+            rc = SQLITE_BUSY;
+        }
+        else
+        {
+            s->shared_cnt++;
+            f->lock = SQLITE_LOCK_SHARED;
+        }
+    }
+    else if (s->writer && s->writer != f)
+    {
+        rc = SQLITE_BUSY;
+    }
+    else if (locktype == SQLITE_LOCK_RESERVED)
+    {
+        s->writer = f;
+        s->writer_lock = SQLITE_LOCK_RESERVED;
+        f->lock = SQLITE_LOCK_RESERVED;
+    }
+    else
+    {
+        s->writer = f;
+        s->writer_lock = SQLITE_LOCK_PENDING;
+        f->lock = SQLITE_LOCK_PENDING;
+        if (s->shared_cnt > 1)
+        {
+            rc = SQLITE_BUSY;
+        }
+        else
+        {
+            s->writer_lock = SQLITE_LOCK_EXCLUSIVE;
+            f->lock = SQLITE_LOCK_EXCLUSIVE;
+        }
+    }
+    sqlite3_mutex_leave(shared_mutex());
+    return rc;
 }
 
 static int winUnlock(sqlite3_file *id, int locktype)
 {
-    UNUSED_PARAMETER(id);
-    UNUSED_PARAMETER(locktype);
+    winFile *f = (winFile *)id;
+    winShared *s = f->shared;
+
+    if (s == NULL || f->lock <= locktype)
+    {
+        return SQLITE_OK;
+    }
+
+    sqlite3_mutex_enter(shared_mutex());
+    if (f->lock > SQLITE_LOCK_SHARED)
+    {
+        s->writer = NULL;
+        s->writer_lock = SQLITE_LOCK_NONE;
+        f->lock = SQLITE_LOCK_SHARED;
+    }
+    if (locktype == SQLITE_LOCK_NONE)
+    {
+        s->shared_cnt--;
+        f->lock = SQLITE_LOCK_NONE;
+    }
+    sqlite3_mutex_leave(shared_mutex());
     return SQLITE_OK;
 }
 
 static int winCheckReservedLock(sqlite3_file *id, int *pResOut)
 {
-    UNUSED_PARAMETER(id);
+    winFile *f = (winFile *)id;
+
     *pResOut = 0;
+    if (f->shared)
+    {
+        sqlite3_mutex_enter(shared_mutex());
+        *pResOut = (f->shared->writer != NULL);
+        sqlite3_mutex_leave(shared_mutex());
+    }
     return SQLITE_OK;
 }
 
@@ -168,8 +364,155 @@ static int winDeviceCharacteristics(sqlite3_file *id)
     return SQLITE_IOCAP_UNDELETABLE_WHEN_OPEN;
 }
 
+static int winShmMap(sqlite3_file *id, int iRegion, int szRegion, int bExtend, void volatile **pp)
+{
+    winFile *f = (winFile *)id;
+    winShared *s = f->shared;
+    int rc = SQLITE_OK;
+
+    *pp = NULL;
+    if (s == NULL)
+    {
+        return SQLITE_IOERR_SHMMAP;
+    }
+
+    sqlite3_mutex_enter(shared_mutex());
+    if (f->shm_mapped == 0)
+    {
+        f->shm_mapped = 1;
+        s->shm_ref_cnt++;
+    }
+
+    if (iRegion >= s->shm_region_cnt && bExtend)
+    {
+        char **regions = realloc(s->shm_regions, (iRegion + 1) * sizeof(char *));
+        if (regions == NULL)
+        {
+            rc = SQLITE_IOERR_NOMEM;
+            goto leave;
+        }
+        s->shm_regions = regions;
+        while (s->shm_region_cnt <= iRegion)
+        {
+            s->shm_regions[s->shm_region_cnt] = calloc(1, szRegion);
+            if (s->shm_regions[s->shm_region_cnt] == NULL)
+            {
+                rc = SQLITE_IOERR_NOMEM;
+                goto leave;
+            }
+            s->shm_region_cnt++;
+        }
+    }
+
+    if (iRegion < s->shm_region_cnt)
+    {
+        *pp = s->shm_regions[iRegion];
+    }
+
+leave:
+    sqlite3_mutex_leave(shared_mutex());
+    return rc;
+}
+
+static int winShmLock(sqlite3_file *id, int offset, int n, int flags)
+{
+    winFile *f = (winFile *)id;
+    winShared *s = f->shared;
+    uint16_t mask = (uint16_t)((1 << (offset + n)) - (1 << offset));
+    int rc = SQLITE_OK;
+
+    if (s == NULL)
+    {
+        return SQLITE_IOERR_SHMLOCK;
+    }
+
+    sqlite3_mutex_enter(shared_mutex());
+    if (flags & SQLITE_SHM_UNLOCK)
+    {
+        for (int i = offset; i < offset + n; i++)
+        {
+            if (f->shm_excl_mask & (1 << i))
+            {
+                s->shm_locks[i] = 0;
+            }
+            else if (f->shm_shared_mask & (1 << i))
+            {
+                s->shm_locks[i]--;
+            }
+        }
+        f->shm_excl_mask &= ~mask;
+        f->shm_shared_mask &= ~mask;
+    }
+    else if (flags & SQLITE_SHM_SHARED)
+    {
+        if ((f->shm_shared_mask & mask) == 0)
+        {
+            if (s->shm_locks[offset] < 0)
+            {
+                rc = SQLITE_BUSY;
+            }
+            else
+            {
+                s->shm_locks[offset]++;
+                f->shm_shared_mask |= mask;
+            }
+        }
+    }
+    else
+    {
+        for (int i = offset; i < offset + n; i++)
+        {
+            if (s->shm_locks[i] != 0 && (f->shm_excl_mask & (1 << i)) == 0)
+            {
+                rc = SQLITE_BUSY;
+                break;
+            }
+        }
+        if (rc == SQLITE_OK)
+        {
+            for (int i = offset; i < offset + n; i++)
+            {
+                s->shm_locks[i] = -1;
+            }
+            f->shm_excl_mask |= mask;
+        }
+    }
+    sqlite3_mutex_leave(shared_mutex());
+    return rc;
+}
+
+static void winShmBarrier(sqlite3_file *id)
+{
+    UNUSED_PARAMETER(id);
+    sqlite3_mutex_enter(shared_mutex());
+    sqlite3_mutex_leave(shared_mutex());
+}
+
+static int winShmUnmap(sqlite3_file *id, int deleteFlag)
+{
+    winFile *f = (winFile *)id;
+    winShared *s = f->shared;
+
+    UNUSED_PARAMETER(deleteFlag);
+    if (s == NULL || f->shm_mapped == 0)
+    {
+        return SQLITE_OK;
+    }
+
+    winShmLock(id, 0, SQLITE_SHM_NLOCK, SQLITE_SHM_UNLOCK);
+
+    sqlite3_mutex_enter(shared_mutex());
+    f->shm_mapped = 0;
+    if (--s->shm_ref_cnt == 0)
+    {
+        shared_free_regions(s);
+    }
+    sqlite3_mutex_leave(shared_mutex());
+    return SQLITE_OK;
+}
+
 static const sqlite3_io_methods nxdk_io = {
-    1,                        /* iVersion */
+    2,                        /* iVersion */
     winClose,                 /* xClose */
     winRead,                  /* xRead */
     winWrite,                 /* xWrite */
@@ -182,6 +525,10 @@ static const sqlite3_io_methods nxdk_io = {
     winFileControl,           /* xFileControl */
     winSectorSize,            /* xSectorSize */
     winDeviceCharacteristics, /* xDeviceCharacteristics */
+    winShmMap,                /* xShmMap */
+    winShmLock,               /* xShmLock */
+    winShmBarrier,            /* xShmBarrier */
+    winShmUnmap,              /* xShmUnmap */
 };
 
 static DWORD sqlite_to_win_access(int sql_flags)
@@ -220,14 +567,26 @@ static int winOpen(
     UNUSED_PARAMETER(pVfs);
 
     f = (winFile *)id;
-    f->base.pMethods = &nxdk_io;
-    f->h = CreateFileA(zFilename, sqlite_to_win_access(flags), FILE_SHARE_READ, NULL,
-                       sqlite_to_win_attr(flags), FILE_ATTRIBUTE_NORMAL, NULL);
+    memset(f, 0, sizeof(winFile));
+    // The same file may be open by several connections at once
+    f->h = CreateFileA(zFilename, sqlite_to_win_access(flags), FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL, sqlite_to_win_attr(flags), FILE_ATTRIBUTE_NORMAL, NULL);
     if (f->h == INVALID_HANDLE_VALUE)
     {
         return SQLITE_CANTOPEN;
     }
 
+    if (flags & SQLITE_OPEN_MAIN_DB)
+    {
+        f->shared = shared_get(zFilename);
+        if (f->shared == NULL)
+        {
+            CloseHandle(f->h);
+            return SQLITE_NOMEM;
+        }
+    }
+    f->base.pMethods = &nxdk_io;
+
     if (pOutFlags)
     {
         *pOutFlags = flags;
@@ -403,9 +762,22 @@ static sqlite3_vfs win32_vfs = {
     NULL,                /* xNextSystemCall */
 };
 
-#if (0)
+// sqlite has no mutex implementation of its own when built with SQLITE_OS_OTHER
+typedef struct
+{
+    CRITICAL_SECTION cs;
+    int id;
+} winMutex;
+
+static winMutex win_static_mutexes[SQLITE_MUTEX_STATIC_VFS3 + 1];
+
 static int winMutexInit(void)
 {
+    for (int i = 0; i < (int)(sizeof(win_static_mutexes) / sizeof(win_static_mutexes[0])); i++)
+    {
+        InitializeCriticalSection(&win_static_mutexes[i].cs);
+        win_static_mutexes[i].id = i;
+    }
     return SQLITE_OK;
 }
 
@@ -416,32 +788,47 @@ static int winMutexEnd(void)
 
 static sqlite3_mutex *winMutexAlloc(int id)
 {
-    HANDLE mutex = CreateMutex(NULL, FALSE, NULL);
-    return (sqlite3_mutex *)mutex;
+    if (id == SQLITE_MUTEX_FAST || id == SQLITE_MUTEX_RECURSIVE)
+    {
+        winMutex *mutex = malloc(sizeof(winMutex));
+        if (mutex)
+        {
+            InitializeCriticalSection(&mutex->cs);
+            mutex->id = id;
+        }
+        return (sqlite3_mutex *)mutex;
+    }
+    if (id > SQLITE_MUTEX_RECURSIVE && id <= SQLITE_MUTEX_STATIC_VFS3)
+    {
+        return (sqlite3_mutex *)&win_static_mutexes[id];
+    }
+    return NULL;
 }
 
 static void (winMutexFree)(sqlite3_mutex *mutex)
 {
-    CloseHandle((HANDLE)mutex);
+    winMutex *m = (winMutex *)mutex;
+    if (m->id == SQLITE_MUTEX_FAST || m->id == SQLITE_MUTEX_RECURSIVE)
+    {
+        free(m);
+    }
 }
 
 static void winMutexEnter(sqlite3_mutex* mutex)
 {
-    WaitForSingleObject((HANDLE)mutex, INFINITE);
+    EnterCriticalSection(&((winMutex *)mutex)->cs);
 }
 
 static int winMutexTry(sqlite3_mutex* mutex)
 {
-    DWORD res = WaitForSingleObject((HANDLE)mutex, 0);
-    if (res == WAIT_OBJECT_0 || res == WAIT_ABANDONED) {
-        return SQLITE_OK;
-    }
+    // sqlite allows this to always fail
+    UNUSED_PARAMETER(mutex);
     return SQLITE_BUSY;
 }
 
 static void winMutexLeave(sqlite3_mutex* mutex)
 {
-    ReleaseMutex((HANDLE)mutex);
+    LeaveCriticalSection(&((winMutex *)mutex)->cs);
 }
 
 static sqlite3_mutex_methods win32_mutex_methods = {
@@ -457,13 +844,11 @@ static sqlite3_mutex_methods win32_mutex_methods = {
 };
 
 // Needs to be called before sqlite3_initialize()
-void sqlite3_register_win32_mutex()
+void sqlite3_register_win32_mutex(void)
 {
     sqlite3_config(SQLITE_CONFIG_MUTEX, &win32_mutex_methods);
 }
 
-#endif
-
 sqlite3_vfs *sqlite_nxdk_fs(void)
 {
     return &win32_vfs;
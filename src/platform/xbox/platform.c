@@ -495,4 +495,13 @@ int strcasecmp(const char *s1, const char *s2)
   }
 
   return result;
-}
\ No newline at end of file
+}
+
+void platform_get_ram_usage(size_t *total, size_t *available)
+{
+    MM_STATISTICS MemoryStatistics;
+    MemoryStatistics.Length = sizeof(MM_STATISTICS);
+    MmQueryStatistics(&MemoryStatistics);
+    *total = MemoryStatistics.TotalPhysicalPages * PAGE_SIZE;
+    *available = MemoryStatistics.AvailablePages * PAGE_SIZE;
+}